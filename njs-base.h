@@ -109,6 +109,7 @@ class Persistent;
 typedef unsigned int Result;
 
 //! Contains additional information related to `Result`.
+struct ResultPayloadBase;
 struct ResultPayload;
 
 // ============================================================================
@@ -664,6 +665,22 @@ struct BindingItem {
     kTypeSetter = 4
   };
 
+  //! Flags that can be passed to `NJS_BIND_...` macros as optional parameters.
+  enum Flags : uint32_t {
+    kFlagNone = 0,
+    //! Function can't be called with `new` and has no `prototype` (statics, methods).
+    kFlagNoConstruct = 0x00000001u,
+    //! Function or getter has no side effects, debuggers can call it during
+    //! side-effect-free evaluation (statics, methods, getters).
+    kFlagNoSideEffect = 0x00000002u,
+    //! Property is enumerable (by default only statics and methods are).
+    kFlagEnumerable = 0x00000004u,
+    //! Property is not enumerable (by default getters and setters are not).
+    kFlagDontEnum = 0x00000008u,
+    //! Property is read-only.
+    kFlagReadOnly = 0x00000010u
+  };
+
   NJS_INLINE BindingItem(unsigned int type, unsigned int flags, const char* name, const void* data) noexcept
     : type(type),
       flags(flags),
@@ -672,7 +689,7 @@ struct BindingItem {
 
   //! Type of the item.
   unsigned int type;
-  //! Flags.
+  //! Flags, see `Flags`.
   unsigned int flags;
   //! Name (function name, property name, etc...).
   const char* name;
@@ -680,6 +697,16 @@ struct BindingItem {
   const void* data;
 };
 
+namespace Internal {
+  // Combines optional flags passed to `NJS_BIND_...` macros.
+  static constexpr unsigned int bindingFlags() noexcept { return 0; }
+
+  template<typename... ARGS>
+  static constexpr unsigned int bindingFlags(unsigned int flags, ARGS... rest) noexcept {
+    return flags | bindingFlags(rest...);
+  }
+} // {Internal}
+
 // ============================================================================
 // [njs::StaticData]
 // ============================================================================
@@ -755,6 +782,161 @@ static const StaticData _staticData = {
   }
 };
 
+// ============================================================================
+// [njs::Internal::LruTable]
+// ============================================================================
+
+namespace Internal {
+
+//! Bounded hash table of entries that keeps them in an LRU list, shared by
+//! extensions that cache at most `capacity` values (see `MemoCache` and
+//! `InternCache`).
+//!
+//! `EntryT` must provide `key.hash`, `chainNext`, `lruPrev`, and `lruNext`
+//! members. The table only links entries, values held by them are released
+//! by the owner before an entry is removed or the table is reset.
+template<typename EntryT>
+class LruTable {
+public:
+  NJS_NONCOPYABLE(LruTable)
+
+  explicit NJS_INLINE LruTable(uint32_t capacity) noexcept
+    : _capacity(capacity ? capacity : 1),
+      _entries(nullptr),
+      _buckets(nullptr),
+      _bucketMask(0),
+      _free(nullptr),
+      _lruFirst(nullptr),
+      _lruLast(nullptr) {}
+
+  NJS_INLINE ~LruTable() noexcept { reset(); }
+
+  NJS_INLINE bool isInitialized() const noexcept { return _entries != nullptr; }
+  NJS_INLINE uint32_t capacity() const noexcept { return _capacity; }
+
+  //! Most recently used entry.
+  NJS_INLINE EntryT* first() const noexcept { return _lruFirst; }
+  //! Least recently used entry.
+  NJS_INLINE EntryT* last() const noexcept { return _lruLast; }
+  //! First entry of the bucket of `hash`, the table must be initialized.
+  NJS_INLINE EntryT* bucket(uint32_t hash) const noexcept { return _buckets[hash & _bucketMask]; }
+
+  NJS_NOINLINE Result init() noexcept {
+    uint32_t bucketCount = 1;
+    while (bucketCount < _capacity)
+      bucketCount *= 2;
+
+    _entries = new (std::nothrow) EntryT[_capacity];
+    _buckets = new (std::nothrow) EntryT*[bucketCount];
+
+    if (!_entries || !_buckets) {
+      delete[] _entries;
+      delete[] _buckets;
+      _entries = nullptr;
+      _buckets = nullptr;
+      return Globals::kResultOutOfMemory;
+    }
+
+    for (uint32_t i = 0; i < bucketCount; i++)
+      _buckets[i] = nullptr;
+
+    for (uint32_t i = 0; i < _capacity; i++)
+      _entries[i].chainNext = i + 1 < _capacity ? &_entries[i + 1] : nullptr;
+
+    _bucketMask = bucketCount - 1;
+    _free = _entries;
+    return Globals::kResultOk;
+  }
+
+  //! Frees all entries, they must be removed (and released) already.
+  NJS_NOINLINE void reset() noexcept {
+    NJS_ASSERT(_lruFirst == nullptr);
+
+    delete[] _entries;
+    delete[] _buckets;
+
+    _entries = nullptr;
+    _buckets = nullptr;
+    _free = nullptr;
+  }
+
+  //! Returns an unused entry, or null if all entries are used, in that case
+  //! the owner evicts `last()`.
+  NJS_INLINE EntryT* acquire() noexcept {
+    EntryT* entry = _free;
+    if (entry)
+      _free = entry->chainNext;
+    return entry;
+  }
+
+  //! Makes a removed entry unused.
+  NJS_INLINE void recycle(EntryT* entry) noexcept {
+    entry->chainNext = _free;
+    _free = entry;
+  }
+
+  //! Links `entry` into its bucket as the most recently used entry.
+  NJS_INLINE void insert(EntryT* entry) noexcept {
+    EntryT** bucket = &_buckets[entry->key.hash & _bucketMask];
+    entry->chainNext = *bucket;
+    *bucket = entry;
+    _lruPrepend(entry);
+  }
+
+  //! Unlinks `entry` from its bucket and the LRU list.
+  NJS_NOINLINE void remove(EntryT* entry) noexcept {
+    EntryT** p = &_buckets[entry->key.hash & _bucketMask];
+    while (*p != entry)
+      p = &(*p)->chainNext;
+    *p = entry->chainNext;
+    _lruRemove(entry);
+  }
+
+  //! Marks `entry` as the most recently used one.
+  NJS_INLINE void touch(EntryT* entry) noexcept {
+    if (entry != _lruFirst) {
+      _lruRemove(entry);
+      _lruPrepend(entry);
+    }
+  }
+
+  NJS_INLINE void _lruPrepend(EntryT* entry) noexcept {
+    entry->lruPrev = nullptr;
+    entry->lruNext = _lruFirst;
+
+    if (_lruFirst)
+      _lruFirst->lruPrev = entry;
+    else
+      _lruLast = entry;
+    _lruFirst = entry;
+  }
+
+  NJS_INLINE void _lruRemove(EntryT* entry) noexcept {
+    if (entry->lruPrev)
+      entry->lruPrev->lruNext = entry->lruNext;
+    else
+      _lruFirst = entry->lruNext;
+
+    if (entry->lruNext)
+      entry->lruNext->lruPrev = entry->lruPrev;
+    else
+      _lruLast = entry->lruPrev;
+  }
+
+  uint32_t _capacity;
+  EntryT* _entries;
+  EntryT** _buckets;
+  uint32_t _bucketMask;
+
+  //! Unused entries.
+  EntryT* _free;
+  //! LRU list of used entries.
+  EntryT* _lruFirst;
+  EntryT* _lruLast;
+};
+
+} // {Internal}
+
 // ============================================================================
 // [njs::ResultPayload]
 // ============================================================================
@@ -771,7 +953,10 @@ static const StaticData _staticData = {
 //! `reset()` method for performance reasons. Based on the error type and
 //! content of these values other members can be used, but not without
 //! checking `isInitialized()` first.
-struct ResultPayload {
+//!
+//! `ResultPayloadBase` holds everything except the static buffer, it's used
+//! where the buffer would be wasted, like in every asynchronous task.
+struct ResultPayloadBase {
   // ------------------------------------------------------------------------
   // [Reset]
   // ------------------------------------------------------------------------
@@ -832,7 +1017,10 @@ struct ResultPayload {
     ArgumentsData arguments;
     ConstructCallData constructCall;
   };
+};
 
+//! Result payload with a static buffer to format messages, used by contexts.
+struct ResultPayload : public ResultPayloadBase {
   //! Static buffer for temporary strings.
   char staticBuffer[Globals::kMaxBufferSize];
 };
@@ -843,10 +1031,12 @@ struct ResultPayload {
 
 //! Result mixin, provides methods that can be used by `ExecutionContext`. The
 //! purpose of this mixin is to define methods that are generic and then simply
-//! reused by all VM backends.
-class ResultMixin {
+//! reused by all VM backends. `PayloadT` is either `ResultPayload` or
+//! `ResultPayloadBase`.
+template<typename PayloadT>
+class ResultMixinT {
 public:
-  NJS_INLINE ResultMixin() noexcept { _payload.reset(); }
+  NJS_INLINE ResultMixinT() noexcept { _payload.reset(); }
 
   // ------------------------------------------------------------------------
   // [Throw Exception]
@@ -949,9 +1139,11 @@ public:
   // [Members]
   // ------------------------------------------------------------------------
 
-  ResultPayload _payload;
+  PayloadT _payload;
 };
 
+typedef ResultMixinT<ResultPayload> ResultMixin;
+
 // ============================================================================
 // [njs::Maybe]
 // ============================================================================
@@ -1045,14 +1237,15 @@ NJS_INLINE Result resultOf(const Value& in) noexcept;
 
 namespace Internal {
 
-// NOTE: This is templated as to make it possible to be declared without knowing the `Context`.
-template<typename Context>
-static NJS_NOINLINE void reportError(Context& ctx, Result result, const ResultPayload& payload) noexcept {
+// Formats a message describing `result` and its `payload` into `msgBuf`, which
+// must be at least `Globals::kMaxBufferSize` bytes long, and stores the type of
+// the exception to be thrown into `exceptionTypeOut`. The returned message is
+// either `msgBuf` or a static string.
+static NJS_NOINLINE const char* formatError(char* msgBuf, unsigned int& exceptionTypeOut, Result result, const ResultPayloadBase& payload) noexcept {
   unsigned int exceptionType = Globals::kExceptionError;
   const StaticData& staticData = _staticData;
 
   enum { kMsgSize = Globals::kMaxBufferSize };
-  char msgBuf[kMsgSize];
   const char* msg = msgBuf;
 
   if (result >= Globals::_kResultThrowFirst &&
@@ -1068,17 +1261,21 @@ static NJS_NOINLINE void reportError(Context& ctx, Result result, const ResultPa
            result <= Globals::_kResultValueLast) {
     exceptionType = Globals::kExceptionTypeError;
 
+    // `literal` is a static string, `baseBuf` is local and must never be
+    // returned, so it's only used as a formatting argument.
     char baseBuf[64];
-    const char* base = baseBuf;
+    const char* literal = nullptr;
 
     intptr_t argIndex = payload.value.argIndex;
     if (argIndex == -1)
-      base = "Invalid value";
+      literal = "Invalid value";
     else if (argIndex == -2)
-      base = "Invalid argument";
+      literal = "Invalid argument";
     else
       StrUtils::sformat(baseBuf, 64, "Invalid argument [%u]", static_cast<unsigned int>(argIndex));
 
+    const char* base = literal ? literal : baseBuf;
+
     if (result == Globals::kResultInvalidValueTypeId) {
       const char* typeName = staticData.typeNameOf(payload.value.typeId);
       StrUtils::sformat(msgBuf, kMsgSize, "%s: Expected Type '%s'", base, typeName);
@@ -1090,8 +1287,11 @@ static NJS_NOINLINE void reportError(Context& ctx, Result result, const ResultPa
     else if (result == Globals::kResultInvalidValueCustom) {
       StrUtils::sformat(msgBuf, kMsgSize, "%s: %s", base, payload.value.message);
     }
+    else if (literal) {
+      msg = literal;
+    }
     else {
-      msg = base;
+      StrUtils::sformat(msgBuf, kMsgSize, "%s", baseBuf);
     }
   }
   else if (result == Globals::kResultInvalidArgumentsLength) {
@@ -1125,6 +1325,60 @@ static NJS_NOINLINE void reportError(Context& ctx, Result result, const ResultPa
     msg = "Unknown error";
   }
 
+  exceptionTypeOut = exceptionType;
+  return msg;
+}
+
+// Returns the type of the exception thrown for `result` if its message can be
+// formatted later from the first two words of its payload, otherwise zero.
+// Payloads of other results point to strings that may not outlive the call.
+static NJS_INLINE unsigned int lazyErrorType(Result result) noexcept {
+  switch (result) {
+    case Globals::kResultInvalidState:
+    case Globals::kResultInvalidHandle:
+    case Globals::kResultOutOfMemory:
+      return Globals::kExceptionError;
+
+    case Globals::kResultInvalidValue:
+    case Globals::kResultInvalidValueTypeId:
+    case Globals::kResultInvalidValueRange:
+    case Globals::kResultUnsafeInt64Conversion:
+    case Globals::kResultUnsafeUint64Conversion:
+    case Globals::kResultInvalidArgumentsLength:
+      return Globals::kExceptionTypeError;
+
+    default:
+      return Globals::kExceptionNone;
+  }
+}
+
+// Returns the `code` property of an error created for `result`.
+static NJS_INLINE const char* resultCodeName(Result result) noexcept {
+  switch (result) {
+    case Globals::kResultInvalidState           : return "ERR_NJS_INVALID_STATE";
+    case Globals::kResultInvalidHandle          : return "ERR_NJS_INVALID_HANDLE";
+    case Globals::kResultOutOfMemory            : return "ERR_NJS_OUT_OF_MEMORY";
+    case Globals::kResultInvalidValue           : return "ERR_NJS_INVALID_VALUE";
+    case Globals::kResultInvalidValueTypeId     : return "ERR_NJS_INVALID_VALUE_TYPE";
+    case Globals::kResultInvalidValueTypeName   : return "ERR_NJS_INVALID_VALUE_TYPE";
+    case Globals::kResultInvalidValueCustom     : return "ERR_NJS_INVALID_VALUE";
+    case Globals::kResultInvalidValueRange      : return "ERR_NJS_INVALID_VALUE_RANGE";
+    case Globals::kResultUnsafeInt64Conversion  : return "ERR_NJS_UNSAFE_INT64_CONVERSION";
+    case Globals::kResultUnsafeUint64Conversion : return "ERR_NJS_UNSAFE_UINT64_CONVERSION";
+    case Globals::kResultInvalidArgumentsLength : return "ERR_NJS_INVALID_ARGUMENTS_LENGTH";
+    case Globals::kResultInvalidConstructCall   : return "ERR_NJS_INVALID_CONSTRUCT_CALL";
+    case Globals::kResultAbstractConstructCall  : return "ERR_NJS_ABSTRACT_CONSTRUCT_CALL";
+    default                                     : return "ERR_NJS_UNKNOWN";
+  }
+}
+
+// NOTE: This is templated as to make it possible to be declared without knowing the `Context`.
+template<typename Context>
+static NJS_NOINLINE void reportError(Context& ctx, Result result, const ResultPayloadBase& payload) noexcept {
+  char msgBuf[Globals::kMaxBufferSize];
+  unsigned int exceptionType;
+
+  const char* msg = formatError(msgBuf, exceptionType, result, payload);
   ctx.throwNewException(exceptionType, ctx.newString(Utf8Ref(msg)));
 }
 
@@ -34,6 +34,12 @@ static const size_t kMaxStringSize = static_cast<size_t>(v8::String::kMaxLength)
 // ============================================================================
 
 typedef v8::FunctionCallback NativeFunction;
+typedef v8::FunctionCallbackInfo<v8::Value> NativeFunctionInfo;
+
+// Weak callback, the parameter passed to `Context::makeWeak()` is accessible
+// through `info.GetParameter()`. It's only allowed to reset handles inside it.
+typedef v8::WeakCallbackInfo<void> WeakCallbackInfo;
+typedef void (*WeakCallback)(const WeakCallbackInfo& info);
 
 // ============================================================================
 // [Forward Declarations]
@@ -105,6 +111,36 @@ namespace Internal {
     else
       return uint32_t(nativeTag >>  2);
   }
+
+  //! Returns whether `nativeTag` has the form created by `nativeTagFromObjectTag()`.
+  static NJS_INLINE bool isNativeTag(uintptr_t nativeTag) noexcept {
+    return nativeTagFromObjectTag(objectTagFromNativeTag(nativeTag)) == nativeTag;
+  }
+
+  // Module data of the isolate running on the current thread. Each isolate
+  // has its own thread (node's main thread and worker threads), so a thread
+  // local is enough to have per-isolate data without any lookup. The slot is
+  // keyed by the type of the data so two addons never share it.
+  template<typename T>
+  struct ModuleDataSlot {
+    static thread_local T* data;
+
+    static NJS_NOINLINE void destroy(void* data) noexcept {
+      if (ModuleDataSlot<T>::data == data)
+        ModuleDataSlot<T>::data = nullptr;
+      delete static_cast<T*>(data);
+    }
+  };
+
+  template<typename T>
+  thread_local T* ModuleDataSlot<T>::data = nullptr;
+
+  // Whether bindings running on the current thread throw lazy errors, see
+  // `Context::setLazyErrors()`.
+  static NJS_INLINE bool& lazyErrorsEnabled() noexcept {
+    static thread_local bool enabled = false;
+    return enabled;
+  }
 } // {Internal}
 
 // ============================================================================
@@ -436,6 +472,15 @@ public:
   NJS_INLINE Runtime(const Runtime& other) noexcept : _isolate(other._isolate) {}
   explicit NJS_INLINE Runtime(v8::Isolate* isolate) noexcept : _isolate(isolate) {}
 
+  // --------------------------------------------------------------------------
+  // [Assignment]
+  // --------------------------------------------------------------------------
+
+  NJS_INLINE Runtime& operator=(const Runtime& other) noexcept {
+    _isolate = other._isolate;
+    return *this;
+  }
+
   // --------------------------------------------------------------------------
   // [V8-Specific]
   // --------------------------------------------------------------------------
@@ -726,6 +771,12 @@ public:
   // NOTE: `isValid()` returns return `false` after `reset()` is called.
   NJS_INLINE void reset() noexcept { _handle.Empty(); }
 
+  // Release the referenced value so it can be garbage collected. Unlike
+  // `reset()` this also frees the underlying VM handle.
+  //
+  // NOTE: `isValid()` returns return `false` after `release()` is called.
+  NJS_INLINE void release() noexcept { _handle.Reset(); }
+
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
@@ -792,6 +843,7 @@ public:
   NJS_INLINE Value newObject() noexcept { return Value(v8::Object::New(v8Isolate())); }
 
   NJS_INLINE Value newString() const noexcept { return Value(v8::String::Empty(v8Isolate())); }
+  NJS_INLINE Value newExternal(void* data) noexcept { return Value(v8::External::New(v8Isolate(), data)); }
 
   template<typename StrRefT>
   NJS_INLINE Value newString(const StrRefT& data) noexcept {
@@ -902,6 +954,26 @@ public:
     return isWrapped(obj, NativeT::kObjectTag);
   }
 
+  // Returns whether `obj` wraps a native object of any class.
+  NJS_INLINE bool isWrappedAny(Value obj) noexcept {
+    NJS_ASSERT(obj.isValid());
+
+    if (!obj.isObject())
+      return false;
+
+    v8::Local<v8::Object> handle = obj.v8HandleAs<v8::Object>();
+    if (handle->InternalFieldCount() < 2)
+      return false;
+
+    // Objects created by node or other addons can store anything in their
+    // internal fields. A native tag is stored as an aligned pointer, which
+    // V8 sees as a small integer, so anything else is not read as a pointer.
+    if (!handle->GetInternalField(1)->IsInt32())
+      return false;
+
+    return Internal::isNativeTag((uintptr_t)handle->GetAlignedPointerFromInternalField(1));
+  }
+
   // --------------------------------------------------------------------------
   // [Value]
   // --------------------------------------------------------------------------
@@ -937,6 +1009,12 @@ public:
     return result.FromMaybe(std::numeric_limits<double>::quiet_NaN());
   }
 
+  NJS_INLINE void* externalData(const Value& value) const noexcept {
+    NJS_ASSERT(value.isValid());
+    NJS_ASSERT(value.isExternal());
+    return value.v8Value<v8::External>()->Value();
+  }
+
   // --------------------------------------------------------------------------
   // [Language]
   // --------------------------------------------------------------------------
@@ -1009,6 +1087,24 @@ public:
     return value.v8Value<v8::String>()->Write(v8Isolate(), out, 0, size, v8::String::NO_NULL_TERMINATION);
   }
 
+  // Hash of the string content. It's computed by the engine once and cached in
+  // the string, equal strings always have equal hashes.
+  NJS_INLINE uint32_t stringHash(const Value& value) const noexcept {
+    NJS_ASSERT(value.isValid());
+    NJS_ASSERT(value.isString());
+    return uint32_t(value.v8Value<v8::String>()->GetIdentityHash());
+  }
+
+  // Compares the content of two strings without copying them, it's fast if
+  // both strings are internalized.
+  NJS_INLINE bool stringEquals(const Value& aStr, const Value& bStr) const noexcept {
+    NJS_ASSERT(aStr.isValid());
+    NJS_ASSERT(aStr.isString());
+    NJS_ASSERT(bStr.isValid());
+    NJS_ASSERT(bStr.isString());
+    return aStr._handle == bStr._handle || aStr.v8Value<v8::String>()->StringEquals(bStr.v8HandleAs<v8::String>());
+  }
+
   // Concatenate two strings.
   NJS_INLINE Value concatStrings(const Value& aStr, const Value& bStr) noexcept {
     NJS_ASSERT(aStr.isValid());
@@ -1019,6 +1115,13 @@ public:
     return Value(v8::String::Concat(v8Isolate(), aStr.v8HandleAs<v8::String>(), bStr.v8HandleAs<v8::String>()));
   }
 
+  // --------------------------------------------------------------------------
+  // [Symbol]
+  // --------------------------------------------------------------------------
+
+  NJS_INLINE Value iteratorSymbol() const noexcept { return Value(v8::Symbol::GetIterator(v8Isolate())); }
+  NJS_INLINE Value asyncIteratorSymbol() const noexcept { return Value(v8::Symbol::GetAsyncIterator(v8Isolate())); }
+
   // --------------------------------------------------------------------------
   // [Array]
   // --------------------------------------------------------------------------
@@ -1161,6 +1264,22 @@ public:
     function.v8HandleAs<v8::Function>()->SetName(name.v8HandleAs<v8::String>());
   }
 
+  // --------------------------------------------------------------------------
+  // [Script]
+  // --------------------------------------------------------------------------
+
+  //! Compiles and runs `source` and returns its completion value. Returns an
+  //! invalid value if it failed, the exception is pending in that case.
+  NJS_NOINLINE Value runScript(const Value& source) noexcept {
+    NJS_ASSERT(source.isString());
+
+    v8::Local<v8::Script> script;
+    if (!v8::Script::Compile(_context, source.v8HandleAs<v8::String>()).ToLocal(&script))
+      return Value();
+
+    return Value(Internal::v8LocalFromMaybe(script->Run(_context)));
+  }
+
   // --------------------------------------------------------------------------
   // [Call]
   // --------------------------------------------------------------------------
@@ -1188,6 +1307,39 @@ public:
           const_cast<v8::Local<v8::Value>*>(reinterpret_cast<const v8::Local<v8::Value>*>(argv)))));
   }
 
+  // --------------------------------------------------------------------------
+  // [Promise]
+  // --------------------------------------------------------------------------
+
+  // A resolver is an object that owns a promise and can settle it. Keep the
+  // resolver, return its promise (see `promiseOf()`) to JS.
+  NJS_INLINE Value newResolver() noexcept {
+    return Value(
+      Internal::v8LocalFromMaybe(
+        v8::Promise::Resolver::New(_context)));
+  }
+
+  NJS_INLINE Value promiseOf(const Value& resolver) noexcept {
+    NJS_ASSERT(resolver.isValid());
+    return Value(resolver.v8Value<v8::Promise::Resolver>()->GetPromise());
+  }
+
+  NJS_INLINE Result resolve(const Value& resolver, const Value& value) noexcept {
+    NJS_ASSERT(resolver.isValid());
+    NJS_ASSERT(value.isValid());
+
+    v8::Maybe<bool> result = resolver.v8Value<v8::Promise::Resolver>()->Resolve(_context, value._handle);
+    return result.FromMaybe(false) ? Globals::kResultOk : Globals::kResultBypass;
+  }
+
+  NJS_INLINE Result reject(const Value& resolver, const Value& value) noexcept {
+    NJS_ASSERT(resolver.isValid());
+    NJS_ASSERT(value.isValid());
+
+    v8::Maybe<bool> result = resolver.v8Value<v8::Promise::Resolver>()->Reject(_context, value._handle);
+    return result.FromMaybe(false) ? Globals::kResultOk : Globals::kResultBypass;
+  }
+
   // --------------------------------------------------------------------------
   // [Exception]
   // --------------------------------------------------------------------------
@@ -1204,6 +1356,27 @@ public:
     }
   }
 
+  // Creates the same exception `ExecutionContext` would throw if a binding
+  // returned `result`, but doesn't throw it. Used to reject promises, etc...
+  NJS_NOINLINE Value newResultException(Result result, const ResultPayloadBase& payload) noexcept {
+    char msgBuf[Globals::kMaxBufferSize];
+    unsigned int exceptionType;
+
+    const char* msg = Internal::formatError(msgBuf, exceptionType, result, payload);
+    Value msgValue = newString(Utf8Ref(msg));
+
+    if (!msgValue.isValid())
+      return msgValue;
+    return newException(exceptionType, msgValue);
+  }
+
+  //! Makes bindings running on the current thread (thus isolate) throw errors
+  //! that format their message when `message` is read the first time. Such
+  //! errors also have a `code` property, but no `stack`. Only errors whose
+  //! payload doesn't reference strings are lazy, see `Internal::lazyErrorType()`.
+  NJS_INLINE void setLazyErrors(bool enabled) noexcept { Internal::lazyErrorsEnabled() = enabled; }
+  NJS_INLINE bool lazyErrors() const noexcept { return Internal::lazyErrorsEnabled(); }
+
   // --------------------------------------------------------------------------
   // [Throw]
   // --------------------------------------------------------------------------
@@ -1246,6 +1419,64 @@ public:
     return Globals::kResultOk;
   }
 
+  // Returns a hash of an object or a string, which doesn't change during its
+  // lifetime. Strings hash their content, objects their identity.
+  NJS_INLINE uint32_t identityHash(const Value& value) const noexcept {
+    NJS_ASSERT(value.isValid());
+    NJS_ASSERT(value.isObject() || value.isString());
+
+    if (value.isObject())
+      return uint32_t(value.v8Value<v8::Object>()->GetIdentityHash());
+    else
+      return uint32_t(value.v8Value<v8::Name>()->GetIdentityHash());
+  }
+
+  // Returns whether `persistent` and `local` refer to the same value (identity).
+  NJS_INLINE bool isSameHandle(const Persistent& persistent, const Value& local) const noexcept {
+    return persistent._handle == local._handle;
+  }
+
+  // Makes `persistent` weak, `callback` is called with `param` when the value
+  // is about to be garbage collected. The callback must reset `persistent`.
+  NJS_INLINE void makeWeak(Persistent& persistent, void* param, WeakCallback callback) noexcept {
+    NJS_ASSERT(persistent.isValid());
+    persistent._handle.SetWeak<void>(param, callback, v8::WeakCallbackType::kParameter);
+  }
+
+  NJS_INLINE void clearWeak(Persistent& persistent) noexcept {
+    NJS_ASSERT(persistent.isValid());
+    persistent._handle.ClearWeak();
+  }
+
+  // --------------------------------------------------------------------------
+  // [Module Data]
+  // --------------------------------------------------------------------------
+
+  //! Returns the module data of the current isolate, see `newModuleData()`.
+  template<typename T>
+  NJS_INLINE T* moduleData() const noexcept {
+    return Internal::ModuleDataSlot<T>::data;
+  }
+
+#if defined(NJS_INTEGRATE_NODE)
+  //! Creates the module data of the current isolate, should be called by the
+  //! `NJS_MODULE` initializer. The data is destroyed with the environment, so
+  //! each worker thread has its own and doesn't share it with other threads.
+  template<typename T, typename... ARGS>
+  NJS_NOINLINE Result newModuleData(ARGS&&... args) noexcept {
+    if (Internal::ModuleDataSlot<T>::data)
+      return Globals::kResultInvalidState;
+
+    T* data = new(std::nothrow) T(std::forward<ARGS>(args)...);
+    if (!data)
+      return Globals::kResultOutOfMemory;
+
+    Internal::ModuleDataSlot<T>::data = data;
+    ::node::AddEnvironmentCleanupHook(v8Isolate(), Internal::ModuleDataSlot<T>::destroy, data);
+    return Globals::kResultOk;
+  }
+#endif // NJS_INTEGRATE_NODE
+
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
@@ -1291,6 +1522,242 @@ public:
   v8::HandleScope _handleScope;
 };
 
+// ============================================================================
+// [njs::EscapableHandleScope]
+// ============================================================================
+
+//! Handle scope that can promote a single value to the enclosing scope, used
+//! by helpers that create many locals but return only one of them.
+class EscapableHandleScope {
+public:
+  NJS_NONCOPYABLE(EscapableHandleScope)
+
+  explicit NJS_INLINE EscapableHandleScope(const Context& ctx) noexcept
+    : _handleScope(ctx.v8Isolate()) {}
+
+  explicit NJS_INLINE EscapableHandleScope(v8::Isolate* isolate) noexcept
+    : _handleScope(isolate) {}
+
+  //! Returns `value` as a local of the enclosing scope, can be called once.
+  NJS_INLINE Value escape(const Value& value) noexcept {
+    return Value(_handleScope.Escape(value._handle));
+  }
+
+  // --------------------------------------------------------------------------
+  // [V8-Specific]
+  // --------------------------------------------------------------------------
+
+  NJS_INLINE v8::EscapableHandleScope& v8HandleScope() noexcept { return _handleScope; }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  //! V8's escapable handle scope.
+  v8::EscapableHandleScope _handleScope;
+};
+
+// ============================================================================
+// [njs::ScopedLoop]
+// ============================================================================
+
+//! Bounds the number of locals created by a native loop by replacing its handle
+//! scope by a new one every `interval` iterations:
+//!
+//! ```
+//! ScopedLoop loop(ctx);
+//! for (uint32_t i = 0; i < n; i++, loop.next()) {
+//!   Value item = ctx.propertyAt(array, i);
+//!   ...
+//! }
+//! ```
+//!
+//! Locals created inside the loop must not be used after `next()`. Values that
+//! must survive are either stored into an object created before the loop, or
+//! escaped by `escape()`. Use `EscapableHandleScope` to return such object from
+//! a helper function.
+class ScopedLoop {
+public:
+  NJS_NONCOPYABLE(ScopedLoop)
+
+  enum : uint32_t {
+    //! Default number of iterations per handle scope.
+    kDefaultInterval = 1024
+  };
+
+  explicit NJS_INLINE ScopedLoop(const Context& ctx, uint32_t interval = kDefaultInterval) noexcept
+    : _isolate(ctx.v8Isolate()),
+      _interval(interval ? interval : 1u),
+      _count(0) {
+    _open();
+  }
+
+  NJS_INLINE ~ScopedLoop() noexcept { _close(); }
+
+  //! Must be called once per iteration.
+  NJS_INLINE void next() noexcept {
+    if (++_count == _interval) {
+      _count = 0;
+      _close();
+      _open();
+    }
+  }
+
+  //! Returns `value` as a local of the scope enclosing the loop, which survives
+  //! `next()`. A handle scope can only escape a single value, so this starts a
+  //! new batch and other locals created since the last batch started must not
+  //! be used after it. Meant for the few values that must survive, like search
+  //! results, each batch adds a single handle to the enclosing scope.
+  NJS_INLINE Value escape(const Value& value) noexcept {
+    Value escaped(_scope()->Escape(value._handle));
+
+    _count = 0;
+    _close();
+    _open();
+    return escaped;
+  }
+
+  // `v8::EscapableHandleScope` can't be allocated by `new`, only placement new
+  // by the global operator bypasses that.
+  NJS_INLINE v8::EscapableHandleScope* _scope() noexcept { return reinterpret_cast<v8::EscapableHandleScope*>(_storage); }
+  NJS_INLINE void _open() noexcept { ::new (static_cast<void*>(_storage)) v8::EscapableHandleScope(_isolate); }
+  NJS_INLINE void _close() noexcept { _scope()->~EscapableHandleScope(); }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  v8::Isolate* _isolate;
+  uint32_t _interval;
+  uint32_t _count;
+  //! Storage of the current `v8::EscapableHandleScope`.
+  alignas(v8::EscapableHandleScope) unsigned char _storage[sizeof(v8::EscapableHandleScope)];
+};
+
+// ============================================================================
+// [njs::CallSite]
+// ============================================================================
+
+//! Calls the same JS function many times from a native loop, like a visitor,
+//! a comparator, or a filter:
+//!
+//! ```
+//! CallSite<2> site(ctx, callback, ctx.undefined());
+//! for (uint32_t i = 0; i < n; i++, site.next()) {
+//!   Value result = site.call(ctx.propertyAt(array, i), ctx.newValue(i));
+//!   if (!result.isValid())
+//!     return site.rethrow();
+//!   ...
+//! }
+//! ```
+//!
+//! The function and the receiver are bound once and arguments are passed in a
+//! reusable buffer of at most `N` values. All calls run under a single try-catch
+//! and the first exception aborts the call site, later calls return an invalid
+//! value without calling into JS. Use `rethrow()` to propagate the exception,
+//! otherwise it's discarded when the call site is destroyed. Like `ScopedLoop`,
+//! the call site replaces its handle scope every `interval` iterations, so all
+//! locals created inside the loop must not be used after `next()`.
+template<uint32_t N>
+class CallSite {
+public:
+  NJS_NONCOPYABLE(CallSite)
+
+  static_assert(N > 0, "CallSite requires at least one argument slot");
+
+  NJS_INLINE CallSite(Context& ctx, const Value& function, const Value& recv, uint32_t interval = ScopedLoop::kDefaultInterval) noexcept
+    : _context(ctx.v8Context()),
+      _function(function.v8HandleAs<v8::Function>()),
+      _recv(recv._handle),
+      _tryCatch(ctx.v8Isolate()),
+      _loop(ctx, interval),
+      _aborted(false),
+      _callCount(0) {
+    NJS_ASSERT(function.isFunction());
+  }
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  //! Returns whether a call has thrown.
+  NJS_INLINE bool aborted() const noexcept { return _aborted; }
+  //! Returns the number of calls made into JS.
+  NJS_INLINE uint64_t callCount() const noexcept { return _callCount; }
+
+  // --------------------------------------------------------------------------
+  // [Call]
+  // --------------------------------------------------------------------------
+
+  //! Calls the function with `args` and returns its result, or an invalid
+  //! value if it has thrown now or before.
+  template<typename... ARGS>
+  NJS_INLINE Value call(ARGS&&... args) noexcept {
+    static_assert(sizeof...(ARGS) <= N, "Too many arguments passed to CallSite::call()");
+
+    if (_aborted)
+      return Value();
+
+    _setArgs(0, std::forward<ARGS>(args)...);
+    return _call(uint32_t(sizeof...(ARGS)));
+  }
+
+  //! Rebinds the call site to another `function`, the receiver is kept.
+  NJS_INLINE void setFunction(const Value& function) noexcept {
+    NJS_ASSERT(function.isFunction());
+    _function = function.v8HandleAs<v8::Function>();
+  }
+
+  //! Must be called once per iteration, see `ScopedLoop::next()`.
+  NJS_INLINE void next() noexcept { _loop.next(); }
+
+  //! Propagates the exception that aborted the call site, returns a result to
+  //! be returned by the binding.
+  NJS_INLINE Result rethrow() noexcept {
+    NJS_ASSERT(_aborted);
+    _tryCatch.ReThrow();
+    return Globals::kResultBypass;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  NJS_INLINE void _setArgs(uint32_t index) noexcept {}
+
+  template<typename... ARGS>
+  NJS_INLINE void _setArgs(uint32_t index, const Value& arg, ARGS&&... args) noexcept {
+    _argv[index] = arg._handle;
+    _setArgs(index + 1, std::forward<ARGS>(args)...);
+  }
+
+  NJS_NOINLINE Value _call(uint32_t argc) noexcept {
+    _callCount++;
+
+    v8::Local<v8::Value> result;
+    if (!_function->Call(_context, _recv, int(argc), _argv).ToLocal(&result)) {
+      _aborted = true;
+      return Value();
+    }
+    return Value(result);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  v8::Local<v8::Context> _context;
+  v8::Local<v8::Function> _function;
+  v8::Local<v8::Value> _recv;
+  //! Catches the first exception, must be created before `_loop`.
+  v8::TryCatch _tryCatch;
+  ScopedLoop _loop;
+  bool _aborted;
+  uint64_t _callCount;
+  //! Argument buffer reused by all calls.
+  v8::Local<v8::Value> _argv[N];
+};
+
 // ============================================================================
 // [njs::ScopedContext]
 // ============================================================================
@@ -1314,6 +1781,145 @@ public:
       Context(isolate, handle) {}
 };
 
+// ============================================================================
+// [njs::Internal::RealmCache]
+// ============================================================================
+
+namespace Internal {
+  // Functions compiled by `runScript()` belong to the context (realm) they are
+  // compiled in and use its built-ins, so they are cached per context. Values
+  // are stored on the global object under a private key, which is the same in
+  // all contexts of the isolate.
+  static NJS_NOINLINE v8::Local<v8::Private> realmCacheKey(Context& ctx, const char* name) noexcept {
+    Value description = ctx.newInternalizedString(Latin1Ref(name));
+    return v8::Private::ForApi(ctx.v8Isolate(), description.v8HandleAs<v8::String>());
+  }
+
+  // Returns the value cached in the current context or an invalid value.
+  static NJS_NOINLINE Value realmCached(Context& ctx, const char* name) noexcept {
+    v8::Local<v8::Context> context = ctx.v8Context();
+    v8::Local<v8::Value> value;
+
+    if (!context->Global()->GetPrivate(context, realmCacheKey(ctx, name)).ToLocal(&value) || value->IsUndefined())
+      return Value();
+    return Value(value);
+  }
+
+  static NJS_NOINLINE bool setRealmCached(Context& ctx, const char* name, const Value& value) noexcept {
+    v8::Local<v8::Context> context = ctx.v8Context();
+    return context->Global()->SetPrivate(context, realmCacheKey(ctx, name), value.v8Handle()).FromMaybe(false);
+  }
+} // {Internal}
+
+// ============================================================================
+// [njs::Internal::LazyError]
+// ============================================================================
+
+namespace Internal {
+  // Creates errors that inherit from the built-in error of `type`, but don't
+  // capture a stack trace and only keep the result and its payload words. The
+  // message getter formats the message once and replaces itself with it, the
+  // setter replaces it with the assigned message, like a regular error has.
+  static const char lazyErrorSource[] =
+    "(function(format) {\n"
+    "  var kPayload = Symbol('njs.payload');\n"
+    "  function define(error, message) {\n"
+    "    Object.defineProperty(error, 'message', { value: message, writable: true, configurable: true });\n"
+    "  }\n"
+    "  var protos = [Error, Error, TypeError, RangeError, SyntaxError, ReferenceError].map(function(Base) {\n"
+    "    var proto = Object.create(Base.prototype);\n"
+    "    Object.defineProperty(proto, 'message', {\n"
+    "      configurable: true,\n"
+    "      get: function() {\n"
+    "        var p = this[kPayload];\n"
+    "        var message = format(p[0], p[1], p[2]);\n"
+    "        define(this, message);\n"
+    "        return message;\n"
+    "      },\n"
+    "      set: function(message) {\n"
+    "        define(this, message);\n"
+    "      }\n"
+    "    });\n"
+    "    return proto;\n"
+    "  });\n"
+    "  return function(type, code, result, first, second) {\n"
+    "    var error = Object.create(protos[type]);\n"
+    "    error.code = code;\n"
+    "    error[kPayload] = [result, first, second];\n"
+    "    return error;\n"
+    "  };\n"
+    "})";
+
+  // Formats the message of a lazy error, see `formatError()`.
+  static NJS_NOINLINE void lazyErrorFormat(const NativeFunctionInfo& info) noexcept {
+    Context ctx(info.GetIsolate(), info.GetIsolate()->GetCurrentContext());
+
+    uint32_t result;
+    double first, second;
+
+    if (ctx.unpack(Value(info[0]), result) != Globals::kResultOk ||
+        ctx.unpack(Value(info[1]), first) != Globals::kResultOk ||
+        ctx.unpack(Value(info[2]), second) != Globals::kResultOk)
+      return;
+
+    ResultPayload payload;
+    payload.any.first = intptr_t(first);
+    payload.any.second = intptr_t(second);
+
+    char msgBuf[Globals::kMaxBufferSize];
+    unsigned int exceptionType;
+
+    const char* msg = formatError(msgBuf, exceptionType, result, payload);
+    info.GetReturnValue().Set(ctx.newString(Utf8Ref(msg)).v8Handle());
+  }
+
+  // Returns the factory of lazy errors, compiled once per context, so errors
+  // inherit from the built-in errors of the context they are thrown in.
+  static NJS_NOINLINE Value lazyErrorFactory(Context& ctx) noexcept {
+    static const char kCacheName[] = "njs.lazyErrorFactory";
+
+    Value fn = realmCached(ctx, kCacheName);
+    if (fn.isValid())
+      return fn;
+
+    Value source = ctx.newString(Latin1Ref(lazyErrorSource));
+    Value init = source.isValid() ? ctx.runScript(source) : Value();
+    Value format = ctx.newFunction(lazyErrorFormat, ctx.newExternal(nullptr));
+    fn = init.isValid() && init.isFunction() && format.isValid() ? ctx.call(init, ctx.undefined(), format) : Value();
+
+    if (!fn.isValid() || !fn.isFunction())
+      return Value();
+
+    setRealmCached(ctx, kCacheName, fn);
+    return fn;
+  }
+
+  // Throws a lazy error of `result`, returns false if `result` can't be thrown
+  // lazily or creating the error failed.
+  static NJS_NOINLINE bool throwLazyError(Context& ctx, Result result, const ResultPayloadBase& payload) noexcept {
+    unsigned int type = lazyErrorType(result);
+    if (type == Globals::kExceptionNone)
+      return false;
+
+    Value factory = lazyErrorFactory(ctx);
+    if (!factory.isValid())
+      return false;
+
+    Value error = ctx.call(factory, ctx.undefined(),
+      ctx.newValue(type),
+      ctx.newString(Latin1Ref(resultCodeName(result))),
+      ctx.newValue(uint32_t(result)),
+      ctx.newValue(double(payload.any.first)),
+      ctx.newValue(double(payload.any.second)));
+
+    if (!error.isValid())
+      return false;
+
+    ctx.Throw(error);
+    return true;
+  }
+} // {Internal}
+
 // ============================================================================
 // [njs::ExecutionContext]
 // ============================================================================
@@ -1334,8 +1940,12 @@ public:
 
   //! Handle a `result` returned from a native function (binding).
   NJS_INLINE void _handleResult(Result result) noexcept {
-    if (result != Globals::kResultOk)
+    // `kResultBypass` means that an exception is already pending.
+    if (result != Globals::kResultOk && result != Globals::kResultBypass) {
+      if (Internal::lazyErrorsEnabled() && Internal::throwLazyError(*this, result, _payload))
+        return;
       Internal::reportError<Context>(*this, result, _payload);
+    }
   }
 };
 
@@ -1379,6 +1989,11 @@ public:
     return Internal::v8ReturnWithConcept<T, Concept>(*this, rv, value, concept);
   }
 
+  // Returns the value set by `returnValue()` (undefined if it wasn't called).
+  NJS_INLINE Value returnedValue() const noexcept {
+    return Value(_info.GetReturnValue().Get());
+  }
+
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
@@ -1519,6 +2134,11 @@ public:
     return Internal::v8ReturnWithConcept<T, Concept>(*this, rv, value, concept);
   }
 
+  // Returns the value set by `returnValue()` (undefined if it wasn't called).
+  NJS_INLINE Value returnedValue() const noexcept {
+    return Value(_info.GetReturnValue().Get());
+  }
+
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
@@ -1737,6 +2357,16 @@ namespace Internal {
     return Globals::kResultOk;
   }
 
+  static NJS_INLINE v8::ConstructorBehavior v8FunctionConstructorBehavior(unsigned int flags) noexcept {
+    return (flags & BindingItem::kFlagNoConstruct) ? v8::ConstructorBehavior::kThrow
+                                                   : v8::ConstructorBehavior::kAllow;
+  }
+
+  static NJS_INLINE v8::SideEffectType v8FunctionSideEffectType(unsigned int flags) noexcept {
+    return (flags & BindingItem::kFlagNoSideEffect) ? v8::SideEffectType::kHasNoSideEffect
+                                                    : v8::SideEffectType::kHasSideEffect;
+  }
+
   static NJS_NOINLINE Result v8BindClassHelper(
     Context& ctx,
     Value exports,
@@ -1750,36 +2380,42 @@ namespace Internal {
 
     for (unsigned int i = 0; i < count; i++) {
       const BindingItem& item = items[i];
+      unsigned int flags = item.flags;
 
       Value name = ctx.newInternalizedString(Latin1Ref(item.name));
       NJS_CHECK(name);
 
       switch (item.type) {
-        case BindingItem::kTypeStatic: {
-          v8::Local<v8::FunctionTemplate> fnTemplate = v8::FunctionTemplate::New(
-            ctx.v8Isolate(), (v8::FunctionCallback)item.data, exports.v8HandleAs<v8::Value>());
-          fnTemplate->SetClassName(name.v8HandleAs<v8::String>());
-          classObj->Set(name.v8HandleAs<v8::String>(), fnTemplate);
-          break;
-        }
-
+        case BindingItem::kTypeStatic:
         case BindingItem::kTypeMethod: {
-          // Signature is only created when needed and then cached.
-          if (methodSignature.IsEmpty())
-            methodSignature = v8::Signature::New(ctx.v8Isolate(), classObj);
+          v8::Local<v8::Signature> signature;
+          if (item.type == BindingItem::kTypeMethod) {
+            // Signature is only created when needed and then cached.
+            if (methodSignature.IsEmpty())
+              methodSignature = v8::Signature::New(ctx.v8Isolate(), classObj);
+            signature = methodSignature;
+          }
 
           v8::Local<v8::FunctionTemplate> fnTemplate = v8::FunctionTemplate::New(
-            ctx.v8Isolate(), (v8::FunctionCallback)item.data, exports.v8HandleAs<v8::Value>(), methodSignature);
-
+            ctx.v8Isolate(), (v8::FunctionCallback)item.data, exports.v8HandleAs<v8::Value>(), signature, 0,
+            v8FunctionConstructorBehavior(flags), v8FunctionSideEffectType(flags));
           fnTemplate->SetClassName(name.v8HandleAs<v8::String>());
-          prototype->Set(name.v8HandleAs<v8::String>(), fnTemplate);
+
+          int attr = v8::None;
+          if (flags & BindingItem::kFlagDontEnum) attr |= v8::DontEnum;
+          if (flags & BindingItem::kFlagReadOnly) attr |= v8::ReadOnly;
+
+          if (item.type == BindingItem::kTypeStatic)
+            classObj->Set(name.v8HandleAs<v8::String>(), fnTemplate, static_cast<v8::PropertyAttribute>(attr));
+          else
+            prototype->Set(name.v8HandleAs<v8::String>(), fnTemplate, static_cast<v8::PropertyAttribute>(attr));
           break;
         }
 
         case BindingItem::kTypeGetter:
         case BindingItem::kTypeSetter: {
           unsigned int pairedType;
-          int attr = v8::DontEnum | v8::DontDelete;
+          int attr = v8::DontDelete;
 
           v8::AccessorGetterCallback getter = nullptr;
           v8::AccessorSetterCallback setter = nullptr;
@@ -1799,6 +2435,7 @@ namespace Internal {
               getter = (v8::AccessorGetterCallback)nextItem.data;
             else
               setter = (v8::AccessorSetterCallback)nextItem.data;
+            flags |= nextItem.flags;
             i++;
           }
 
@@ -1812,11 +2449,15 @@ namespace Internal {
           if (accessorSignature.IsEmpty())
             accessorSignature = v8::AccessorSignature::New(ctx.v8Isolate(), classObj);
 
-          if (!setter)
+          if (!setter || (flags & BindingItem::kFlagReadOnly))
             attr |= v8::ReadOnly;
 
+          if (!(flags & BindingItem::kFlagEnumerable))
+            attr |= v8::DontEnum;
+
           prototype->SetAccessor(
-            name.v8HandleAs<v8::String>(), getter, setter, exports.v8HandleAs<v8::Value>(), v8::DEFAULT, static_cast<v8::PropertyAttribute>(attr), accessorSignature);
+            name.v8HandleAs<v8::String>(), getter, setter, exports.v8HandleAs<v8::Value>(), v8::DEFAULT, static_cast<v8::PropertyAttribute>(attr), accessorSignature,
+            v8FunctionSideEffectType(flags));
           break;
         }
 
@@ -2031,6 +2672,9 @@ public:                                                                       \
 // NOTE: All of these functions use V8 signatures to ensure that `This()`
 // points to a correct object. This means that it's safe to directly use
 // `Internal::v8UnwrapNativeUnchecked<>`.
+//
+// Static, method, getter, and setter macros accept optional `BindingItem`
+// flags after the name, like `NJS_BIND_METHOD(area, kFlagNoConstruct)`.
 
 #define NJS_BIND_CLASS(SELF) \
   struct SELF::Bindings : public ::njs::Internal::V8ClassBindings< SELF >
@@ -2070,7 +2714,7 @@ public:                                                                       \
     ctx._handleResult(result);                                                \
   }
 
-#define NJS_BIND_STATIC(NAME)                                                 \
+#define NJS_BIND_STATIC(NAME, ...)                                            \
   static NJS_NOINLINE void StaticFunc_##NAME(                                 \
       const ::v8::FunctionCallbackInfo< ::v8::Value >& info) noexcept {       \
                                                                               \
@@ -2080,13 +2724,15 @@ public:                                                                       \
                                                                               \
   struct StaticInfo_##NAME : public ::njs::BindingItem {                      \
     NJS_INLINE StaticInfo_##NAME() noexcept                                   \
-      : BindingItem(kTypeStatic, 0, #NAME, (const void*)StaticFunc_##NAME) {} \
+      : BindingItem(kTypeStatic,                                              \
+                    ::njs::Internal::bindingFlags(__VA_ARGS__),               \
+                    #NAME, (const void*)StaticFunc_##NAME) {}                 \
   } staticinfo_##NAME;                                                        \
                                                                               \
   static NJS_INLINE ::njs::Result StaticImpl_##NAME(                          \
     ::njs::FunctionCallContext& ctx) noexcept
 
-#define NJS_BIND_METHOD(NAME)                                                 \
+#define NJS_BIND_METHOD(NAME, ...)                                            \
   static NJS_NOINLINE void MethodFunc_##NAME(                                 \
       const ::v8::FunctionCallbackInfo< ::v8::Value >& info) noexcept {       \
                                                                               \
@@ -2098,13 +2744,15 @@ public:                                                                       \
                                                                               \
   struct MethodInfo_##NAME : public ::njs::BindingItem {                      \
     NJS_INLINE MethodInfo_##NAME() noexcept                                   \
-      : BindingItem(kTypeMethod, 0, #NAME, (const void*)MethodFunc_##NAME) {} \
+      : BindingItem(kTypeMethod,                                              \
+                    ::njs::Internal::bindingFlags(__VA_ARGS__),               \
+                    #NAME, (const void*)MethodFunc_##NAME) {}                 \
   } methodinfo_##NAME;                                                        \
                                                                               \
   static NJS_INLINE ::njs::Result MethodImpl_##NAME(                          \
     ::njs::FunctionCallContext& ctx, Type* self) noexcept
 
-#define NJS_BIND_GET(NAME)                                                    \
+#define NJS_BIND_GET(NAME, ...)                                               \
   static NJS_NOINLINE void GetFunc_##NAME(                                    \
       ::v8::Local< ::v8::String > property,                                   \
       const ::v8::PropertyCallbackInfo< ::v8::Value >& info) noexcept {       \
@@ -2117,13 +2765,15 @@ public:                                                                       \
                                                                               \
   struct GetInfo_##NAME : public ::njs::BindingItem {                         \
     NJS_INLINE GetInfo_##NAME() noexcept                                      \
-      : BindingItem(kTypeGetter, 0, #NAME, (const void*)GetFunc_##NAME) {}    \
+      : BindingItem(kTypeGetter,                                              \
+                    ::njs::Internal::bindingFlags(__VA_ARGS__),               \
+                    #NAME, (const void*)GetFunc_##NAME) {}                    \
   } GetInfo_##NAME;                                                           \
                                                                               \
   static NJS_INLINE ::njs::Result GetImpl_##NAME(                             \
     ::njs::GetPropertyContext& ctx, Type* self) noexcept
 
-#define NJS_BIND_SET(NAME)                                                    \
+#define NJS_BIND_SET(NAME, ...)                                               \
   static NJS_NOINLINE void SetFunc_##NAME(                                    \
       ::v8::Local< ::v8::String > property,                                   \
       ::v8::Local< ::v8::Value > value,                                       \
@@ -2139,7 +2789,9 @@ public:                                                                       \
                                                                               \
   struct SetInfo_##NAME : public ::njs::BindingItem {                         \
     NJS_INLINE SetInfo_##NAME() noexcept                                      \
-      : BindingItem(kTypeSetter, 0, #NAME, (const void*)SetFunc_##NAME) {}    \
+      : BindingItem(kTypeSetter,                                              \
+                    ::njs::Internal::bindingFlags(__VA_ARGS__),               \
+                    #NAME, (const void*)SetFunc_##NAME) {}                    \
   } setinfo_##NAME;                                                           \
                                                                               \
   static NJS_INLINE ::njs::Result SetImpl_##NAME(                             \
@@ -0,0 +1,311 @@
+// [NJS-API]
+// Native JavaScript API for Bindings.
+//
+// [License]
+// Public Domain <http://unlicense.org>
+
+// This header implements a cache extension. Native caches that V8 doesn't know
+// about can register to `CacheRegistry`, which trims them when the garbage
+// collector runs, when the process is under memory pressure, or when memory
+// used by the process exceeds a threshold.
+
+#ifndef NJS_EXTENSION_CACHE_H
+#define NJS_EXTENSION_CACHE_H
+
+#include "./njs-api.h"
+
+#if !defined(NJS_ENGINE_V8) || !defined(NJS_INTEGRATE_LIBUV)
+# error "[njs] Cache extension requires V8 engine and libuv integration."
+#endif
+
+namespace njs {
+
+class CacheRegistry;
+
+// ============================================================================
+// [njs::TrimLevel]
+// ============================================================================
+
+enum TrimLevel : uint32_t {
+  //! Full GC finished, drop what's cheap to recreate.
+  kTrimLevelLight = 0,
+  //! Memory threshold exceeded or moderate memory pressure, drop what's not used.
+  kTrimLevelModerate = 1,
+  //! Critical memory pressure, drop everything possible.
+  kTrimLevelCritical = 2,
+
+  kTrimLevelCount = 3
+};
+
+// ============================================================================
+// [njs::CacheTrimmer]
+// ============================================================================
+
+//! A native cache that can be trimmed by `CacheRegistry`.
+class CacheTrimmer {
+public:
+  NJS_NONCOPYABLE(CacheTrimmer)
+
+  NJS_INLINE CacheTrimmer() noexcept
+    : _registry(nullptr),
+      _prev(nullptr),
+      _next(nullptr) {}
+  virtual ~CacheTrimmer() noexcept;
+
+  //! Releases memory according to `level` (see `TrimLevel`) and returns the
+  //! number of bytes freed. It's called on the JS thread, possibly from a GC
+  //! callback, so it must not touch JS values nor (un)register caches.
+  virtual size_t onTrim(uint32_t level) noexcept = 0;
+
+  NJS_INLINE CacheRegistry* registry() const noexcept { return _registry; }
+
+  CacheRegistry* _registry;
+  CacheTrimmer* _prev;
+  CacheTrimmer* _next;
+};
+
+// ============================================================================
+// [njs::CacheStats]
+// ============================================================================
+
+struct CacheStats {
+  NJS_INLINE void reset() noexcept {
+    for (uint32_t i = 0; i < kTrimLevelCount; i++)
+      trimCount[i] = 0;
+    skippedCount = 0;
+    bytesFreed = 0;
+    lastTrimTime = 0;
+  }
+
+  //! Number of trims per level.
+  uint64_t trimCount[kTrimLevelCount];
+  //! Number of trims skipped because of rate limiting.
+  uint64_t skippedCount;
+  //! Total bytes freed by all trims.
+  uint64_t bytesFreed;
+  //! Time of the last trim (`uv_hrtime()`, in nanoseconds).
+  uint64_t lastTrimTime;
+};
+
+// ============================================================================
+// [njs::CacheRegistry]
+// ============================================================================
+
+//! Registry of native caches of a single isolate.
+//!
+//! Once installed, the registry trims its caches after each full GC. It trims
+//! them more aggressively when V8 collects all available garbage (which is what
+//! it does under critical memory pressure), when `notifyMemoryPressure()` is
+//! called, or when the resident set size or the external memory reported to
+//! V8 exceeds its threshold. Trims are rate-limited per level, except critical
+//! ones, so frequent light trims never hold back a moderate one.
+class CacheRegistry {
+public:
+  NJS_NONCOPYABLE(CacheRegistry)
+
+  enum : uint32_t {
+    //! Default minimum interval between two trims, in milliseconds.
+    kDefaultMinInterval = 1000
+  };
+
+  NJS_INLINE CacheRegistry() noexcept
+    : _isolate(nullptr),
+      _first(nullptr),
+      _notifying(false),
+      _rssThreshold(0),
+      _externalThreshold(0),
+      _minInterval(uint64_t(kDefaultMinInterval) * 1000000u) {
+    for (uint32_t i = 0; i < kTrimLevelCount; i++)
+      _lastTrimTime[i] = 0;
+    _stats.reset();
+  }
+
+  NJS_INLINE ~CacheRegistry() noexcept {
+    uninstall();
+    while (_first)
+      remove(_first);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Install]
+  // --------------------------------------------------------------------------
+
+  //! Installs the GC callback to the isolate of `runtime`.
+  NJS_NOINLINE void install(const Runtime& runtime) noexcept {
+    if (_isolate)
+      return;
+
+    _isolate = runtime.v8Isolate();
+    _isolate->AddGCEpilogueCallback(onGCEpilogue, this, v8::kGCTypeMarkSweepCompact);
+  }
+
+  NJS_NOINLINE void uninstall() noexcept {
+    if (!_isolate)
+      return;
+
+    _isolate->RemoveGCEpilogueCallback(onGCEpilogue, this);
+    _isolate = nullptr;
+  }
+
+  NJS_INLINE bool isInstalled() const noexcept { return _isolate != nullptr; }
+
+  // --------------------------------------------------------------------------
+  // [Caches]
+  // --------------------------------------------------------------------------
+
+  NJS_NOINLINE void add(CacheTrimmer* cache) noexcept {
+    NJS_ASSERT(cache->_registry == nullptr);
+
+    cache->_registry = this;
+    cache->_prev = nullptr;
+    cache->_next = _first;
+
+    if (_first)
+      _first->_prev = cache;
+    _first = cache;
+  }
+
+  NJS_NOINLINE void remove(CacheTrimmer* cache) noexcept {
+    NJS_ASSERT(cache->_registry == this);
+
+    if (cache->_prev)
+      cache->_prev->_next = cache->_next;
+    else
+      _first = cache->_next;
+
+    if (cache->_next)
+      cache->_next->_prev = cache->_prev;
+
+    cache->_registry = nullptr;
+    cache->_prev = nullptr;
+    cache->_next = nullptr;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Policy]
+  // --------------------------------------------------------------------------
+
+  //! Sets resident set size and external memory thresholds, in bytes. Caches
+  //! are trimmed at moderate level after a full GC if either is exceeded. Zero
+  //! disables the threshold.
+  NJS_INLINE void setThresholds(size_t rssThreshold, size_t externalThreshold) noexcept {
+    _rssThreshold = rssThreshold;
+    _externalThreshold = externalThreshold;
+  }
+
+  //! Sets the minimum interval between two trims, in milliseconds.
+  NJS_INLINE void setMinInterval(uint32_t ms) noexcept {
+    _minInterval = uint64_t(ms) * 1000000u;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Trim]
+  // --------------------------------------------------------------------------
+
+  //! Trims all caches at `level` and returns the number of bytes freed. The
+  //! trim is skipped if a trim at the same or a higher level happened less
+  //! than the minimum interval ago, unless `level` is critical.
+  NJS_NOINLINE size_t trim(uint32_t level) noexcept {
+    NJS_ASSERT(level < kTrimLevelCount);
+
+    uint64_t now = uv_hrtime();
+    uint64_t last = _lastTrimTime[level];
+
+    if (level != kTrimLevelCritical && last && now - last < _minInterval) {
+      _stats.skippedCount++;
+      return 0;
+    }
+
+    size_t freed = 0;
+    for (CacheTrimmer* cache = _first; cache; cache = cache->_next)
+      freed += cache->onTrim(level);
+
+    _stats.trimCount[level]++;
+    _stats.bytesFreed += freed;
+    _stats.lastTrimTime = now;
+
+    // A trim also does what a trim at any lower level would do.
+    for (uint32_t i = 0; i <= level; i++)
+      _lastTrimTime[i] = now;
+    return freed;
+  }
+
+  //! Notifies V8 and trims all caches, `level` must be moderate or critical.
+  NJS_NOINLINE size_t notifyMemoryPressure(uint32_t level) noexcept {
+    NJS_ASSERT(level == kTrimLevelModerate || level == kTrimLevelCritical);
+
+    size_t freed = trim(level);
+
+    // V8 can collect garbage synchronously here, the caches were just trimmed.
+    if (_isolate) {
+      _notifying = true;
+      _isolate->MemoryPressureNotification(level == kTrimLevelCritical ? v8::MemoryPressureLevel::kCritical
+                                                                       : v8::MemoryPressureLevel::kModerate);
+      _notifying = false;
+    }
+
+    return freed;
+  }
+
+  NJS_INLINE const CacheStats& stats() const noexcept { return _stats; }
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  // Returns the level of a trim after a full GC.
+  NJS_NOINLINE uint32_t _levelAfterGC(v8::GCCallbackFlags flags) noexcept {
+    if (flags & (v8::kGCCallbackFlagCollectAllAvailableGarbage | v8::kGCCallbackFlagCollectAllExternalMemory))
+      return kTrimLevelCritical;
+
+    if (_rssThreshold) {
+      size_t rss = 0;
+      if (uv_resident_set_memory(&rss) == 0 && rss > _rssThreshold)
+        return kTrimLevelModerate;
+    }
+
+    if (_externalThreshold) {
+      v8::HeapStatistics heapStats;
+      _isolate->GetHeapStatistics(&heapStats);
+      if (heapStats.external_memory() > _externalThreshold)
+        return kTrimLevelModerate;
+    }
+
+    return kTrimLevelLight;
+  }
+
+  static NJS_NOINLINE void onGCEpilogue(v8::Isolate* isolate, v8::GCType type, v8::GCCallbackFlags flags, void* data) noexcept {
+    CacheRegistry* self = static_cast<CacheRegistry*>(data);
+    if (self->_first && !self->_notifying)
+      self->trim(self->_levelAfterGC(flags));
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  //! Isolate the GC callback is installed to.
+  v8::Isolate* _isolate;
+  //! First registered cache.
+  CacheTrimmer* _first;
+  //! Whether `notifyMemoryPressure()` is notifying V8.
+  bool _notifying;
+
+  size_t _rssThreshold;
+  size_t _externalThreshold;
+  //! Minimum interval between two trims, in nanoseconds.
+  uint64_t _minInterval;
+  //! Time of the last trim at each level or above (`uv_hrtime()`).
+  uint64_t _lastTrimTime[kTrimLevelCount];
+
+  CacheStats _stats;
+};
+
+NJS_INLINE CacheTrimmer::~CacheTrimmer() noexcept {
+  if (_registry)
+    _registry->remove(this);
+}
+
+} // {njs}
+
+#endif // NJS_EXTENSION_CACHE_H
@@ -0,0 +1,134 @@
+// [NJS-API]
+// Native JavaScript API for Bindings.
+//
+// [License]
+// Public Domain <http://unlicense.org>
+
+// This header implements a columns extension. `njs::unpackColumns()` converts
+// an array of plain objects like `[{ x, y }, ...]` into native columns (one
+// array per field) in a single pass.
+
+#ifndef NJS_EXTENSION_COLUMNS_H
+#define NJS_EXTENSION_COLUMNS_H
+
+#include "./njs-api.h"
+
+#if !defined(NJS_ENGINE_V8)
+# error "[njs] Columns extension requires V8 engine."
+#endif
+
+namespace njs {
+
+// ============================================================================
+// [njs::ColumnField]
+// ============================================================================
+
+//! Describes a field unpacked into a native column.
+struct ColumnField {
+  enum Type : uint32_t {
+    kTypeDouble = 0,
+    kTypeFloat = 1,
+    kTypeInt32 = 2,
+    kTypeUint32 = 3
+  };
+
+  static NJS_INLINE ColumnField ofDouble(const char* name, double* data) noexcept { return ColumnField { name, kTypeDouble, data }; }
+  static NJS_INLINE ColumnField ofFloat(const char* name, float* data) noexcept { return ColumnField { name, kTypeFloat, data }; }
+  static NJS_INLINE ColumnField ofInt32(const char* name, int32_t* data) noexcept { return ColumnField { name, kTypeInt32, data }; }
+  static NJS_INLINE ColumnField ofUint32(const char* name, uint32_t* data) noexcept { return ColumnField { name, kTypeUint32, data }; }
+
+  //! Property name (LATIN-1).
+  const char* name;
+  //! Type of the column, see `Type`.
+  uint32_t type;
+  //! Column, must have room for all items.
+  void* data;
+};
+
+// ============================================================================
+// [njs::unpackColumns]
+// ============================================================================
+
+namespace Internal {
+  template<typename T>
+  static NJS_INLINE Result unpackColumnItem(Context& ctx, const Value& value, void* data, uint32_t index) noexcept {
+    return ctx.unpack(value, static_cast<T*>(data)[index]);
+  }
+} // {Internal}
+
+enum : uint32_t {
+  //! Maximum number of fields passed to `unpackColumns()`.
+  kMaxColumnFields = 16
+};
+
+//! Unpacks `count` items of `array` into columns described by `fields`. The
+//! array must have exactly `count` items and each item must be an object that
+//! has all the fields. Errors are reported as `[index].field`. More than
+//! `kMaxColumnFields` fields is an invalid state.
+//!
+//! Field names are internalized once per call, so each property lookup is a
+//! lookup of an internalized key, and handles are released in batches. There
+//! is no public API to compare hidden classes of objects, so the lookups are
+//! not specialized for objects sharing the same one.
+template<typename ContextT>
+static NJS_NOINLINE Result unpackColumns(ContextT& ctx, const Value& array, const ColumnField* fields, uint32_t fieldCount, uint32_t count) noexcept {
+  if (fieldCount > kMaxColumnFields)
+    return Globals::kResultInvalidState;
+
+  if (!array.isArray())
+    return ctx.invalidValueTypeName("Array");
+
+  if (ctx.arrayLength(array) != count) {
+    StrUtils::sformat(ctx._payload.staticBuffer, Globals::kMaxBufferSize, "Expected %u items", count);
+    return ctx.invalidValueCustom(ctx._payload.staticBuffer);
+  }
+
+  Value keys[kMaxColumnFields];
+  for (uint32_t i = 0; i < fieldCount; i++) {
+    keys[i] = ctx.newInternalizedString(Latin1Ref(fields[i].name));
+    if (!keys[i].isValid())
+      return Globals::kResultBypass;
+  }
+
+  ScopedLoop loop(ctx);
+  for (uint32_t index = 0; index < count; index++, loop.next()) {
+    Value item = ctx.propertyAt(array, index);
+    if (!item.isValid())
+      return Globals::kResultBypass;
+
+    if (!item.isObject()) {
+      StrUtils::sformat(ctx._payload.staticBuffer, Globals::kMaxBufferSize, "[%u]: Expected Object", index);
+      return ctx.invalidValueCustom(ctx._payload.staticBuffer);
+    }
+
+    for (uint32_t i = 0; i < fieldCount; i++) {
+      const ColumnField& field = fields[i];
+
+      Value value = ctx.propertyOf(item, keys[i]);
+      if (!value.isValid())
+        return Globals::kResultBypass;
+
+      Result result;
+      switch (field.type) {
+        case ColumnField::kTypeDouble: result = Internal::unpackColumnItem<double>(ctx, value, field.data, index); break;
+        case ColumnField::kTypeFloat : result = Internal::unpackColumnItem<float>(ctx, value, field.data, index); break;
+        case ColumnField::kTypeInt32 : result = Internal::unpackColumnItem<int32_t>(ctx, value, field.data, index); break;
+        case ColumnField::kTypeUint32: result = Internal::unpackColumnItem<uint32_t>(ctx, value, field.data, index); break;
+        default:
+          result = Globals::kResultInvalidState;
+          break;
+      }
+
+      if (result != Globals::kResultOk) {
+        StrUtils::sformat(ctx._payload.staticBuffer, Globals::kMaxBufferSize, "[%u].%s", index, field.name);
+        return ctx.invalidValueCustom(ctx._payload.staticBuffer);
+      }
+    }
+  }
+
+  return Globals::kResultOk;
+}
+
+} // {njs}
+
+#endif // NJS_EXTENSION_COLUMNS_H
@@ -0,0 +1,475 @@
+// [NJS-API]
+// Native JavaScript API for Bindings.
+//
+// [License]
+// Public Domain <http://unlicense.org>
+
+// This header implements an event emitter extension. `njs::EventEmitter` keeps
+// listeners of a wrapped object natively and calls them directly, so emitting
+// an event doesn't go through JS `EventEmitter.prototype.emit()`.
+
+#ifndef NJS_EXTENSION_EMITTER_H
+#define NJS_EXTENSION_EMITTER_H
+
+#include "./njs-api.h"
+#include "./njs-extension-map.h"
+
+#if !defined(NJS_ENGINE_V8)
+# error "[njs] Event emitter extension requires V8 engine."
+#endif
+
+namespace njs {
+
+// ============================================================================
+// [njs::ListenerList]
+// ============================================================================
+
+//! Listeners of a single event.
+//!
+//! A listener is only an index of its function in the array of functions of
+//! the emitter (see `EventEmitter`) and flags, the list holds no handles.
+//! Listeners removed while the event is being dispatched are only compacted
+//! out when the outermost dispatch finishes, so the dispatch can iterate the
+//! list by index.
+class ListenerList {
+public:
+  NJS_NONCOPYABLE(ListenerList)
+
+  enum Flags : uint32_t {
+    //! Listener is removed before it's called the first time.
+    kFlagOnce = 0x1u
+  };
+
+  enum : uint32_t {
+    kInitialCapacity = 4,
+    //! Slot of a removed listener.
+    kNoSlot = 0xFFFFFFFFu
+  };
+
+  struct Listener {
+    //! Index of the function in the array of functions of the emitter.
+    uint32_t slot;
+    uint32_t flags;
+  };
+
+  NJS_INLINE ListenerList() noexcept
+    : _data(nullptr),
+      _size(0),
+      _capacity(0),
+      _liveCount(0),
+      _dispatchDepth(0) {}
+
+  NJS_INLINE ~ListenerList() noexcept { delete[] _data; }
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  //! Returns the number of listeners that weren't removed.
+  NJS_INLINE uint32_t liveCount() const noexcept { return _liveCount; }
+  NJS_INLINE bool isDispatching() const noexcept { return _dispatchDepth != 0; }
+
+  // --------------------------------------------------------------------------
+  // [Modify]
+  // --------------------------------------------------------------------------
+
+  NJS_NOINLINE Result add(uint32_t slot, uint32_t flags) noexcept {
+    if (_size == _capacity)
+      NJS_CHECK(_grow());
+
+    _data[_size].slot = slot;
+    _data[_size].flags = flags;
+    _size++;
+
+    _liveCount++;
+    return Globals::kResultOk;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  //! Removes the listener at `index`, returns its slot.
+  NJS_INLINE uint32_t _removeAt(uint32_t index) noexcept {
+    uint32_t slot = _data[index].slot;
+    _data[index].slot = kNoSlot;
+    _liveCount--;
+
+    if (!_dispatchDepth)
+      _compact();
+    return slot;
+  }
+
+  //! Drops removed listeners, keeps the order of the others.
+  NJS_NOINLINE void _compact() noexcept {
+    uint32_t dst = 0;
+    for (uint32_t src = 0; src < _size; src++) {
+      if (_data[src].slot != kNoSlot)
+        _data[dst++] = _data[src];
+    }
+    _size = dst;
+  }
+
+  NJS_NOINLINE Result _grow() noexcept {
+    uint32_t newCapacity = _capacity ? _capacity * 2 : uint32_t(kInitialCapacity);
+    Listener* newData = new (std::nothrow) Listener[newCapacity];
+
+    if (!newData)
+      return Globals::kResultOutOfMemory;
+
+    for (uint32_t i = 0; i < _size; i++)
+      newData[i] = _data[i];
+
+    delete[] _data;
+    _data = newData;
+    _capacity = newCapacity;
+    return Globals::kResultOk;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  Listener* _data;
+  //! Number of listeners in `_data`, including removed ones during dispatch.
+  uint32_t _size;
+  uint32_t _capacity;
+  uint32_t _liveCount;
+  //! Number of dispatches in progress (listeners can emit the same event).
+  uint32_t _dispatchDepth;
+};
+
+// ============================================================================
+// [njs::EventEmitter]
+// ============================================================================
+
+//! Event emitter mixin of wrapped classes.
+//!
+//! Listeners are stored per event name in a `StringKeyMap`, so event names
+//! should be internalized strings (atoms) created once by the native side.
+//! `emit()` calls the listeners through a single `CallSite` and returns
+//! immediately if the emitter has no listeners at all, without hashing the
+//! event name.
+//!
+//! Listener functions are kept in a JS array attached to the wrapper by a
+//! private symbol, the emitter only holds a weak handle to the array. A
+//! listener that references its emitter is then a cycle the GC can collect,
+//! like one of a JS emitter. The `obj` passed to `addListener()` and `emit()`
+//! must be the wrapper of the emitter (`ctx.This()` in bound methods). Slots
+//! of removed functions are reused, a free slot holds the index of the next
+//! free one (-1 if none).
+class EventEmitter {
+public:
+  NJS_NONCOPYABLE(EventEmitter)
+
+  NJS_INLINE EventEmitter() noexcept
+    : _freeSlot(ListenerList::kNoSlot),
+      _slotCount(0) {}
+
+  NJS_INLINE ~EventEmitter() noexcept {
+    removeAllListeners();
+    _functions.release();
+  }
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  //! Returns whether any event has a listener.
+  NJS_INLINE bool hasListeners() const noexcept { return !_events.empty(); }
+
+  NJS_INLINE uint32_t listenerCount(Context& ctx, const Value& event) const noexcept {
+    ListenerList** list = _events.get(ctx, event);
+    return list ? (*list)->liveCount() : uint32_t(0);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Listeners]
+  // --------------------------------------------------------------------------
+
+  //! Adds `function` as a listener of `event`, see `ListenerList::Flags`.
+  NJS_NOINLINE Result addListener(Context& ctx, const Value& obj, const Value& event, const Value& function, uint32_t flags = 0) noexcept {
+    if (!event.isString() || !function.isFunction())
+      return Globals::kResultInvalidValue;
+
+    Value functions = _functionsOf(ctx, obj);
+    NJS_CHECK(functions);
+
+    ListenerList** entry = _events.get(ctx, event);
+    ListenerList* list = entry ? *entry : nullptr;
+
+    if (!list) {
+      list = new (std::nothrow) ListenerList();
+      if (!list)
+        return Globals::kResultOutOfMemory;
+
+      Result result = _events.insert(ctx, event, list);
+      if (result != Globals::kResultOk) {
+        delete list;
+        return result;
+      }
+    }
+
+    uint32_t slot;
+    Result result = _acquireSlot(ctx, functions, function, slot);
+
+    if (result == Globals::kResultOk) {
+      result = list->add(slot, flags);
+      if (result != Globals::kResultOk)
+        _releaseSlot(ctx, functions, slot);
+    }
+
+    if (result != Globals::kResultOk)
+      _releaseIfEmpty(ctx, event, list);
+    return result;
+  }
+
+  //! Removes the most recently added listener of `event` that is `function`,
+  //! returns true if there was such listener.
+  NJS_NOINLINE bool removeListener(Context& ctx, const Value& event, const Value& function) noexcept {
+    ListenerList** entry = _events.get(ctx, event);
+    if (!entry || !_functions.isValid())
+      return false;
+
+    ListenerList* list = *entry;
+    Value functions = ctx.makeLocal(_functions);
+
+    uint32_t i = list->_size;
+    while (i) {
+      uint32_t slot = list->_data[--i].slot;
+      if (slot != ListenerList::kNoSlot && ctx.strictEquals(ctx.propertyAt(functions, slot), function)) {
+        _releaseSlot(ctx, functions, list->_removeAt(i));
+        _releaseIfEmpty(ctx, event, list);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  //! Removes all listeners of `event`.
+  NJS_NOINLINE void removeAllListeners(Context& ctx, const Value& event) noexcept {
+    ListenerList** entry = _events.get(ctx, event);
+    if (!entry)
+      return;
+
+    ListenerList* list = *entry;
+    Value functions = _functions.isValid() ? ctx.makeLocal(_functions) : Value();
+
+    for (uint32_t i = 0; i < list->_size; i++) {
+      uint32_t slot = list->_data[i].slot;
+      if (slot != ListenerList::kNoSlot && functions.isValid())
+        _releaseSlot(ctx, functions, slot);
+      list->_data[i].slot = ListenerList::kNoSlot;
+    }
+    list->_liveCount = 0;
+
+    _releaseIfEmpty(ctx, event, list);
+  }
+
+  //! Removes all listeners of all events without touching their functions,
+  //! which are released with the wrapper. Must not be called while an event
+  //! is being dispatched.
+  NJS_NOINLINE void removeAllListeners() noexcept {
+    _events.forEach([](ListenerList* list) {
+      NJS_ASSERT(!list->isDispatching());
+      delete list;
+    });
+    _events.clear();
+  }
+
+  // --------------------------------------------------------------------------
+  // [Emit]
+  // --------------------------------------------------------------------------
+
+  //! Calls all listeners of `event` with `args` and `obj` as `this`.
+  //!
+  //! Listeners added during the dispatch are not called by it, listeners
+  //! removed during the dispatch are not called if they weren't yet. If a
+  //! listener throws, the remaining ones are skipped and the exception is
+  //! propagated (the function returns `kResultBypass`).
+  template<typename... ARGS>
+  NJS_INLINE Result emit(Context& ctx, const Value& obj, const Value& event, ARGS&&... args) noexcept {
+    if (_events.empty())
+      return Globals::kResultOk;
+
+    ListenerList** entry = _events.get(ctx, event);
+    if (!entry || !(*entry)->liveCount() || !_functions.isValid())
+      return Globals::kResultOk;
+
+    return _dispatch(ctx, obj, event, *entry, std::forward<ARGS>(args)...);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  template<typename... ARGS>
+  NJS_NOINLINE Result _dispatch(Context& ctx, const Value& obj, const Value& event, ListenerList* list, ARGS&&... args) noexcept {
+    enum : uint32_t { kArgCount = sizeof...(ARGS) ? uint32_t(sizeof...(ARGS)) : uint32_t(1) };
+
+    Value functions = ctx.makeLocal(_functions);
+
+    // Listeners added by listeners are appended, they are not part of this
+    // dispatch. The list itself stays alive until the dispatch ends.
+    uint32_t count = list->_size;
+    uint32_t i = 0;
+
+    while (list->_data[i].slot == ListenerList::kNoSlot)
+      i++;
+
+    list->_dispatchDepth++;
+    bool aborted = false;
+    {
+      CallSite<kArgCount> site(ctx, ctx.propertyAt(functions, list->_data[i].slot), obj);
+      for (; i < count; i++) {
+        ListenerList::Listener& listener = list->_data[i];
+        if (listener.slot == ListenerList::kNoSlot)
+          continue;
+
+        site.setFunction(ctx.propertyAt(functions, listener.slot));
+        if (listener.flags & ListenerList::kFlagOnce)
+          _releaseSlot(ctx, functions, list->_removeAt(i));
+
+        site.call(args...);
+        if (site.aborted()) {
+          aborted = true;
+          break;
+        }
+        site.next();
+      }
+
+      if (--list->_dispatchDepth == 0)
+        _releaseIfEmpty(ctx, event, list);
+
+      if (aborted)
+        return site.rethrow();
+    }
+    return Globals::kResultOk;
+  }
+
+  //! Returns the array of listener functions attached to `obj`, creates it
+  //! the first time.
+  NJS_NOINLINE Value _functionsOf(Context& ctx, const Value& obj) noexcept {
+    if (_functions.isValid())
+      return ctx.makeLocal(_functions);
+
+    if (!obj.isObject())
+      return Value();
+
+    Value description = ctx.newInternalizedString(Latin1Ref("njs.listeners"));
+    if (!description.isValid())
+      return Value();
+
+    Value functions = ctx.newArray();
+    v8::Local<v8::Private> key = v8::Private::ForApi(ctx.v8Isolate(), description.v8HandleAs<v8::String>());
+
+    if (!obj.v8HandleAs<v8::Object>()->SetPrivate(ctx.v8Context(), key, functions.v8Handle()).FromMaybe(false))
+      return Value();
+
+    // Weak without a callback, the array lives as long as the wrapper.
+    ctx.makePersistent(functions, _functions);
+    _functions.v8Handle().SetWeak();
+    return functions;
+  }
+
+  NJS_NOINLINE Result _acquireSlot(Context& ctx, const Value& functions, const Value& function, uint32_t& slot) noexcept {
+    if (_freeSlot != ListenerList::kNoSlot) {
+      int32_t nextFree;
+      NJS_CHECK(ctx.unpack(ctx.propertyAt(functions, _freeSlot), nextFree));
+
+      NJS_CHECK(ctx.setPropertyAt(functions, _freeSlot, function));
+      slot = _freeSlot;
+      _freeSlot = uint32_t(nextFree);
+      return Globals::kResultOk;
+    }
+
+    if (_slotCount == uint32_t(INT32_MAX))
+      return Globals::kResultOutOfMemory;
+
+    NJS_CHECK(ctx.setPropertyAt(functions, _slotCount, function));
+    slot = _slotCount++;
+    return Globals::kResultOk;
+  }
+
+  NJS_INLINE void _releaseSlot(Context& ctx, const Value& functions, uint32_t slot) noexcept {
+    // Links are stored as int32 so `kNoSlot` round-trips as -1.
+    if (ctx.setPropertyAt(functions, slot, ctx.newValue(int32_t(_freeSlot))) == Globals::kResultOk)
+      _freeSlot = slot;
+  }
+
+  NJS_NOINLINE void _releaseIfEmpty(Context& ctx, const Value& event, ListenerList* list) noexcept {
+    if (list->isDispatching())
+      return;
+
+    list->_compact();
+    if (!list->liveCount()) {
+      _events.remove(ctx, event);
+      delete list;
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  StringKeyMap<ListenerList*> _events;
+  //! Weak handle to the array of listener functions attached to the wrapper.
+  Persistent _functions;
+  //! First free slot in `_functions` or `ListenerList::kNoSlot`.
+  uint32_t _freeSlot;
+  //! Number of slots in `_functions`, including free ones.
+  uint32_t _slotCount;
+};
+
+// ============================================================================
+// [NJS_BIND_EVENT_EMITTER]
+// ============================================================================
+
+// Binds `on()`, `once()`, `off()`, and `listenerCount()` methods of a wrapped
+// class that derives from `njs::EventEmitter`. Events are emitted natively by
+// `EventEmitter::emit()`.
+#define NJS_BIND_EVENT_EMITTER()                                              \
+  NJS_BIND_METHOD(on) {                                                       \
+    return EmitterAdd_(ctx, self, 0);                                         \
+  }                                                                           \
+                                                                              \
+  NJS_BIND_METHOD(once) {                                                     \
+    return EmitterAdd_(ctx, self, ::njs::ListenerList::kFlagOnce);            \
+  }                                                                           \
+                                                                              \
+  NJS_BIND_METHOD(off) {                                                      \
+    NJS_CHECK(ctx.verifyArgumentsLength(1, 2));                               \
+                                                                              \
+    ::njs::EventEmitter* emitter = static_cast<::njs::EventEmitter*>(self);   \
+    if (ctx.argumentsLength() == 1)                                           \
+      emitter->removeAllListeners(ctx, ctx.argumentAt(0));                    \
+    else                                                                      \
+      emitter->removeListener(ctx, ctx.argumentAt(0), ctx.argumentAt(1));     \
+    return ctx.returnValue(ctx.This());                                       \
+  }                                                                           \
+                                                                              \
+  NJS_BIND_METHOD(listenerCount, kFlagNoSideEffect) {                         \
+    NJS_CHECK(ctx.verifyArgumentsLength(1));                                  \
+                                                                              \
+    ::njs::EventEmitter* emitter = static_cast<::njs::EventEmitter*>(self);   \
+    return ctx.returnValue(emitter->listenerCount(ctx, ctx.argumentAt(0)));   \
+  }                                                                           \
+                                                                              \
+  static NJS_NOINLINE ::njs::Result EmitterAdd_(                              \
+    ::njs::FunctionCallContext& ctx, Type* self, uint32_t flags) noexcept {   \
+                                                                              \
+    NJS_CHECK(ctx.verifyArgumentsLength(2));                                  \
+    if (!ctx.argumentAt(0).isString())                                        \
+      return ctx.invalidArgumentTypeName(0, "String");                        \
+    if (!ctx.argumentAt(1).isFunction())                                      \
+      return ctx.invalidArgumentTypeName(1, "Function");                      \
+                                                                              \
+    ::njs::EventEmitter* emitter = static_cast<::njs::EventEmitter*>(self);   \
+    NJS_CHECK(emitter->addListener(                                           \
+      ctx, ctx.This(), ctx.argumentAt(0), ctx.argumentAt(1), flags));         \
+    return ctx.returnValue(ctx.This());                                       \
+  }
+
+} // {njs}
+
+#endif // NJS_EXTENSION_EMITTER_H
@@ -0,0 +1,283 @@
+// [NJS-API]
+// Native JavaScript API for Bindings.
+//
+// [License]
+// Public Domain <http://unlicense.org>
+
+// This header implements a string interning extension. `njs::InternCache`
+// maps native strings to internalized JS strings, so getters that return the
+// same native strings over and over don't create a new JS string every time.
+
+#ifndef NJS_EXTENSION_INTERN_H
+#define NJS_EXTENSION_INTERN_H
+
+#include "./njs-api.h"
+
+#include <string.h>
+
+namespace njs {
+
+// ============================================================================
+// [njs::InternStats]
+// ============================================================================
+
+struct InternStats {
+  NJS_INLINE void reset() noexcept {
+    hits = 0;
+    misses = 0;
+    bypassed = 0;
+    evictions = 0;
+  }
+
+  //! Strings served from the cache.
+  uint64_t hits;
+  //! Strings created and stored.
+  uint64_t misses;
+  //! Strings too long to be cached by content.
+  uint64_t bypassed;
+  //! Strings evicted to make room for new ones.
+  uint64_t evictions;
+};
+
+// ============================================================================
+// [njs::InternCache]
+// ============================================================================
+
+//! Bounded LRU cache of internalized JS strings keyed by native strings.
+//!
+//! A string can be looked up either by its address (`getStatic()`), which is
+//! the fastest and suits string literals and names stored in native tables, or
+//! by its content (`get()`), which suits strings built at runtime that have at
+//! most `kMaxContentSize` bytes. The encoding is part of the key, so the same
+//! bytes passed as `Latin1Ref` and `Utf8Ref` are different keys.
+//!
+//! Strings returned for the same key are the same JS string, so JS compares
+//! them by identity. The cache belongs to a single isolate and holds its
+//! strings alive until they are evicted or the cache is cleared.
+class InternCache {
+public:
+  NJS_NONCOPYABLE(InternCache)
+
+  enum : uint32_t {
+    kMaxContentSize = 48
+  };
+
+  enum KeyType : uint8_t {
+    //! Key is the address and size of the string.
+    kKeyAddress = 0,
+    //! Key is the content of the string (copied into the entry).
+    kKeyContent = 1
+  };
+
+  struct Key {
+    uint32_t hash;
+    uint8_t type;
+    uint8_t encoding;
+    //! Size of the string in bytes.
+    uint32_t size;
+    const void* data;
+  };
+
+  struct Entry {
+    Key key;
+    Persistent value;
+    uint8_t content[kMaxContentSize];
+
+    //! Next entry in the same bucket or in the free list.
+    Entry* chainNext;
+    //! LRU list, the most recently used entry is first.
+    Entry* lruPrev;
+    Entry* lruNext;
+  };
+
+  explicit NJS_INLINE InternCache(uint32_t capacity) noexcept
+    : _table(capacity),
+      _runtime() {
+    _stats.reset();
+  }
+
+  NJS_INLINE ~InternCache() noexcept {
+    _reset();
+  }
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  NJS_INLINE uint32_t capacity() const noexcept { return _table.capacity(); }
+  NJS_INLINE const InternStats& stats() const noexcept { return _stats; }
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  //! Returns an internalized string of `str`, which is keyed by its address.
+  //! The characters of `str` must not change nor be freed while it's cached,
+  //! which holds for string literals and static tables.
+  template<typename StrRefT>
+  NJS_INLINE Value getStatic(Context& ctx, const StrRefT& str) noexcept {
+    Key key;
+    key.type = kKeyAddress;
+    key.encoding = _encodingOf(str);
+    key.size = uint32_t(str.size() * sizeof(typename StrRefT::Type));
+    key.data = str.data();
+    key.hash = _hashAddress(key);
+    return _get(ctx, key, str);
+  }
+
+  //! Returns an internalized string of `str`, which is keyed by its content.
+  //! Strings longer than `kMaxContentSize` bytes are not cached and a new JS
+  //! string is returned.
+  template<typename StrRefT>
+  NJS_INLINE Value get(Context& ctx, const StrRefT& str) noexcept {
+    size_t size = str.size() * sizeof(typename StrRefT::Type);
+    if (size > kMaxContentSize) {
+      _stats.bypassed++;
+      return ctx.newString(str);
+    }
+
+    Key key;
+    key.type = kKeyContent;
+    key.encoding = _encodingOf(str);
+    key.size = uint32_t(size);
+    key.data = str.data();
+    key.hash = _hashContent(key);
+    return _get(ctx, key, str);
+  }
+
+  //! Drops all cached strings, must be called on the isolate's thread.
+  NJS_NOINLINE void clear() noexcept {
+    while (Entry* entry = _table.first()) {
+      _release(entry);
+      _table.recycle(entry);
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  static NJS_INLINE uint8_t _encodingOf(const Latin1Ref&) noexcept { return 0; }
+  static NJS_INLINE uint8_t _encodingOf(const Utf8Ref&) noexcept { return 1; }
+  static NJS_INLINE uint8_t _encodingOf(const Utf16Ref&) noexcept { return 2; }
+
+  static NJS_INLINE uint32_t _hashAddress(const Key& key) noexcept {
+    uint64_t bits = uint64_t(uintptr_t(key.data));
+    uint32_t hash = uint32_t(bits ^ (bits >> 32)) ^ (key.size * 31u + key.encoding);
+    return hash * 0x9E3779B1u;
+  }
+
+  // FNV-1a of the content, the size and encoding are mixed in as well.
+  static NJS_INLINE uint32_t _hashContent(const Key& key) noexcept {
+    const uint8_t* p = static_cast<const uint8_t*>(key.data);
+    uint32_t hash = 0x811C9DC5u ^ (key.size * 31u + key.encoding);
+
+    for (uint32_t i = 0; i < key.size; i++)
+      hash = (hash ^ p[i]) * 0x01000193u;
+    return hash;
+  }
+
+  static NJS_INLINE bool _matches(const Entry* entry, const Key& key) noexcept {
+    const Key& other = entry->key;
+    if (other.hash != key.hash || other.type != key.type || other.encoding != key.encoding || other.size != key.size)
+      return false;
+
+    if (key.type == kKeyAddress)
+      return other.data == key.data;
+    else
+      return ::memcmp(entry->content, key.data, key.size) == 0;
+  }
+
+  template<typename StrRefT>
+  NJS_NOINLINE Value _get(Context& ctx, const Key& key, const StrRefT& str) noexcept {
+    if (_table.isInitialized()) {
+      for (Entry* entry = _table.bucket(key.hash); entry; entry = entry->chainNext) {
+        if (_matches(entry, key)) {
+          _table.touch(entry);
+
+          _stats.hits++;
+          return ctx.makeLocal(entry->value);
+        }
+      }
+    }
+
+    Value value = ctx.newInternalizedString(str);
+    if (value.isValid())
+      _store(ctx, key, value);
+    return value;
+  }
+
+  NJS_NOINLINE void _store(Context& ctx, const Key& key, const Value& value) noexcept {
+    if (!_table.isInitialized() && _init(ctx) != Globals::kResultOk)
+      return;
+
+    Entry* entry = _table.acquire();
+    if (!entry) {
+      entry = _table.last();
+      _release(entry);
+      _stats.evictions++;
+    }
+
+    entry->key = key;
+    if (key.type == kKeyContent) {
+      ::memcpy(entry->content, key.data, key.size);
+      entry->key.data = entry->content;
+    }
+    ctx.makePersistent(value, entry->value);
+
+    _table.insert(entry);
+    _stats.misses++;
+  }
+
+  NJS_NOINLINE Result _init(Context& ctx) noexcept {
+    NJS_CHECK(_table.init());
+    _runtime = ctx.runtime();
+
+#if defined(NJS_INTEGRATE_NODE)
+    // Strings must be released before the isolate is disposed.
+    node::AddEnvironmentCleanupHook(_runtime.v8Isolate(), onCleanup, this);
+#endif // NJS_INTEGRATE_NODE
+
+    return Globals::kResultOk;
+  }
+
+  // Releases everything, the cache is initialized again when used next time.
+  NJS_NOINLINE void _reset() noexcept {
+    if (!_table.isInitialized())
+      return;
+
+#if defined(NJS_INTEGRATE_NODE)
+    node::RemoveEnvironmentCleanupHook(_runtime.v8Isolate(), onCleanup, this);
+#endif // NJS_INTEGRATE_NODE
+
+    while (Entry* entry = _table.first())
+      _release(entry);
+    _table.reset();
+  }
+
+  // Unlinks `entry` from its bucket and the LRU list and releases its string.
+  NJS_NOINLINE void _release(Entry* entry) noexcept {
+    _table.remove(entry);
+    entry->value.release();
+  }
+
+#if defined(NJS_INTEGRATE_NODE)
+  static NJS_NOINLINE void onCleanup(void* data) noexcept {
+    static_cast<InternCache*>(data)->_reset();
+  }
+#endif // NJS_INTEGRATE_NODE
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  Internal::LruTable<Entry> _table;
+
+  //! Runtime the cache belongs to (valid while initialized).
+  Runtime _runtime;
+  InternStats _stats;
+};
+
+} // {njs}
+
+#endif // NJS_EXTENSION_INTERN_H
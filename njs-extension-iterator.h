@@ -0,0 +1,770 @@
+// [NJS-API]
+// Native JavaScript API for Bindings.
+//
+// [License]
+// Public Domain <http://unlicense.org>
+
+// This header implements an iterator extension. It makes it possible to expose
+// native producers as JavaScript iterators without writing JS shims.
+
+#ifndef NJS_EXTENSION_ITERATOR_H
+#define NJS_EXTENSION_ITERATOR_H
+
+#include "./njs-api.h"
+
+#if defined(NJS_INTEGRATE_LIBUV)
+# include <atomic>
+#endif // NJS_INTEGRATE_LIBUV
+
+namespace njs {
+
+// ============================================================================
+// [njs::Iterator]
+// ============================================================================
+
+namespace Internal {
+  // JS side of a batched iterator. `fill(batch)` fills `batch` with the next
+  // items and returns their count, or `-(count + 1)` if the producer is done.
+  static const char iteratorShimSource[] =
+    "(function(fill, cancel) {\n"
+    "  var batch = [], index = 0, count = 0, done = false;\n"
+    "  var it = {\n"
+    "    next: function() {\n"
+    "      if (index === count) {\n"
+    "        if (done) return { value: undefined, done: true };\n"
+    "        count = fill(batch);\n"
+    "        index = 0;\n"
+    "        if (count < 0) { done = true; count = -count - 1; }\n"
+    "        if (count === 0) return { value: undefined, done: true };\n"
+    "      }\n"
+    "      return { value: batch[index++], done: false };\n"
+    "    },\n"
+    "    return: function(value) {\n"
+    "      if (!done) { done = true; index = count = 0; cancel(); }\n"
+    "      return { value: value, done: true };\n"
+    "    }\n"
+    "  };\n"
+    "  it[Symbol.iterator] = function() { return this; };\n"
+    "  return it;\n"
+    "})";
+
+  // Returns the factory of batched iterators, compiled once per context (see
+  // `realmCached()`), so iterators use the built-ins of their context.
+  static NJS_NOINLINE Value iteratorShim(Context& ctx) noexcept {
+    static const char kCacheName[] = "njs.iteratorShim";
+
+    Value shim = realmCached(ctx, kCacheName);
+    if (shim.isValid())
+      return shim;
+
+    Value source = ctx.newString(Latin1Ref(iteratorShimSource));
+    shim = source.isValid() ? ctx.runScript(source) : Value();
+
+    if (!shim.isValid() || !shim.isFunction())
+      return Value();
+
+    setRealmCached(ctx, kCacheName, shim);
+    return shim;
+  }
+
+  // Makes `owner` reachable from each of `objects` (the iterator object and
+  // its functions), so the owner lives as long as any of them. Unlike a global
+  // handle this doesn't create a root, so an owner that keeps its iterator is
+  // collected together with it.
+  static NJS_NOINLINE Result attachIteratorOwner(Context& ctx, const Value& owner, const Value* objects, uint32_t count) noexcept {
+    if (!owner.isValid())
+      return Globals::kResultOk;
+
+    Value description = ctx.newInternalizedString(Latin1Ref("njs.iteratorOwner"));
+    NJS_CHECK(description);
+
+    v8::Local<v8::Private> key = v8::Private::ForApi(ctx.v8Isolate(), description.v8HandleAs<v8::String>());
+    for (uint32_t i = 0; i < count; i++) {
+      if (!objects[i].v8HandleAs<v8::Object>()->SetPrivate(ctx.v8Context(), key, owner.v8Handle()).FromMaybe(false))
+        return Globals::kResultBypass;
+    }
+    return Globals::kResultOk;
+  }
+} // {Internal}
+
+//! Native iterator that pulls items from a `Producer` synchronously and makes
+//! them iterable by `for (... of ...)`.
+//!
+//! The `Producer` is the same as the one used by `AsyncIterator`, but both of
+//! its functions are called on the JS thread.
+//!
+//! By default each `next()` call crosses to native code and returns a new
+//! `{ value, done }` record, so records kept by the caller never change. In
+//! batched mode (`batchSize` is non-zero) `next()` is implemented
+//! in JS and native code is only called to fill a batch of `batchSize` items,
+//! which makes the iteration of large collections almost as fast as the one
+//! of arrays, but the producer runs ahead by up to `batchSize` items.
+template<typename Producer>
+class Iterator {
+public:
+  NJS_NONCOPYABLE(Iterator)
+
+  typedef typename Producer::Item Item;
+
+  enum : uint32_t {
+    //! Default batch size of batched iterators.
+    kDefaultBatchSize = 256
+  };
+
+  NJS_INLINE Iterator(Producer* producer, uint32_t batchSize) noexcept
+    : _producer(producer),
+      _batchSize(batchSize),
+      _done(false) {
+    _payload.reset();
+  }
+
+  NJS_INLINE ~Iterator() noexcept {
+    delete _producer;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Create]
+  // --------------------------------------------------------------------------
+
+  //! Creates a new iterator object that takes the ownership of `producer`,
+  //! which is deleted when the iterator is garbage collected.
+  static NJS_NOINLINE Result create(Context& ctx, Value owner, Producer* producer, Value& out, uint32_t batchSize = 0) noexcept {
+    if (!producer)
+      return Globals::kResultOutOfMemory;
+
+    Iterator* self = new (std::nothrow) Iterator(producer, batchSize);
+    if (!self) {
+      delete producer;
+      return Globals::kResultOutOfMemory;
+    }
+
+    // All functions share the same external, which owns the native iterator.
+    Value external = ctx.newExternal(self);
+    if (!external.isValid()) {
+      delete self;
+      return Globals::kResultInvalidHandle;
+    }
+
+    ctx.makePersistent(external, self->_external);
+    ctx.makeWeak(self->_external, self, onCollect);
+
+    if (batchSize) {
+      Value shim = Internal::iteratorShim(ctx);
+      if (!shim.isValid())
+        return Globals::kResultInvalidState;
+
+      Value fillFn = ctx.newFunction(fillEntry, external);
+      Value cancelFn = ctx.newFunction(cancelEntry, external);
+
+      NJS_CHECK(fillFn);
+      NJS_CHECK(cancelFn);
+
+      // The shim keeps both functions, which keep the owner.
+      Value functions[] = { fillFn, cancelFn };
+      NJS_CHECK(Internal::attachIteratorOwner(ctx, owner, functions, 2));
+
+      out = ctx.call(shim, ctx.undefined(), fillFn, cancelFn);
+      return resultOf(out);
+    }
+
+    Value obj = ctx.newObject();
+    NJS_CHECK(obj);
+
+    Value nextFn = ctx.newFunction(nextEntry, external);
+    Value returnFn = ctx.newFunction(returnEntry, external);
+    Value selfFn = ctx.newFunction(selfEntry, external);
+
+    NJS_CHECK(nextFn);
+    NJS_CHECK(returnFn);
+    NJS_CHECK(selfFn);
+
+    NJS_CHECK(ctx.setProperty(obj, Latin1Ref("next"), nextFn));
+    NJS_CHECK(ctx.setProperty(obj, Latin1Ref("return"), returnFn));
+    NJS_CHECK(ctx.setProperty(obj, ctx.iteratorSymbol(), selfFn));
+
+    Value objects[] = { obj, nextFn, returnFn, selfFn };
+    NJS_CHECK(Internal::attachIteratorOwner(ctx, owner, objects, 4));
+
+    out = obj;
+    return Globals::kResultOk;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  // Produces and packs the next item, `value` is not set if the producer is
+  // done. The iterator is done after the first failure.
+  NJS_INLINE Result _next(Context& ctx, Value& value, bool& done) noexcept {
+    Item item;
+
+    _payload.reset();
+    Result result = _producer->produce(item, done, _payload);
+    if (result == Globals::kResultOk && !done)
+      result = _producer->pack(ctx, item, value);
+
+    if (result != Globals::kResultOk || done)
+      _done = true;
+    return result;
+  }
+
+  static NJS_NOINLINE Iterator* _unpackSelf(FunctionCallContext& ctx) noexcept {
+    return static_cast<Iterator*>(ctx.externalData(ctx.data()));
+  }
+
+  static NJS_NOINLINE void nextEntry(const NativeFunctionInfo& info) noexcept {
+    FunctionCallContext ctx(info);
+    Iterator* self = _unpackSelf(ctx);
+
+    Value value = ctx.undefined();
+    bool done = self->_done;
+
+    if (!done) {
+      Result result = self->_next(ctx, value, done);
+      if (result != Globals::kResultOk) {
+        ctx.Throw(ctx.newResultException(result, self->_payload));
+        return;
+      }
+    }
+
+    Value record = ctx.newObject();
+    if (!record.isValid())
+      return;
+
+    ctx.setProperty(record, Latin1Ref("value"), done ? ctx.undefined() : value);
+    ctx.setProperty(record, Latin1Ref("done"), ctx.newBool(done));
+    ctx.returnValue(record);
+  }
+
+  // Fills the batch passed as the first argument (batched mode).
+  static NJS_NOINLINE void fillEntry(const NativeFunctionInfo& info) noexcept {
+    FunctionCallContext ctx(info);
+    Iterator* self = _unpackSelf(ctx);
+
+    Value batch = ctx.argumentAt(0);
+    uint32_t count = 0;
+    bool done = self->_done;
+
+    while (!done && count < self->_batchSize) {
+      Value value;
+      Result result = self->_next(ctx, value, done);
+
+      if (result != Globals::kResultOk) {
+        ctx.Throw(ctx.newResultException(result, self->_payload));
+        return;
+      }
+
+      if (!done)
+        ctx.setPropertyAt(batch, count++, value);
+    }
+
+    ctx.returnValue(done ? -int(count) - 1 : int(count));
+  }
+
+  // Called by `for (... of ...)` on `break`, ends the iteration.
+  static NJS_NOINLINE void returnEntry(const NativeFunctionInfo& info) noexcept {
+    FunctionCallContext ctx(info);
+    Iterator* self = _unpackSelf(ctx);
+
+    self->_done = true;
+
+    Value record = ctx.newObject();
+    if (!record.isValid())
+      return;
+
+    ctx.setProperty(record, Latin1Ref("value"), ctx.argumentsLength() ? ctx.argumentAt(0) : ctx.undefined());
+    ctx.setProperty(record, Latin1Ref("done"), ctx.newBool(true));
+    ctx.returnValue(record);
+  }
+
+  static NJS_NOINLINE void cancelEntry(const NativeFunctionInfo& info) noexcept {
+    FunctionCallContext ctx(info);
+    _unpackSelf(ctx)->_done = true;
+  }
+
+  static NJS_NOINLINE void selfEntry(const NativeFunctionInfo& info) noexcept {
+    info.GetReturnValue().Set(info.This());
+  }
+
+  static NJS_NOINLINE void onCollect(const WeakCallbackInfo& info) noexcept {
+    Iterator* self = static_cast<Iterator*>(info.GetParameter());
+
+    self->_external.release();
+    delete self;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  //! Native producer, owned by the iterator.
+  Producer* _producer;
+  //! Number of items per batch, zero if not batched.
+  uint32_t _batchSize;
+  //! Whether the iteration has finished.
+  bool _done;
+
+  //! External shared by all functions of the iterator (weak). The object that
+  //! created the iterator is kept alive by the iterator's objects, see
+  //! `Internal::attachIteratorOwner()`.
+  Persistent _external;
+  //! Payload of the last failure of the producer.
+  ResultPayloadBase _payload;
+};
+
+// ============================================================================
+// [NJS_BIND_ITERATOR]
+// ============================================================================
+
+// Binds a method that returns an iterator driven by `PRODUCER`. The body has
+// `ctx`, `self`, and `out` (`PRODUCER**`) and should create the producer:
+//
+//   NJS_BIND_ITERATOR(entries, EntryProducer) {
+//     *out = new(std::nothrow) EntryProducer(self->table());
+//     return njs::Globals::kResultOk;
+//   }
+#define NJS_BIND_ITERATOR(NAME, PRODUCER)                                     \
+  NJS_BIND_ITERATOR_IMPL_(NAME, PRODUCER, 0)
+
+// Like `NJS_BIND_ITERATOR`, but the iterator is batched, see `njs::Iterator`.
+#define NJS_BIND_BATCH_ITERATOR(NAME, PRODUCER)                               \
+  NJS_BIND_ITERATOR_IMPL_(NAME, PRODUCER,                                     \
+    ::njs::Iterator<PRODUCER>::kDefaultBatchSize)
+
+#define NJS_BIND_ITERATOR_IMPL_(NAME, PRODUCER, BATCH_SIZE)                   \
+  NJS_BIND_METHOD(NAME) {                                                     \
+    PRODUCER* producer = nullptr;                                             \
+    NJS_CHECK(IteratorImpl_##NAME(ctx, self, &producer));                     \
+                                                                              \
+    ::njs::Value iterator;                                                    \
+    NJS_CHECK(::njs::Iterator<PRODUCER>::create(                              \
+      ctx, ctx.This(), producer, iterator, BATCH_SIZE));                      \
+    return ctx.returnValue(iterator);                                         \
+  }                                                                           \
+                                                                              \
+  static NJS_INLINE ::njs::Result IteratorImpl_##NAME(                        \
+    ::njs::FunctionCallContext& ctx, Type* self, PRODUCER** out) noexcept
+
+// ============================================================================
+// [njs::AsyncIterator]
+// ============================================================================
+
+#if defined(NJS_INTEGRATE_LIBUV)
+//! Native async iterator that pulls items from a `Producer` running on the
+//! thread-pool and returns them to JS through `for await (...)`.
+//!
+//! The `Producer` must provide:
+//!
+//!   - `typedef ... Item` - Default constructible and movable item type.
+//!   - `Result produce(Item& item, bool& done, ResultPayloadBase& payload) noexcept` -
+//!     Called on a worker thread, produces the next item or sets `done` to
+//!     true if there are no more items (`item` is ignored in that case). A
+//!     failure can describe itself by `payload`, messages it points to must
+//!     outlive the iterator.
+//!   - `Result pack(Context& ctx, Item& item, Value& out) noexcept` - Called
+//!     on the loop thread, converts `item` to a JS value. It can be called
+//!     while `produce()` runs, so it must not touch the producer's state.
+//!
+//! Produced items are stored in a bounded queue. The producer stops when the
+//! queue is full and resumes when JS consumes, so the memory used is bounded
+//! regardless of how fast the producer is. The producer also yields as soon
+//! as JS is waiting for an item, all waiting `next()` calls are then settled
+//! together, in a single callback.
+template<typename Producer>
+class AsyncIterator : public Task {
+public:
+  NJS_NONCOPYABLE(AsyncIterator)
+
+  typedef typename Producer::Item Item;
+
+  enum : uint32_t {
+    //! Default capacity of the queue of produced items.
+    kDefaultCapacity = 64
+  };
+
+  NJS_INLINE AsyncIterator(Context& ctx, Producer* producer, Item* items, uint32_t capacity) noexcept
+    : Task(ctx),
+      _producer(producer),
+      _items(items),
+      _capacity(capacity),
+      _head(0),
+      _size(0),
+      _waitingHead(0),
+      _waitingTail(0),
+      _running(false),
+      _done(false),
+      _waiting(false),
+      _cancelled(false),
+      _result(Globals::kResultOk) {
+    uv_mutex_init(&_lock);
+  }
+
+  ~AsyncIterator() noexcept {
+    uv_mutex_destroy(&_lock);
+    delete[] _items;
+    delete _producer;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Create]
+  // --------------------------------------------------------------------------
+
+  //! Creates a new iterator object that takes the ownership of `producer`,
+  //! which is deleted when the iterator is garbage collected.
+  static NJS_NOINLINE Result create(Context& ctx, Value owner, Producer* producer, Value& out, uint32_t capacity = kDefaultCapacity) noexcept {
+    if (!producer)
+      return Globals::kResultOutOfMemory;
+
+    Item* items = new (std::nothrow) Item[capacity ? capacity : 1];
+    AsyncIterator* self = items ? new (std::nothrow) AsyncIterator(ctx, producer, items, capacity ? capacity : 1) : nullptr;
+
+    if (!self) {
+      delete[] items;
+      delete producer;
+      return Globals::kResultOutOfMemory;
+    }
+
+    // All functions share the same external, which owns the native iterator
+    // and is only collected when both the object and its functions are.
+    Value external = ctx.newExternal(self);
+    Value waiting = ctx.newArray();
+    Value obj = ctx.newObject();
+
+    if (!external.isValid() || !waiting.isValid() || !obj.isValid()) {
+      delete self;
+      return Globals::kResultInvalidHandle;
+    }
+
+    ctx.makePersistent(external, self->_external);
+    ctx.makePersistent(waiting, self->_waitingArray);
+    ctx.makeWeak(self->_external, self, onCollect);
+
+    if (owner.isValid()) {
+      ctx.makePersistent(owner, self->_owner);
+      ctx.makeWeak(self->_owner, self, onOwnerCollect);
+    }
+
+    Value nextFn = ctx.newFunction(nextEntry, external);
+    Value returnFn = ctx.newFunction(returnEntry, external);
+    Value selfFn = ctx.newFunction(selfEntry, external);
+
+    NJS_CHECK(nextFn);
+    NJS_CHECK(returnFn);
+    NJS_CHECK(selfFn);
+
+    NJS_CHECK(ctx.setProperty(obj, Latin1Ref("next"), nextFn));
+    NJS_CHECK(ctx.setProperty(obj, Latin1Ref("return"), returnFn));
+    NJS_CHECK(ctx.setProperty(obj, ctx.asyncIteratorSymbol(), selfFn));
+
+    Value objects[] = { obj, nextFn, returnFn, selfFn };
+    NJS_CHECK(Internal::attachIteratorOwner(ctx, owner, objects, 4));
+
+    out = obj;
+    return Globals::kResultOk;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Task Interface]
+  // --------------------------------------------------------------------------
+
+  // Worker thread - fills the queue until it's full, the producer finishes, or
+  // JS is waiting and at least one item is ready to be delivered. A failure of
+  // the producer is not a failure of the task, it's delivered after all items
+  // produced before it.
+  void onWork() noexcept override {
+    Item item;
+    uint32_t produced = 0;
+
+    for (;;) {
+      if (_cancelled.load(std::memory_order_relaxed))
+        break;
+
+      if (produced && _waiting.load(std::memory_order_acquire))
+        break;
+
+      uv_mutex_lock(&_lock);
+      bool full = _size == _capacity;
+      uv_mutex_unlock(&_lock);
+
+      if (full)
+        break;
+
+      bool done = false;
+      _payload.reset();
+      Result result = _producer->produce(item, done, _payload);
+
+      if (result != Globals::kResultOk || done) {
+        uv_mutex_lock(&_lock);
+        _result = result;
+        _done = true;
+        uv_mutex_unlock(&_lock);
+        break;
+      }
+
+      uv_mutex_lock(&_lock);
+      _items[(_head + _size) % _capacity] = std::move(item);
+      _size++;
+      uv_mutex_unlock(&_lock);
+
+      produced++;
+    }
+  }
+
+  // Loop thread.
+  void onDone(Context& ctx, Value data) noexcept override {
+    _running = false;
+    _settleWaiting(ctx);
+    _schedule(ctx);
+  }
+
+  // The iterator is owned by its JS object, not by the executor.
+  void onDestroy(Context& ctx) noexcept override {}
+
+  // Only one producer task is in flight, the array of waiting `next()` calls
+  // lives as long as the iterator.
+  Value asyncResource(Context& ctx) noexcept override {
+    return ctx.makeLocal(_waitingArray);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  NJS_INLINE bool _hasWaiting() const noexcept { return _waitingHead != _waitingTail; }
+
+  // Creates `{ value, done }` record.
+  static NJS_NOINLINE Value _newRecord(Context& ctx, const Value& value, bool done) noexcept {
+    Value record = ctx.newObject();
+    if (record.isValid()) {
+      ctx.setProperty(record, Latin1Ref("value"), value);
+      ctx.setProperty(record, Latin1Ref("done"), ctx.newBool(done));
+    }
+    return record;
+  }
+
+  // Settles the promise of `resolver` by the next item, by the end of the
+  // iteration, or by an error. Returns false if nothing is available yet.
+  NJS_NOINLINE bool _settle(Context& ctx, const Value& resolver) noexcept {
+    Item item;
+    bool hasItem = false;
+
+    uv_mutex_lock(&_lock);
+    bool done = _done;
+    Result result = _result;
+
+    if (_size) {
+      item = std::move(_items[_head]);
+      _head = (_head + 1) % _capacity;
+      _size--;
+      hasItem = true;
+    }
+    uv_mutex_unlock(&_lock);
+
+    if (hasItem) {
+      Value value;
+      Result packResult = _producer->pack(ctx, item, value);
+
+      // `_payload` belongs to `produce()`, which can run concurrently.
+      if (packResult == Globals::kResultOk) {
+        ctx.resolve(resolver, _newRecord(ctx, value, false));
+      }
+      else {
+        ResultPayloadBase payload;
+        payload.reset();
+        ctx.reject(resolver, ctx.newResultException(packResult, payload));
+      }
+      return true;
+    }
+
+    if (!done && !_cancelled.load(std::memory_order_relaxed))
+      return false;
+
+    if (result != Globals::kResultOk) {
+      // Report the failure only once, the iterator is done after that.
+      uv_mutex_lock(&_lock);
+      _result = Globals::kResultOk;
+      uv_mutex_unlock(&_lock);
+
+      ctx.reject(resolver, ctx.newResultException(result, _payload));
+    }
+    else {
+      ctx.resolve(resolver, _newRecord(ctx, ctx.undefined(), true));
+    }
+    return true;
+  }
+
+  // Settles as many waiting `next()` calls as possible.
+  NJS_NOINLINE void _settleWaiting(Context& ctx) noexcept {
+    if (!_hasWaiting())
+      return;
+
+    Value waiting = ctx.makeLocal(_waitingArray);
+    while (_hasWaiting()) {
+      Value resolver = ctx.propertyAt(waiting, _waitingHead);
+      if (!_settle(ctx, resolver))
+        break;
+
+      ctx.setPropertyAt(waiting, _waitingHead, ctx.undefined());
+      _waitingHead++;
+    }
+
+    if (!_hasWaiting()) {
+      _waitingHead = 0;
+      _waitingTail = 0;
+    }
+    _waiting.store(_hasWaiting(), std::memory_order_release);
+  }
+
+  // Posts the producer if there is a room in the queue (loop thread).
+  NJS_NOINLINE void _schedule(Context& ctx) noexcept {
+    if (_running)
+      return;
+
+    uv_mutex_lock(&_lock);
+    bool canProduce = !_done && _size < _capacity && !_cancelled.load(std::memory_order_relaxed);
+    uv_mutex_unlock(&_lock);
+
+    if (!canProduce) {
+      // Nothing to do, let GC collect the iterator if it's not used anymore.
+      ctx.makeWeak(_external, this, onCollect);
+      if (_owner.isValid())
+        ctx.makeWeak(_owner, this, onOwnerCollect);
+      return;
+    }
+
+    // Keep the iterator and its owner alive while the producer is running.
+    ctx.clearWeak(_external);
+    if (_owner.isValid())
+      ctx.clearWeak(_owner);
+    _running = true;
+    PostTask(this);
+  }
+
+  static NJS_NOINLINE AsyncIterator* _unpackSelf(FunctionCallContext& ctx) noexcept {
+    return static_cast<AsyncIterator*>(ctx.externalData(ctx.data()));
+  }
+
+  static NJS_NOINLINE void nextEntry(const NativeFunctionInfo& info) noexcept {
+    FunctionCallContext ctx(info);
+    AsyncIterator* self = _unpackSelf(ctx);
+
+    Value resolver = ctx.newResolver();
+    if (!resolver.isValid())
+      return;
+
+    if (!self->_hasWaiting() && self->_settle(ctx, resolver)) {
+      // Served from the queue, make room for more items.
+      self->_schedule(ctx);
+    }
+    else {
+      Value waiting = ctx.makeLocal(self->_waitingArray);
+      ctx.setPropertyAt(waiting, self->_waitingTail++, resolver);
+      self->_waiting.store(true, std::memory_order_release);
+      self->_schedule(ctx);
+    }
+
+    ctx.returnValue(ctx.promiseOf(resolver));
+  }
+
+  // Called by `for await` on `break` - stops the producer and ends iteration.
+  static NJS_NOINLINE void returnEntry(const NativeFunctionInfo& info) noexcept {
+    FunctionCallContext ctx(info);
+    AsyncIterator* self = _unpackSelf(ctx);
+
+    self->_cancelled.store(true, std::memory_order_relaxed);
+    self->_settleWaiting(ctx);
+
+    Value resolver = ctx.newResolver();
+    if (!resolver.isValid())
+      return;
+
+    ctx.resolve(resolver, _newRecord(ctx, ctx.argumentsLength() ? ctx.argumentAt(0) : ctx.undefined(), true));
+    ctx.returnValue(ctx.promiseOf(resolver));
+  }
+
+  static NJS_NOINLINE void selfEntry(const NativeFunctionInfo& info) noexcept {
+    info.GetReturnValue().Set(info.This());
+  }
+
+  static NJS_NOINLINE void onCollect(const WeakCallbackInfo& info) noexcept {
+    AsyncIterator* self = static_cast<AsyncIterator*>(info.GetParameter());
+
+    self->_external.release();
+    self->_waitingArray.release();
+    self->_owner.release();
+    self->_data.release();
+    delete self;
+  }
+
+  static NJS_NOINLINE void onOwnerCollect(const WeakCallbackInfo& info) noexcept {
+    static_cast<AsyncIterator*>(info.GetParameter())->_owner.release();
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  //! Native producer, owned by the iterator.
+  Producer* _producer;
+
+  //! Queue of produced items (ring buffer), guarded by `_lock`.
+  Item* _items;
+  uint32_t _capacity;
+  uint32_t _head;
+  uint32_t _size;
+  uv_mutex_t _lock;
+
+  //! External shared by all functions of the iterator object (weak if idle).
+  Persistent _external;
+  //! Object that created the iterator. It's kept alive by the iterator's
+  //! objects (see `Internal::attachIteratorOwner()`) and this handle is only
+  //! strong while the producer is running.
+  Persistent _owner;
+  //! Array of resolvers of `next()` calls waiting for an item.
+  Persistent _waitingArray;
+  uint32_t _waitingHead;
+  uint32_t _waitingTail;
+
+  //! Whether the producer is posted (loop thread).
+  bool _running;
+  //! Whether the producer has finished, guarded by `_lock`.
+  bool _done;
+  //! Whether JS is waiting for an item, tells the producer to yield.
+  std::atomic<bool> _waiting;
+  //! Set by `return()`, stops the producer.
+  std::atomic<bool> _cancelled;
+
+  //! Failure reported by the producer, guarded by `_lock`, its payload is
+  //! `_payload`.
+  Result _result;
+};
+
+// ============================================================================
+// [NJS_BIND_ASYNC_ITERATOR]
+// ============================================================================
+
+// Binds a method that returns an async iterator driven by `PRODUCER`. The body
+// has `ctx`, `self`, and `out` (`PRODUCER**`) and should create the producer:
+//
+//   NJS_BIND_ASYNC_ITERATOR(frames, FrameProducer) {
+//     *out = new(std::nothrow) FrameProducer(self->decoder());
+//     return njs::Globals::kResultOk;
+//   }
+#define NJS_BIND_ASYNC_ITERATOR(NAME, PRODUCER)                               \
+  NJS_BIND_METHOD(NAME) {                                                     \
+    PRODUCER* producer = nullptr;                                             \
+    NJS_CHECK(AsyncIteratorImpl_##NAME(ctx, self, &producer));                \
+                                                                              \
+    ::njs::Value iterator;                                                    \
+    NJS_CHECK(::njs::AsyncIterator<PRODUCER>::create(                         \
+      ctx, ctx.This(), producer, iterator));                                  \
+    return ctx.returnValue(iterator);                                         \
+  }                                                                           \
+                                                                              \
+  static NJS_INLINE ::njs::Result AsyncIteratorImpl_##NAME(                   \
+    ::njs::FunctionCallContext& ctx, Type* self, PRODUCER** out) noexcept
+#endif // NJS_INTEGRATE_LIBUV
+
+} // {njs}
+
+#endif // NJS_EXTENSION_ITERATOR_H
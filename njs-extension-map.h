@@ -0,0 +1,235 @@
+// [NJS-API]
+// Native JavaScript API for Bindings.
+//
+// [License]
+// Public Domain <http://unlicense.org>
+
+// This header implements a map extension. `njs::StringKeyMap` maps JS strings
+// to native values without reading the strings into native buffers, which
+// makes it suitable for high-rate lookups of names passed from JS.
+
+#ifndef NJS_EXTENSION_MAP_H
+#define NJS_EXTENSION_MAP_H
+
+#include "./njs-api.h"
+
+namespace njs {
+
+// ============================================================================
+// [njs::StringKeyMap]
+// ============================================================================
+
+//! Hash map keyed by JS strings.
+//!
+//! Lookups never copy the string. The hash is the one the engine computes and
+//! caches in the string itself, and keys are first compared by identity, which
+//! always hits if both the key and the looked up string are internalized (all
+//! string literals and property names are). Other strings are compared by
+//! content. Keys should be created by `Context::newInternalizedString()`.
+//!
+//! The map keeps its keys alive, it must be destroyed or cleared before the
+//! runtime it was used with is disposed.
+template<typename V>
+class StringKeyMap {
+public:
+  NJS_NONCOPYABLE(StringKeyMap)
+
+  struct Node {
+    NJS_INLINE Node(uint32_t hash, const V& value) noexcept
+      : hash(hash),
+        value(value) {}
+
+    uint32_t hash;
+    Persistent key;
+    V value;
+  };
+
+  enum : uint32_t {
+    kInitialCapacity = 16,
+    kNotFound = 0xFFFFFFFFu
+  };
+
+  NJS_INLINE StringKeyMap() noexcept
+    : _table(nullptr),
+      _capacity(0),
+      _size(0) {}
+
+  NJS_INLINE ~StringKeyMap() noexcept {
+    clear();
+    delete[] _table;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  NJS_INLINE bool empty() const noexcept { return _size == 0; }
+  NJS_INLINE uint32_t size() const noexcept { return _size; }
+
+  // --------------------------------------------------------------------------
+  // [Lookup]
+  // --------------------------------------------------------------------------
+
+  //! Returns the value of `key` or null if `key` is not in the map or it's not
+  //! a string.
+  NJS_NOINLINE V* get(Context& ctx, const Value& key) const noexcept {
+    if (!_size || !key.isString())
+      return nullptr;
+
+    uint32_t index = _find(ctx, key, ctx.stringHash(key));
+    return index != kNotFound ? &_table[index]->value : nullptr;
+  }
+
+  NJS_INLINE bool has(Context& ctx, const Value& key) const noexcept {
+    return get(ctx, key) != nullptr;
+  }
+
+  //! Calls `fn(value)` for all values in the map, in no particular order. The
+  //! map must not be modified by `fn`.
+  template<typename Fn>
+  NJS_INLINE void forEach(Fn&& fn) noexcept {
+    for (uint32_t i = 0; i < _capacity; i++)
+      if (_table[i])
+        fn(_table[i]->value);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Modify]
+  // --------------------------------------------------------------------------
+
+  //! Inserts `key` or replaces its value if it's already in the map.
+  NJS_NOINLINE Result insert(Context& ctx, const Value& key, const V& value) noexcept {
+    if (!key.isString())
+      return Globals::kResultInvalidValue;
+
+    uint32_t hash = ctx.stringHash(key);
+    if (_size) {
+      uint32_t index = _find(ctx, key, hash);
+      if (index != kNotFound) {
+        _table[index]->value = value;
+        return Globals::kResultOk;
+      }
+    }
+
+    if ((_size + 1) * 4 > _capacity * 3)
+      NJS_CHECK(_grow());
+
+    Node* node = new (std::nothrow) Node(hash, value);
+    if (!node)
+      return Globals::kResultOutOfMemory;
+
+    ctx.makePersistent(key, node->key);
+    _table[_emptySlot(hash)] = node;
+    _size++;
+    return Globals::kResultOk;
+  }
+
+  //! Removes `key`, returns true if it was in the map.
+  NJS_NOINLINE bool remove(Context& ctx, const Value& key) noexcept {
+    if (!_size || !key.isString())
+      return false;
+
+    uint32_t index = _find(ctx, key, ctx.stringHash(key));
+    if (index == kNotFound)
+      return false;
+
+    _destroyNode(_table[index]);
+    _table[index] = nullptr;
+    _size--;
+
+    // Shift back entries that follow in the same probe sequence, so there are
+    // no holes and lookups can stop at the first empty slot.
+    uint32_t mask = _capacity - 1;
+    uint32_t hole = index;
+
+    for (uint32_t i = (index + 1) & mask; _table[i]; i = (i + 1) & mask) {
+      uint32_t home = _table[i]->hash & mask;
+      if (((i - home) & mask) >= ((i - hole) & mask)) {
+        _table[hole] = _table[i];
+        _table[i] = nullptr;
+        hole = i;
+      }
+    }
+    return true;
+  }
+
+  NJS_NOINLINE void clear() noexcept {
+    for (uint32_t i = 0; i < _capacity; i++) {
+      if (_table[i]) {
+        _destroyNode(_table[i]);
+        _table[i] = nullptr;
+      }
+    }
+    _size = 0;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  NJS_NOINLINE uint32_t _find(Context& ctx, const Value& key, uint32_t hash) const noexcept {
+    uint32_t mask = _capacity - 1;
+
+    for (uint32_t i = hash & mask; _table[i]; i = (i + 1) & mask) {
+      Node* node = _table[i];
+      if (node->hash != hash)
+        continue;
+
+      if (ctx.isSameHandle(node->key, key) || ctx.stringEquals(ctx.makeLocal(node->key), key))
+        return i;
+    }
+
+    return kNotFound;
+  }
+
+  NJS_INLINE uint32_t _emptySlot(uint32_t hash) const noexcept {
+    uint32_t mask = _capacity - 1;
+    uint32_t i = hash & mask;
+
+    while (_table[i])
+      i = (i + 1) & mask;
+    return i;
+  }
+
+  NJS_NOINLINE Result _grow() noexcept {
+    uint32_t oldCapacity = _capacity;
+    uint32_t newCapacity = oldCapacity ? oldCapacity * 2 : uint32_t(kInitialCapacity);
+
+    Node** oldTable = _table;
+    Node** newTable = new (std::nothrow) Node*[newCapacity];
+
+    if (!newTable)
+      return Globals::kResultOutOfMemory;
+
+    for (uint32_t i = 0; i < newCapacity; i++)
+      newTable[i] = nullptr;
+
+    _table = newTable;
+    _capacity = newCapacity;
+
+    for (uint32_t i = 0; i < oldCapacity; i++)
+      if (oldTable[i])
+        _table[_emptySlot(oldTable[i]->hash)] = oldTable[i];
+
+    delete[] oldTable;
+    return Globals::kResultOk;
+  }
+
+  static NJS_INLINE void _destroyNode(Node* node) noexcept {
+    node->key.release();
+    delete node;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  //! Open addressing table (linear probing), its capacity is a power of 2.
+  Node** _table;
+  uint32_t _capacity;
+  uint32_t _size;
+};
+
+} // {njs}
+
+#endif // NJS_EXTENSION_MAP_H
@@ -0,0 +1,488 @@
+// [NJS-API]
+// Native JavaScript API for Bindings.
+//
+// [License]
+// Public Domain <http://unlicense.org>
+
+// This header implements a memoization extension. Pure static functions bound
+// by `NJS_BIND_STATIC_MEMO` remember their results and return them without
+// running the function again when called with the same arguments. Getters
+// bound by `NJS_BIND_CACHED_GET` remember their result per object until the
+// native side invalidates it.
+
+#ifndef NJS_EXTENSION_MEMO_H
+#define NJS_EXTENSION_MEMO_H
+
+#include "./njs-api.h"
+
+#include <string.h>
+
+namespace njs {
+
+// ============================================================================
+// [njs::MemoStats]
+// ============================================================================
+
+struct MemoStats {
+  NJS_INLINE void reset() noexcept {
+    hits = 0;
+    misses = 0;
+    bypassed = 0;
+    evictions = 0;
+    invalidations = 0;
+  }
+
+  //! Calls served from the cache.
+  uint64_t hits;
+  //! Calls that ran the function and stored the result.
+  uint64_t misses;
+  //! Calls with arguments that can't be used as a key.
+  uint64_t bypassed;
+  //! Results evicted to make room for new ones.
+  uint64_t evictions;
+  //! Number of `invalidate()` calls.
+  uint64_t invalidations;
+};
+
+// ============================================================================
+// [njs::MemoCache]
+// ============================================================================
+
+//! Bounded LRU cache of results of a pure function keyed by its arguments.
+//!
+//! Up to `kMaxArgs` arguments are supported, each of them must be a primitive
+//! value, a string that has at most `kMaxStringLength` characters (compared by
+//! content, but never copied), or a wrapped native object (compared by its
+//! identity). Calls with other arguments are not cached. Results are returned
+//! as is, so a result that is an object is shared by all calls that hit it.
+//!
+//! The cache belongs to a single isolate and holds its arguments and results
+//! alive until they are evicted, or the cache is invalidated.
+class MemoCache {
+public:
+  NJS_NONCOPYABLE(MemoCache)
+
+  enum : uint32_t {
+    kMaxArgs = 4,
+    kMaxStringLength = 64
+  };
+
+  enum Kind : uint8_t {
+    kKindNone = 0,
+    kKindUndefined = 1,
+    kKindNull = 2,
+    kKindBool = 3,
+    kKindNumber = 4,
+    kKindString = 5,
+    kKindObject = 6
+  };
+
+  //! Arguments of a call. Strings and objects are compared by using `args`,
+  //! all other kinds are fully described by their bits.
+  struct Key {
+    uint32_t hash;
+    uint32_t argc;
+    uint8_t kinds[kMaxArgs];
+    uint64_t bits[kMaxArgs];
+  };
+
+  struct Entry {
+    Key key;
+    Persistent args[kMaxArgs];
+    Persistent result;
+
+    //! Next entry in the same bucket or in the free list.
+    Entry* chainNext;
+    //! LRU list, the most recently used entry is first.
+    Entry* lruPrev;
+    Entry* lruNext;
+  };
+
+  explicit NJS_INLINE MemoCache(uint32_t capacity) noexcept
+    : _table(capacity),
+      _runtime() {
+    _stats.reset();
+  }
+
+  NJS_INLINE ~MemoCache() noexcept {
+    _reset();
+  }
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  NJS_INLINE uint32_t capacity() const noexcept { return _table.capacity(); }
+  NJS_INLINE const MemoStats& stats() const noexcept { return _stats; }
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  //! Builds the key of the call described by `ctx`. Returns false if any of
+  //! its arguments can't be used as a key.
+  NJS_NOINLINE bool makeKey(FunctionCallContext& ctx, Key& key) noexcept {
+    uint32_t argc = ctx.argumentsLength();
+    if (argc > kMaxArgs) {
+      _stats.bypassed++;
+      return false;
+    }
+
+    uint32_t hash = argc;
+    key.argc = argc;
+
+    for (uint32_t i = 0; i < kMaxArgs; i++) {
+      uint8_t kind = kKindNone;
+      uint64_t bits = 0;
+
+      if (i < argc) {
+        Value arg = ctx.argumentAt(i);
+
+        if (arg.isUndefined()) {
+          kind = kKindUndefined;
+        }
+        else if (arg.isNull()) {
+          kind = kKindNull;
+        }
+        else if (arg.isBool()) {
+          kind = kKindBool;
+          bits = arg.isTrue();
+        }
+        else if (arg.isNumber()) {
+          double d = 0.0;
+          ctx.unpack(arg, d);
+
+          kind = kKindNumber;
+          ::memcpy(&bits, &d, sizeof(d));
+        }
+        else if (arg.isString() && ctx.stringLength(arg) <= kMaxStringLength) {
+          kind = kKindString;
+          bits = ctx.identityHash(arg);
+        }
+        else if (ctx.isWrappedAny(arg)) {
+          kind = kKindObject;
+          bits = ctx.identityHash(arg);
+        }
+        else {
+          _stats.bypassed++;
+          return false;
+        }
+      }
+
+      key.kinds[i] = kind;
+      key.bits[i] = bits;
+      hash = (hash * 31u + kind) ^ uint32_t(bits ^ (bits >> 32));
+      hash *= 0x9E3779B1u;
+    }
+
+    key.hash = hash;
+    return true;
+  }
+
+  //! Returns the cached result of the call described by `key` and `ctx`, or an
+  //! invalid value if it's not cached.
+  NJS_NOINLINE Value lookup(FunctionCallContext& ctx, const Key& key) noexcept {
+    if (_table.isInitialized()) {
+      for (Entry* entry = _table.bucket(key.hash); entry; entry = entry->chainNext) {
+        if (_matches(ctx, entry, key)) {
+          _table.touch(entry);
+
+          _stats.hits++;
+          return ctx.makeLocal(entry->result);
+        }
+      }
+    }
+
+    return Value();
+  }
+
+  //! Stores `result` of the call described by `key` and `ctx`, evicts the least
+  //! recently used result if the cache is full.
+  NJS_NOINLINE Result store(FunctionCallContext& ctx, const Key& key, const Value& result) noexcept {
+    if (!_table.isInitialized())
+      NJS_CHECK(_init(ctx));
+
+    Entry* entry = _table.acquire();
+    if (!entry) {
+      entry = _table.last();
+      _release(entry);
+      _stats.evictions++;
+    }
+
+    entry->key = key;
+    for (uint32_t i = 0; i < key.argc; i++)
+      if (key.kinds[i] == kKindString || key.kinds[i] == kKindObject)
+        ctx.makePersistent(ctx.argumentAt(i), entry->args[i]);
+    ctx.makePersistent(result, entry->result);
+
+    _table.insert(entry);
+    _stats.misses++;
+    return Globals::kResultOk;
+  }
+
+  //! Drops all cached results, must be called on the isolate's thread.
+  NJS_NOINLINE void invalidate() noexcept {
+    while (Entry* entry = _table.first()) {
+      _release(entry);
+      _table.recycle(entry);
+    }
+    _stats.invalidations++;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  NJS_NOINLINE Result _init(Context& ctx) noexcept {
+    NJS_CHECK(_table.init());
+    _runtime = ctx.runtime();
+
+#if defined(NJS_INTEGRATE_NODE)
+    // Results must be released before the isolate is disposed.
+    node::AddEnvironmentCleanupHook(_runtime.v8Isolate(), onCleanup, this);
+#endif // NJS_INTEGRATE_NODE
+
+    return Globals::kResultOk;
+  }
+
+  NJS_NOINLINE bool _matches(FunctionCallContext& ctx, Entry* entry, const Key& key) noexcept {
+    const Key& other = entry->key;
+    if (other.hash != key.hash || other.argc != key.argc)
+      return false;
+
+    for (uint32_t i = 0; i < key.argc; i++) {
+      if (other.kinds[i] != key.kinds[i] || other.bits[i] != key.bits[i])
+        return false;
+
+      if (key.kinds[i] == kKindString || key.kinds[i] == kKindObject) {
+        Value arg = ctx.argumentAt(i);
+
+        if (ctx.isSameHandle(entry->args[i], arg))
+          continue;
+
+        if (key.kinds[i] == kKindObject || !ctx.stringEquals(ctx.makeLocal(entry->args[i]), arg))
+          return false;
+      }
+    }
+
+    return true;
+  }
+
+  // Releases everything, the cache is initialized again when used next time.
+  NJS_NOINLINE void _reset() noexcept {
+    if (!_table.isInitialized())
+      return;
+
+#if defined(NJS_INTEGRATE_NODE)
+    node::RemoveEnvironmentCleanupHook(_runtime.v8Isolate(), onCleanup, this);
+#endif // NJS_INTEGRATE_NODE
+
+    while (Entry* entry = _table.first())
+      _release(entry);
+    _table.reset();
+  }
+
+  // Unlinks `entry` from its bucket and the LRU list and releases its values.
+  NJS_NOINLINE void _release(Entry* entry) noexcept {
+    _table.remove(entry);
+
+    for (uint32_t i = 0; i < kMaxArgs; i++)
+      entry->args[i].release();
+    entry->result.release();
+  }
+
+#if defined(NJS_INTEGRATE_NODE)
+  static NJS_NOINLINE void onCleanup(void* data) noexcept {
+    static_cast<MemoCache*>(data)->_reset();
+  }
+#endif // NJS_INTEGRATE_NODE
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  Internal::LruTable<Entry> _table;
+
+  //! Runtime the cache belongs to (valid while initialized).
+  Runtime _runtime;
+  MemoStats _stats;
+};
+
+// ============================================================================
+// [NJS_BIND_STATIC_MEMO]
+// ============================================================================
+
+// Like `NJS_BIND_STATIC`, but the function must be pure, its results are cached
+// in a `MemoCache` of `CAPACITY` entries. There is one cache per thread, thus
+// per isolate, and it's accessible by `MemoCache_NAME()`.
+#define NJS_BIND_STATIC_MEMO(NAME, CAPACITY, ...)                             \
+  static NJS_NOINLINE ::njs::MemoCache& MemoCache_##NAME() noexcept {         \
+    static thread_local ::njs::MemoCache cache(CAPACITY);                     \
+    return cache;                                                             \
+  }                                                                           \
+                                                                              \
+  static NJS_NOINLINE void StaticFunc_##NAME(                                 \
+      const ::v8::FunctionCallbackInfo< ::v8::Value >& info) noexcept {       \
+                                                                              \
+    ::njs::FunctionCallContext ctx(::njs::Internal::pass(info));              \
+    ::njs::MemoCache& cache = MemoCache_##NAME();                             \
+    ::njs::MemoCache::Key key;                                                \
+                                                                              \
+    if (!cache.makeKey(ctx, key)) {                                           \
+      ctx._handleResult(StaticImpl_##NAME(ctx));                              \
+      return;                                                                 \
+    }                                                                         \
+                                                                              \
+    ::njs::Value cached = cache.lookup(ctx, key);                             \
+    if (cached.isValid()) {                                                   \
+      ctx.returnValue(cached);                                                \
+      return;                                                                 \
+    }                                                                         \
+                                                                              \
+    ::njs::Result result = StaticImpl_##NAME(ctx);                            \
+    if (result == ::njs::Globals::kResultOk)                                  \
+      cache.store(ctx, key, ctx.returnedValue());                             \
+    ctx._handleResult(result);                                                \
+  }                                                                           \
+                                                                              \
+  struct StaticInfo_##NAME : public ::njs::BindingItem {                      \
+    NJS_INLINE StaticInfo_##NAME() noexcept                                   \
+      : BindingItem(kTypeStatic,                                              \
+                    ::njs::Internal::bindingFlags(__VA_ARGS__),               \
+                    #NAME, (const void*)StaticFunc_##NAME) {}                 \
+  } staticinfo_##NAME;                                                        \
+                                                                              \
+  static NJS_INLINE ::njs::Result StaticImpl_##NAME(                          \
+    ::njs::FunctionCallContext& ctx) noexcept
+
+// ============================================================================
+// [njs::GetterCache]
+// ============================================================================
+
+//! Getter cache mixin of wrapped classes, see `NJS_BIND_CACHED_GET`.
+//!
+//! The cached results are stored on the wrapper itself under private symbols,
+//! so they are collected with it. The native object only keeps a bit per slot
+//! that tells whether the stored result is still valid, and has to invalidate
+//! it whenever the state the getter depends on changes.
+class GetterCache {
+public:
+  NJS_NONCOPYABLE(GetterCache)
+
+  enum : uint32_t {
+    kMaxSlots = 32
+  };
+
+  NJS_INLINE GetterCache() noexcept
+    : _validMask(0) {}
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  NJS_INLINE bool isCached(uint32_t slot) const noexcept {
+    NJS_ASSERT(slot < kMaxSlots);
+    return (_validMask & (uint32_t(1) << slot)) != 0;
+  }
+
+  //! Invalidates the result of the getter bound to `slot`.
+  NJS_INLINE void invalidate(uint32_t slot) noexcept {
+    NJS_ASSERT(slot < kMaxSlots);
+    _validMask &= ~(uint32_t(1) << slot);
+  }
+
+  //! Invalidates results of all cached getters.
+  NJS_INLINE void invalidateAll() noexcept { _validMask = 0; }
+
+  NJS_INLINE void _validate(uint32_t slot) noexcept {
+    NJS_ASSERT(slot < kMaxSlots);
+    _validMask |= uint32_t(1) << slot;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  //! Bit per slot, set if the result stored on the wrapper is valid.
+  uint32_t _validMask;
+};
+
+namespace Internal {
+  static NJS_NOINLINE void releaseGetterCacheKey(void* key) noexcept {
+    static_cast<v8::Persistent<v8::Private>*>(key)->Reset();
+  }
+
+  // Returns the private symbol a cached getter stores its result to, created
+  // once per isolate.
+  static NJS_NOINLINE v8::Local<v8::Private> getterCacheKey(Context& ctx, v8::Persistent<v8::Private>& key, const char* name) noexcept {
+    v8::Isolate* isolate = ctx.v8Isolate();
+
+    if (key.IsEmpty()) {
+      Value description = ctx.newString(Latin1Ref(name));
+      key.Reset(isolate, v8::Private::New(isolate, description.v8HandleAs<v8::String>()));
+#if defined(NJS_INTEGRATE_NODE)
+      node::AddEnvironmentCleanupHook(isolate, releaseGetterCacheKey, &key);
+#endif // NJS_INTEGRATE_NODE
+    }
+
+    return v8::Local<v8::Private>::New(isolate, key);
+  }
+
+  // Returns the result of a cached getter, calls `compute` only if the result
+  // stored on the wrapper isn't valid.
+  template<typename Type>
+  static NJS_INLINE Result cachedGet(
+    GetPropertyContext& ctx, Type* self, uint32_t slot,
+    v8::Persistent<v8::Private>& key, const char* name,
+    Result (*compute)(GetPropertyContext& ctx, Type* self)) noexcept {
+
+    GetterCache* cache = self;
+    v8::Local<v8::Object> holder = ctx.v8CallbackInfo().This();
+    v8::Local<v8::Private> privateKey = getterCacheKey(ctx, key, name);
+
+    if (cache->isCached(slot)) {
+      v8::Local<v8::Value> cached;
+      if (holder->GetPrivate(ctx.v8Context(), privateKey).ToLocal(&cached))
+        return ctx.returnValue(Value(cached));
+    }
+
+    NJS_CHECK(compute(ctx, self));
+
+    if (holder->SetPrivate(ctx.v8Context(), privateKey, ctx.returnedValue().v8Handle()).FromMaybe(false))
+      cache->_validate(slot);
+    return Globals::kResultOk;
+  }
+} // {Internal}
+
+// ============================================================================
+// [NJS_BIND_CACHED_GET]
+// ============================================================================
+
+// Like `NJS_BIND_GET`, but the class must derive from `njs::GetterCache` and
+// the result is cached in `SLOT` (0..31, unique per class). The body is only
+// called again after `GetterCache::invalidate(SLOT)` or `invalidateAll()`:
+//
+//   NJS_BIND_CACHED_GET(bounds, 0) {
+//     return ctx.returnValue(self->computeBounds(ctx));
+//   }
+#define NJS_BIND_CACHED_GET(NAME, SLOT, ...)                                  \
+  static_assert(SLOT < ::njs::GetterCache::kMaxSlots,                         \
+                "Cached getter slot out of range");                           \
+                                                                              \
+  static NJS_NOINLINE ::v8::Persistent< ::v8::Private >& CachedKey_##NAME()   \
+      noexcept {                                                              \
+    static thread_local ::v8::Persistent< ::v8::Private > key;                \
+    return key;                                                               \
+  }                                                                           \
+                                                                              \
+  NJS_BIND_GET(NAME, __VA_ARGS__) {                                           \
+    return ::njs::Internal::cachedGet<Type>(                                  \
+      ctx, self, SLOT, CachedKey_##NAME(), #NAME, CachedImpl_##NAME);         \
+  }                                                                           \
+                                                                              \
+  static NJS_INLINE ::njs::Result CachedImpl_##NAME(                          \
+    ::njs::GetPropertyContext& ctx, Type* self) noexcept
+
+} // {njs}
+
+#endif // NJS_EXTENSION_MEMO_H
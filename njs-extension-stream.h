@@ -0,0 +1,1108 @@
+// [NJS-API]
+// Native JavaScript API for Bindings.
+//
+// [License]
+// Public Domain <http://unlicense.org>
+
+// This header implements a stream extension. It exposes native producers and
+// consumers as node.js streams, the native side runs on the thread-pool and
+// exchanges data with JS without copying it.
+
+#ifndef NJS_EXTENSION_STREAM_H
+#define NJS_EXTENSION_STREAM_H
+
+#include "./njs-api.h"
+
+#if !defined(NJS_INTEGRATE_NODE) || !defined(NJS_INTEGRATE_LIBUV)
+# error "[njs] Stream extension requires node.js and libuv integration."
+#endif
+
+#include <atomic>
+
+namespace njs {
+
+// ============================================================================
+// [njs::StreamChunk]
+// ============================================================================
+
+//! A chunk of native memory passed to JS as an external `Buffer`.
+//!
+//! The memory is owned by the chunk until it's handed over to JS, then it's
+//! released by `freeCallback` when the `Buffer` is garbage collected. The
+//! default `freeCallback` releases the memory by `free()`.
+struct StreamChunk {
+  NJS_INLINE StreamChunk() noexcept { reset(); }
+
+  static void NJS_NOINLINE defaultFree(char* data, void* hint) noexcept {
+    ::free(data);
+  }
+
+  NJS_INLINE void reset() noexcept {
+    data = nullptr;
+    size = 0;
+    freeCallback = defaultFree;
+    hint = nullptr;
+  }
+
+  //! Releases the memory (only if it wasn't handed over to JS).
+  NJS_INLINE void release() noexcept {
+    if (data)
+      freeCallback(data, hint);
+    reset();
+  }
+
+  char* data;
+  size_t size;
+  node::Buffer::FreeCallback freeCallback;
+  void* hint;
+};
+
+// ============================================================================
+// [njs::StreamSlice]
+// ============================================================================
+
+//! A chunk of JS memory passed to native code, see `NativeWritable`.
+//!
+//! The memory is owned by a JS `Buffer`, which is kept alive until the native
+//! code has finished with it.
+struct StreamSlice {
+  const char* data;
+  size_t size;
+};
+
+// ============================================================================
+// [njs::StreamWaker]
+// ============================================================================
+
+//! Resumes a `NativeReadable` that is waiting for its producer.
+//!
+//! A producer that has no data yet returns from `pull()` without a chunk, the
+//! stream then stops pulling until the producer calls `wakeUp()`, which can be
+//! done from any thread. The waker lives as long as the stream's producer.
+class StreamWaker {
+public:
+  NJS_NONCOPYABLE(StreamWaker)
+
+  NJS_INLINE StreamWaker() noexcept
+    : _async(nullptr),
+      _isolate(nullptr),
+      _ready(false) {}
+  NJS_INLINE ~StreamWaker() noexcept { _close(); }
+
+  //! Tells the stream that the producer has data or has finished (any thread).
+  NJS_INLINE void wakeUp() noexcept {
+    _ready.store(true, std::memory_order_release);
+    uv_async_send(_async);
+  }
+
+  NJS_NOINLINE Result _open(const Runtime& runtime, uv_async_cb callback, void* data) noexcept {
+    // Allocated separately as it must outlive the waker until it's closed.
+    _async = new (std::nothrow) uv_async_t;
+    if (!_async)
+      return Globals::kResultOutOfMemory;
+
+    uv_async_init(Internal::loopOf(runtime), _async, callback);
+    uv_unref(reinterpret_cast<uv_handle_t*>(_async));
+    _async->data = data;
+
+    // The handle must be closed before the loop is, even if the stream lives.
+    _isolate = runtime.v8Isolate();
+    node::AddEnvironmentCleanupHook(_isolate, onCleanup, this);
+    return Globals::kResultOk;
+  }
+
+  NJS_NOINLINE void _close() noexcept {
+    if (!_async)
+      return;
+
+    node::RemoveEnvironmentCleanupHook(_isolate, onCleanup, this);
+    uv_close(reinterpret_cast<uv_handle_t*>(_async), onClose);
+    _async = nullptr;
+  }
+
+  //! Keeps the loop alive while the stream waits (loop thread).
+  NJS_INLINE void _setWaiting(bool waiting) noexcept {
+    if (!_async)
+      return;
+
+    if (waiting)
+      uv_ref(reinterpret_cast<uv_handle_t*>(_async));
+    else
+      uv_unref(reinterpret_cast<uv_handle_t*>(_async));
+  }
+
+  //! Consumes a pending `wakeUp()`, returns whether there was one.
+  NJS_INLINE bool _consume() noexcept {
+    return _ready.exchange(false, std::memory_order_acquire);
+  }
+
+  static NJS_NOINLINE void onCleanup(void* data) noexcept {
+    static_cast<StreamWaker*>(data)->_close();
+  }
+
+  static NJS_NOINLINE void onClose(uv_handle_t* handle) noexcept {
+    delete reinterpret_cast<uv_async_t*>(handle);
+  }
+
+  uv_async_t* _async;
+  v8::Isolate* _isolate;
+  //! Set by `wakeUp()`, consumed by the stream.
+  std::atomic<bool> _ready;
+};
+
+// ============================================================================
+// [njs::Internal::StreamTask]
+// ============================================================================
+
+namespace Internal {
+  //! Base of native streams. The native part is owned by an external that is
+  //! shared by all functions passed to the JS stream. The external is weak,
+  //! except when a task is in flight, and deletes the native part when it's
+  //! collected, which can only happen after the JS stream was collected.
+  class StreamTask : public Task {
+  public:
+    NJS_NONCOPYABLE(StreamTask)
+
+    NJS_INLINE StreamTask(Context& ctx) noexcept
+      : Task(ctx),
+        _running(false),
+        _destroyed(false) {}
+
+    // The stream is owned by its JS object, not by the executor.
+    void onDestroy(Context& ctx) noexcept override {}
+
+    // Only one task of the stream is in flight, which keeps the stream.
+    Value asyncResource(Context& ctx) noexcept override {
+      return ctx.makeLocal(_stream);
+    }
+
+    NJS_NOINLINE Value _init(Context& ctx) noexcept {
+      Value external = ctx.newExternal(this);
+      if (external.isValid()) {
+        ctx.makePersistent(external, _external);
+        ctx.makeWeak(_external, this, onCollect);
+      }
+      return external;
+    }
+
+    // Posts the task and keeps `stream` alive until it completes.
+    NJS_NOINLINE void _post(Context& ctx, const Value& stream) noexcept {
+      NJS_ASSERT(!_running);
+
+      ctx.makePersistent(stream, _stream);
+      ctx.clearWeak(_external);
+
+      _running = true;
+      PostTask(this);
+    }
+
+    // Must be called first by `onDone()`, returns the stream passed to `_post()`.
+    NJS_NOINLINE Value _complete(Context& ctx) noexcept {
+      Value stream = ctx.makeLocal(_stream);
+
+      _stream.release();
+      _running = false;
+      ctx.makeWeak(_external, this, onCollect);
+
+      return stream;
+    }
+
+    static NJS_NOINLINE StreamTask* _unpackSelf(FunctionCallContext& ctx) noexcept {
+      return static_cast<StreamTask*>(ctx.externalData(ctx.data()));
+    }
+
+    static NJS_NOINLINE void onCollect(const WeakCallbackInfo& info) noexcept {
+      StreamTask* self = static_cast<StreamTask*>(info.GetParameter());
+
+      self->_external.release();
+      self->_data.release();
+      delete self;
+    }
+
+    //! External shared by all functions of the stream (weak if idle).
+    Persistent _external;
+    //! Stream, only valid while a task is in flight (or while a readable
+    //! waits for its producer).
+    Persistent _stream;
+
+    //! Whether the task is posted (loop thread).
+    bool _running;
+    //! Whether the stream was destroyed, the result of the running task is discarded.
+    std::atomic<bool> _destroyed;
+  };
+
+  // Calls `stream.destroy(error)`.
+  static NJS_NOINLINE void destroyStream(Context& ctx, const Value& stream, Result result, const ResultPayloadBase& payload) noexcept {
+    Value destroyFn = ctx.propertyOf(stream, Latin1Ref("destroy"));
+    if (destroyFn.isValid() && destroyFn.isFunction())
+      ctx.call(destroyFn, stream, ctx.newResultException(result, payload));
+  }
+} // {Internal}
+
+// ============================================================================
+// [njs::NativeReadable]
+// ============================================================================
+
+//! Exposes a native `Producer` as node.js `Readable` stream.
+//!
+//! The `Producer` must provide:
+//!
+//!   - `Result pull(size_t size, StreamChunk& chunk, bool& done, StreamWaker& waker, ResultPayloadBase& payload) noexcept` -
+//!     Called on a worker thread, fills `chunk` with the next chunk of data or
+//!     sets `done` to true at the end of the stream. The `size` is a hint that
+//!     comes from `Readable._read(size)`. If no data is available yet, `chunk`
+//!     is left empty and the stream waits until `waker.wakeUp()` is called. A
+//!     failure can describe itself by `payload`, messages it points to must
+//!     outlive the stream.
+//!
+//! Each chunk is pushed to JS as an external `Buffer` that takes the ownership
+//! of its memory, so no copy is made. A new chunk is only pulled when the
+//! stream asks for more data, so the stream's `highWaterMark` is honored.
+template<typename Producer>
+class NativeReadable : public Internal::StreamTask {
+public:
+  NJS_INLINE NativeReadable(Context& ctx, Producer* producer) noexcept
+    : StreamTask(ctx),
+      _producer(producer),
+      _size(0),
+      _done(false),
+      _starved(false),
+      _result(Globals::kResultOk) {}
+
+  ~NativeReadable() noexcept {
+    _chunk.release();
+
+    // The producer may wake the stream up until it's destroyed.
+    delete _producer;
+    _waker._close();
+  }
+
+  // --------------------------------------------------------------------------
+  // [Create]
+  // --------------------------------------------------------------------------
+
+  //! Creates a new `Readable` by using `readableClass`, which should be the
+  //! `Readable` class of node's "stream" module, usually passed from JS. The
+  //! stream takes the ownership of `producer`. Pass zero as `highWaterMark`
+  //! to use the stream's default.
+  static NJS_NOINLINE Result create(Context& ctx, const Value& readableClass, Producer* producer, Value& out, size_t highWaterMark = 0) noexcept {
+    if (!producer)
+      return Globals::kResultOutOfMemory;
+
+    NativeReadable* self = new (std::nothrow) NativeReadable(ctx, producer);
+    if (!self) {
+      delete producer;
+      return Globals::kResultOutOfMemory;
+    }
+
+    Result result = self->_waker._open(ctx.runtime(), onWakeUp, self);
+    if (result != Globals::kResultOk) {
+      delete self;
+      return result;
+    }
+
+    Value external = self->_init(ctx);
+    if (!external.isValid()) {
+      delete self;
+      return Globals::kResultInvalidHandle;
+    }
+
+    Value options = ctx.newObject();
+    NJS_CHECK(options);
+
+    if (highWaterMark)
+      NJS_CHECK(ctx.setProperty(options, Latin1Ref("highWaterMark"), ctx.newValue(highWaterMark)));
+    NJS_CHECK(ctx.setProperty(options, Latin1Ref("read"), ctx.newFunction(readEntry, external)));
+    NJS_CHECK(ctx.setProperty(options, Latin1Ref("destroy"), ctx.newFunction(destroyEntry, external)));
+
+    out = ctx.newInstance(readableClass, options);
+    return resultOf(out);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Task Interface]
+  // --------------------------------------------------------------------------
+
+  // Failures are reported by destroying the stream, not by the task.
+  void onWork() noexcept override {
+    if (_destroyed.load(std::memory_order_relaxed))
+      return;
+
+    bool done = false;
+    _payload.reset();
+    _result = _producer->pull(_size, _chunk, done, _waker, _payload);
+    _done = done;
+  }
+
+  void onDone(Context& ctx, Value data) noexcept override {
+    Value stream = _complete(ctx);
+
+    // Pushing can post the next pull, don't touch the task's state after it.
+    bool done = _done;
+
+    if (_destroyed.load(std::memory_order_relaxed)) {
+      _chunk.release();
+      return;
+    }
+
+    if (_result != Globals::kResultOk) {
+      _chunk.release();
+      Internal::destroyStream(ctx, stream, _result, _payload);
+      return;
+    }
+
+    Value pushFn = ctx.propertyOf(stream, Latin1Ref("push"));
+    if (!pushFn.isValid() || !pushFn.isFunction()) {
+      _chunk.release();
+      return;
+    }
+
+    if (_chunk.data) {
+      Value buffer = Node::newBuffer(ctx, _chunk.data, _chunk.size, _chunk.freeCallback, _chunk.hint);
+      if (!buffer.isValid()) {
+        _chunk.release();
+        return;
+      }
+
+      // The buffer owns the memory now.
+      _chunk.reset();
+
+      // Keep pulling while the stream is below its `highWaterMark`. The push
+      // can call `_read()` synchronously, which would post the task already.
+      Value wantsMore = ctx.call(pushFn, stream, buffer);
+      if (wantsMore.isValid() && wantsMore.isTrue() && !done && !_running)
+        _post(ctx, stream);
+    }
+    else if (!done) {
+      // Nothing was produced. Pull again if the producer has woken the stream
+      // up meanwhile, otherwise wait for it, the stream won't call `_read()`
+      // again until something is pushed.
+      if (_waker._consume())
+        _post(ctx, stream);
+      else
+        _wait(ctx, stream);
+    }
+
+    if (done)
+      ctx.call(pushFn, stream, ctx.null());
+  }
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  // Keeps the stream alive until the producer wakes it up, like a pull in
+  // flight does.
+  NJS_NOINLINE void _wait(Context& ctx, const Value& stream) noexcept {
+    ctx.makePersistent(stream, _stream);
+    ctx.clearWeak(_external);
+
+    _starved = true;
+    _waker._setWaiting(true);
+  }
+
+  // Stops waiting for the producer and returns the stream.
+  NJS_NOINLINE Value _stopWaiting(Context& ctx) noexcept {
+    _starved = false;
+    _waker._setWaiting(false);
+    return _complete(ctx);
+  }
+
+  // `Readable._read(size)`.
+  static NJS_NOINLINE void readEntry(const NativeFunctionInfo& info) noexcept {
+    FunctionCallContext ctx(info);
+    NativeReadable* self = static_cast<NativeReadable*>(_unpackSelf(ctx));
+
+    // The stream calls `_read()` again after `push()`, which is already
+    // handled by `onDone()` when the task is in flight.
+    if (self->_running || self->_done || self->_destroyed.load(std::memory_order_relaxed))
+      return;
+
+    size_t size = 0;
+    if (ctx.argumentsLength() >= 1)
+      ctx.unpackArgument(0, size);
+
+    if (self->_starved)
+      self->_stopWaiting(ctx);
+
+    self->_size = size;
+    self->_post(ctx, ctx.This());
+  }
+
+  // Called on the loop thread after the producer called `wakeUp()`.
+  static NJS_NOINLINE void onWakeUp(uv_async_t* handle) noexcept {
+    NativeReadable* self = static_cast<NativeReadable*>(handle->data);
+
+    // Not waiting, a pull in flight or the next one sees the new data.
+    if (!self->_starved || !self->_waker._consume())
+      return;
+
+    ScopedContext ctx(self->_runtime);
+    self->_post(ctx, self->_stopWaiting(ctx));
+  }
+
+  // `Readable._destroy(error, callback)`.
+  static NJS_NOINLINE void destroyEntry(const NativeFunctionInfo& info) noexcept {
+    FunctionCallContext ctx(info);
+    NativeReadable* self = static_cast<NativeReadable*>(_unpackSelf(ctx));
+
+    self->_destroyed.store(true, std::memory_order_relaxed);
+    if (self->_starved)
+      self->_stopWaiting(ctx);
+
+    Value callback = ctx.argumentAt(1);
+    if (callback.isFunction())
+      ctx.call(callback, ctx.undefined(), ctx.argumentAt(0));
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  //! Native producer, owned by the stream.
+  Producer* _producer;
+  //! Chunk pulled by the last task.
+  StreamChunk _chunk;
+  //! Size requested by `_read()`.
+  size_t _size;
+  //! Whether the producer has finished.
+  bool _done;
+  //! Whether the stream waits for `StreamWaker::wakeUp()`.
+  bool _starved;
+  //! Wakes the stream up when the producer has data again.
+  StreamWaker _waker;
+  //! Failure reported by the producer, its payload is `_payload`.
+  Result _result;
+};
+
+// ============================================================================
+// [njs::NativeWritable]
+// ============================================================================
+
+//! Exposes a native `Consumer` as node.js `Writable` stream.
+//!
+//! The `Consumer` must provide:
+//!
+//!   - `Result consume(const StreamSlice* slices, size_t count, ResultPayloadBase& payload) noexcept` -
+//!     Called on a worker thread with all chunks written since the previous
+//!     call, in order.
+//!   - `Result finish(ResultPayloadBase& payload) noexcept` - Called on a
+//!     worker thread when the stream ends, after all chunks were consumed.
+//!
+//! Failures are passed to the write callback and can be described by
+//! `payload`, messages it points to must outlive the stream.
+//!
+//! Chunks are not copied, their buffers are kept alive until `consume()`
+//! returns. The stream implements `_writev()`, so all chunks buffered while
+//! the consumer was busy or while the stream was corked are passed to the
+//! consumer at once, and their callbacks are completed together.
+template<typename Consumer>
+class NativeWritable : public Internal::StreamTask {
+public:
+  enum Mode : uint32_t {
+    kModeConsume = 0,
+    kModeFinish = 1
+  };
+
+  NJS_INLINE NativeWritable(Context& ctx, Consumer* consumer) noexcept
+    : StreamTask(ctx),
+      _consumer(consumer),
+      _slices(nullptr),
+      _sliceCount(0),
+      _sliceCapacity(0),
+      _mode(kModeConsume),
+      _result(Globals::kResultOk) {}
+
+  ~NativeWritable() noexcept {
+    delete[] _slices;
+    delete _consumer;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Create]
+  // --------------------------------------------------------------------------
+
+  //! Creates a new `Writable` by using `writableClass`, which should be the
+  //! `Writable` class of node's "stream" module, usually passed from JS. The
+  //! stream takes the ownership of `consumer`. Pass zero as `highWaterMark`
+  //! to use the stream's default.
+  static NJS_NOINLINE Result create(Context& ctx, const Value& writableClass, Consumer* consumer, Value& out, size_t highWaterMark = 0) noexcept {
+    if (!consumer)
+      return Globals::kResultOutOfMemory;
+
+    NativeWritable* self = new (std::nothrow) NativeWritable(ctx, consumer);
+    if (!self) {
+      delete consumer;
+      return Globals::kResultOutOfMemory;
+    }
+
+    Value external = self->_init(ctx);
+    if (!external.isValid()) {
+      delete self;
+      return Globals::kResultInvalidHandle;
+    }
+
+    Value options = ctx.newObject();
+    NJS_CHECK(options);
+
+    if (highWaterMark)
+      NJS_CHECK(ctx.setProperty(options, Latin1Ref("highWaterMark"), ctx.newValue(highWaterMark)));
+    NJS_CHECK(ctx.setProperty(options, Latin1Ref("write"), ctx.newFunction(writeEntry, external)));
+    NJS_CHECK(ctx.setProperty(options, Latin1Ref("writev"), ctx.newFunction(writevEntry, external)));
+    NJS_CHECK(ctx.setProperty(options, Latin1Ref("final"), ctx.newFunction(finalEntry, external)));
+    NJS_CHECK(ctx.setProperty(options, Latin1Ref("destroy"), ctx.newFunction(destroyEntry, external)));
+
+    out = ctx.newInstance(writableClass, options);
+    return resultOf(out);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Task Interface]
+  // --------------------------------------------------------------------------
+
+  // Failures are passed to the write callback, not reported by the task.
+  void onWork() noexcept override {
+    if (_destroyed.load(std::memory_order_relaxed))
+      return;
+
+    _payload.reset();
+    if (_mode == kModeConsume)
+      _result = _consumer->consume(_slices, _sliceCount, _payload);
+    else
+      _result = _consumer->finish(_payload);
+  }
+
+  void onDone(Context& ctx, Value data) noexcept override {
+    Value stream = _complete(ctx);
+    Value callback = ctx.makeLocal(_callback);
+
+    // Unpin the chunks and complete all their writes by a single callback.
+    _pinned.release();
+    _callback.release();
+    _sliceCount = 0;
+
+    if (_destroyed.load(std::memory_order_relaxed) || !callback.isFunction())
+      return;
+
+    if (_result != Globals::kResultOk)
+      ctx.call(callback, stream, ctx.newResultException(_result, _payload));
+    else
+      ctx.call(callback, stream);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  NJS_NOINLINE bool _reserveSlices(size_t count) noexcept {
+    if (count <= _sliceCapacity)
+      return true;
+
+    size_t capacity = _sliceCapacity ? _sliceCapacity : 16;
+    while (capacity < count)
+      capacity *= 2;
+
+    StreamSlice* slices = new (std::nothrow) StreamSlice[capacity];
+    if (!slices)
+      return false;
+
+    delete[] _slices;
+    _slices = slices;
+    _sliceCapacity = capacity;
+    return true;
+  }
+
+  NJS_NOINLINE Result _addSlice(const Value& chunk) noexcept {
+    if (!Node::isBuffer(chunk))
+      return Globals::kResultInvalidValue;
+
+    StreamSlice& slice = _slices[_sliceCount++];
+    slice.data = static_cast<const char*>(Node::bufferData(chunk));
+    slice.size = Node::bufferSize(chunk);
+    return Globals::kResultOk;
+  }
+
+  // Posts the task, `pinned` keeps all chunks referenced by `_slices` alive.
+  NJS_NOINLINE void _postWrite(Context& ctx, const Value& stream, const Value& pinned, const Value& callback, Mode mode, Result result) noexcept {
+    if (result != Globals::kResultOk) {
+      _sliceCount = 0;
+      _payload.reset();
+      if (callback.isFunction())
+        ctx.call(callback, stream, ctx.newResultException(result, _payload));
+      return;
+    }
+
+    ctx.makePersistent(pinned, _pinned);
+    ctx.makePersistent(callback, _callback);
+
+    _mode = mode;
+    _post(ctx, stream);
+  }
+
+  // `Writable._write(chunk, encoding, callback)`.
+  static NJS_NOINLINE void writeEntry(const NativeFunctionInfo& info) noexcept {
+    FunctionCallContext ctx(info);
+    NativeWritable* self = static_cast<NativeWritable*>(_unpackSelf(ctx));
+
+    Value chunk = ctx.argumentAt(0);
+    Result result = self->_reserveSlices(1) ? self->_addSlice(chunk) : Result(Globals::kResultOutOfMemory);
+
+    self->_postWrite(ctx, ctx.This(), chunk, ctx.argumentAt(2), kModeConsume, result);
+  }
+
+  // `Writable._writev(chunks, callback)`, where each chunk is `{ chunk, encoding }`.
+  static NJS_NOINLINE void writevEntry(const NativeFunctionInfo& info) noexcept {
+    FunctionCallContext ctx(info);
+    NativeWritable* self = static_cast<NativeWritable*>(_unpackSelf(ctx));
+
+    Value chunks = ctx.argumentAt(0);
+    Result result = Globals::kResultInvalidValue;
+
+    if (chunks.isArray()) {
+      size_t count = ctx.arrayLength(chunks);
+      result = self->_reserveSlices(count) ? Result(Globals::kResultOk) : Result(Globals::kResultOutOfMemory);
+
+      // Slices point to the chunks' memory, no local has to survive the loop.
+      ScopedLoop loop(ctx);
+      for (size_t i = 0; i < count && result == Globals::kResultOk; i++, loop.next()) {
+        Value entry = ctx.propertyAt(chunks, uint32_t(i));
+        result = entry.isValid() ? self->_addSlice(ctx.propertyOf(entry, Latin1Ref("chunk"))) : Result(Globals::kResultInvalidValue);
+      }
+    }
+
+    // Holding the array keeps all its chunks alive.
+    self->_postWrite(ctx, ctx.This(), chunks, ctx.argumentAt(1), kModeConsume, result);
+  }
+
+  // `Writable._final(callback)`.
+  static NJS_NOINLINE void finalEntry(const NativeFunctionInfo& info) noexcept {
+    FunctionCallContext ctx(info);
+    NativeWritable* self = static_cast<NativeWritable*>(_unpackSelf(ctx));
+
+    self->_postWrite(ctx, ctx.This(), ctx.undefined(), ctx.argumentAt(0), kModeFinish, Globals::kResultOk);
+  }
+
+  // `Writable._destroy(error, callback)`.
+  static NJS_NOINLINE void destroyEntry(const NativeFunctionInfo& info) noexcept {
+    FunctionCallContext ctx(info);
+    NativeWritable* self = static_cast<NativeWritable*>(_unpackSelf(ctx));
+
+    self->_destroyed.store(true, std::memory_order_relaxed);
+
+    Value callback = ctx.argumentAt(1);
+    if (callback.isFunction())
+      ctx.call(callback, ctx.undefined(), ctx.argumentAt(0));
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  //! Native consumer, owned by the stream.
+  Consumer* _consumer;
+
+  //! Chunks passed to the consumer (scatter list).
+  StreamSlice* _slices;
+  size_t _sliceCount;
+  size_t _sliceCapacity;
+
+  //! Chunk or array of chunks pinned while the consumer runs.
+  Persistent _pinned;
+  //! Callback of `_write()`, `_writev()`, or `_final()`.
+  Persistent _callback;
+
+  //! What the task does, see `Mode`.
+  Mode _mode;
+  //! Failure reported by the consumer, its payload is `_payload`.
+  Result _result;
+};
+
+// ============================================================================
+// [njs::NativeTransform]
+// ============================================================================
+
+template<typename Transformer>
+class NativeTransform;
+
+namespace Internal {
+  //! A single chunk transformed by `NativeTransform`.
+  template<typename Transformer>
+  class TransformSlot : public Task {
+  public:
+    NJS_NONCOPYABLE(TransformSlot)
+
+    NJS_INLINE TransformSlot(Context& ctx, NativeTransform<Transformer>* owner) noexcept
+      : Task(ctx),
+        _owner(owner),
+        _completed(false),
+        _result(Globals::kResultOk) {
+      _input.data = nullptr;
+      _input.size = 0;
+    }
+
+    ~TransformSlot() noexcept {
+      _output.release();
+    }
+
+    // Failures are reported in order by the transform, not by the slot.
+    void onWork() noexcept override {
+      if (!_owner->_destroyed.load(std::memory_order_relaxed)) {
+        _payload.reset();
+        _result = _owner->_transformer->transform(_input, _output, _payload);
+      }
+    }
+
+    void onDone(Context& ctx, Value data) noexcept override {
+      _completed = true;
+      _owner->_onSlotDone(ctx);
+    }
+
+    // Slots are owned and reused by `NativeTransform`.
+    void onDestroy(Context& ctx) noexcept override {}
+
+    // The input chunk is pinned while the slot is in flight.
+    Value asyncResource(Context& ctx) noexcept override {
+      return ctx.makeLocal(_pinned);
+    }
+
+    //! Transform that owns the slot.
+    NativeTransform<Transformer>* _owner;
+    //! Input chunk, valid while `_pinned` is.
+    StreamSlice _input;
+    //! Output chunk, pushed to JS when all preceding chunks were.
+    StreamChunk _output;
+    //! Input buffer kept alive while the slot is in use.
+    Persistent _pinned;
+    //! Whether the transformer has finished with the chunk.
+    bool _completed;
+    //! Failure reported by the transformer, its payload is `_payload`.
+    Result _result;
+  };
+} // {Internal}
+
+//! Exposes a native `Transformer` as node.js `Transform` stream, which runs
+//! multiple chunks in parallel on the thread-pool.
+//!
+//! The `Transformer` must provide:
+//!
+//!   - `Result transform(const StreamSlice& input, StreamChunk& output, ResultPayloadBase& payload) noexcept` -
+//!     Called on worker threads, transforms `input` and stores the result to
+//!     `output`, which is pushed to JS without copying (see `StreamChunk`).
+//!     It can be called concurrently, so it must not modify shared state. A
+//!     failure destroys the stream and can be described by `payload`.
+//!
+//! Up to `concurrency` chunks are transformed at once and their results are
+//! pushed strictly in the order the chunks were written, chunks that finish
+//! early wait in a reorder buffer. Writes are only acknowledged while there
+//! is a free slot, the input bytes in use don't exceed `maxBytes`, and the
+//! readable side isn't full (the last `push()` returned false and `_read()`
+//! wasn't called since), so the writer is back-pressured when the transform
+//! or the reader can't keep up.
+template<typename Transformer>
+class NativeTransform {
+public:
+  NJS_NONCOPYABLE(NativeTransform)
+
+  typedef Internal::TransformSlot<Transformer> Slot;
+
+  enum : uint32_t {
+    //! Default number of chunks transformed in parallel.
+    kDefaultConcurrency = 4
+  };
+
+  enum : size_t {
+    //! Default limit of input bytes in use.
+    kDefaultMaxBytes = 16 * 1024 * 1024
+  };
+
+  NJS_INLINE NativeTransform(Transformer* transformer, Slot** slots, uint32_t concurrency, size_t maxBytes) noexcept
+    : _transformer(transformer),
+      _slots(slots),
+      _concurrency(concurrency),
+      _maxBytes(maxBytes),
+      _writeSeq(0),
+      _emitSeq(0),
+      _bytesInUse(0),
+      _readBlocked(false),
+      _destroyed(false) {}
+
+  ~NativeTransform() noexcept {
+    _baseRead.release();
+
+    for (uint32_t i = 0; i < _concurrency; i++) {
+      if (_slots[i]) {
+        _slots[i]->_data.release();
+        delete _slots[i];
+      }
+    }
+
+    delete[] _slots;
+    delete _transformer;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Create]
+  // --------------------------------------------------------------------------
+
+  //! Creates a new `Transform` by using `transformClass`, which should be the
+  //! `Transform` class of node's "stream" module, usually passed from JS. The
+  //! stream takes the ownership of `transformer`.
+  static NJS_NOINLINE Result create(Context& ctx, const Value& transformClass, Transformer* transformer, Value& out, uint32_t concurrency = kDefaultConcurrency, size_t maxBytes = kDefaultMaxBytes) noexcept {
+    if (!transformer)
+      return Globals::kResultOutOfMemory;
+
+    if (!concurrency)
+      concurrency = 1;
+
+    Slot** slots = new (std::nothrow) Slot*[concurrency];
+    NativeTransform* self = slots ? new (std::nothrow) NativeTransform(transformer, slots, concurrency, maxBytes) : nullptr;
+
+    if (!self) {
+      delete[] slots;
+      delete transformer;
+      return Globals::kResultOutOfMemory;
+    }
+
+    Result result = Globals::kResultOk;
+    for (uint32_t i = 0; i < concurrency; i++) {
+      slots[i] = new (std::nothrow) Slot(ctx, self);
+      if (!slots[i])
+        result = Globals::kResultOutOfMemory;
+    }
+
+    Value external = ctx.newExternal(self);
+    if (result != Globals::kResultOk || !external.isValid()) {
+      delete self;
+      return result != Globals::kResultOk ? result : Result(Globals::kResultInvalidHandle);
+    }
+
+    ctx.makePersistent(external, self->_external);
+    ctx.makeWeak(self->_external, self, onCollect);
+
+    Value options = ctx.newObject();
+    NJS_CHECK(options);
+
+    NJS_CHECK(ctx.setProperty(options, Latin1Ref("transform"), ctx.newFunction(transformEntry, external)));
+    NJS_CHECK(ctx.setProperty(options, Latin1Ref("flush"), ctx.newFunction(flushEntry, external)));
+    NJS_CHECK(ctx.setProperty(options, Latin1Ref("destroy"), ctx.newFunction(destroyEntry, external)));
+
+    out = ctx.newInstance(transformClass, options);
+    NJS_CHECK(out);
+
+    // Wrap `_read()` to know when the reader wants more data.
+    Value baseRead = ctx.propertyOf(out, Latin1Ref("_read"));
+    if (baseRead.isValid() && baseRead.isFunction()) {
+      ctx.makePersistent(baseRead, self->_baseRead);
+      NJS_CHECK(ctx.setProperty(out, Latin1Ref("_read"), ctx.newFunction(readEntry, external)));
+    }
+
+    return Globals::kResultOk;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  NJS_INLINE uint32_t _slotsInUse() const noexcept { return uint32_t(_writeSeq - _emitSeq); }
+  NJS_INLINE Slot* _slotOf(uint64_t seq) const noexcept { return _slots[seq % _concurrency]; }
+
+  NJS_INLINE bool _canAccept() const noexcept {
+    return _slotsInUse() < _concurrency && _bytesInUse < _maxBytes && !_readBlocked;
+  }
+
+  // Calls the callback deferred by `_transform()` or `_flush()` once possible.
+  NJS_NOINLINE void _resume(Context& ctx, const Value& stream) noexcept {
+    if (_writeCallback.isValid() && _canAccept()) {
+      Value callback = ctx.makeLocal(_writeCallback);
+      _writeCallback.release();
+      ctx.call(callback, stream);
+    }
+
+    if (_flushCallback.isValid() && !_slotsInUse()) {
+      Value callback = ctx.makeLocal(_flushCallback);
+      _flushCallback.release();
+      ctx.call(callback, stream);
+    }
+  }
+
+  // Pushes all completed chunks that are next in order.
+  NJS_NOINLINE void _onSlotDone(Context& ctx) noexcept {
+    Value stream = ctx.makeLocal(_stream);
+    Value pushFn = ctx.propertyOf(stream, Latin1Ref("push"));
+
+    while (_slotsInUse() && _slotOf(_emitSeq)->_completed) {
+      Slot* slot = _slotOf(_emitSeq);
+      Result result = slot->_result;
+
+      slot->_pinned.release();
+      slot->_completed = false;
+      _bytesInUse -= slot->_input.size;
+      _emitSeq++;
+
+      if (_destroyed.load(std::memory_order_relaxed)) {
+        slot->_output.release();
+        continue;
+      }
+
+      if (result != Globals::kResultOk) {
+        slot->_output.release();
+        _destroyed.store(true, std::memory_order_relaxed);
+        Internal::destroyStream(ctx, stream, result, slot->_payload);
+        continue;
+      }
+
+      if (slot->_output.data && pushFn.isFunction()) {
+        StreamChunk& output = slot->_output;
+        Value buffer = Node::newBuffer(ctx, output.data, output.size, output.freeCallback, output.hint);
+
+        if (buffer.isValid()) {
+          output.reset();
+          Value pushed = ctx.call(pushFn, stream, buffer);
+          if (pushed.isValid() && pushed.isFalse())
+            _readBlocked = true;
+        }
+      }
+      slot->_output.release();
+    }
+
+    if (!_slotsInUse()) {
+      // Idle, let GC collect the stream if it's not used anymore.
+      _stream.release();
+      ctx.makeWeak(_external, this, onCollect);
+    }
+
+    if (!_destroyed.load(std::memory_order_relaxed))
+      _resume(ctx, stream);
+  }
+
+  static NJS_NOINLINE NativeTransform* _unpackSelf(FunctionCallContext& ctx) noexcept {
+    return static_cast<NativeTransform*>(ctx.externalData(ctx.data()));
+  }
+
+  // `Transform._transform(chunk, encoding, callback)`.
+  static NJS_NOINLINE void transformEntry(const NativeFunctionInfo& info) noexcept {
+    FunctionCallContext ctx(info);
+    NativeTransform* self = _unpackSelf(ctx);
+
+    Value stream = ctx.This();
+    Value chunk = ctx.argumentAt(0);
+    Value callback = ctx.argumentAt(2);
+
+    if (!Node::isBuffer(chunk)) {
+      ctx.call(callback, stream, ctx.newResultException(ctx.invalidValue(), ctx._payload));
+      return;
+    }
+
+    // The stream never calls `_transform()` before the previous callback was
+    // called, so there is always a free slot here.
+    NJS_ASSERT(self->_slotsInUse() < self->_concurrency);
+
+    if (!self->_slotsInUse()) {
+      // Keep the stream alive while chunks are transformed.
+      ctx.makePersistent(stream, self->_stream);
+      ctx.clearWeak(self->_external);
+    }
+
+    Slot* slot = self->_slotOf(self->_writeSeq++);
+    slot->_input.data = static_cast<const char*>(Node::bufferData(chunk));
+    slot->_input.size = Node::bufferSize(chunk);
+    ctx.makePersistent(chunk, slot->_pinned);
+
+    self->_bytesInUse += slot->_input.size;
+    PostTask(slot);
+
+    // Acknowledge the write now if another chunk can be accepted, otherwise
+    // when a slot is released.
+    if (self->_canAccept())
+      ctx.call(callback, stream);
+    else
+      ctx.makePersistent(callback, self->_writeCallback);
+  }
+
+  // `Readable._read(size)`, the reader wants more data, so a write deferred by
+  // a full readable side can be acknowledged.
+  static NJS_NOINLINE void readEntry(const NativeFunctionInfo& info) noexcept {
+    FunctionCallContext ctx(info);
+    NativeTransform* self = _unpackSelf(ctx);
+    Value stream = ctx.This();
+
+    if (self->_readBlocked) {
+      self->_readBlocked = false;
+      if (!self->_destroyed.load(std::memory_order_relaxed))
+        self->_resume(ctx, stream);
+    }
+
+    if (self->_baseRead.isValid())
+      ctx.call(ctx.makeLocal(self->_baseRead), stream, ctx.argumentAt(0));
+  }
+
+  // `Transform._flush(callback)`, waits for all chunks in flight.
+  static NJS_NOINLINE void flushEntry(const NativeFunctionInfo& info) noexcept {
+    FunctionCallContext ctx(info);
+    NativeTransform* self = _unpackSelf(ctx);
+
+    ctx.makePersistent(ctx.argumentAt(0), self->_flushCallback);
+    self->_resume(ctx, ctx.This());
+  }
+
+  // `Transform._destroy(error, callback)`.
+  static NJS_NOINLINE void destroyEntry(const NativeFunctionInfo& info) noexcept {
+    FunctionCallContext ctx(info);
+    NativeTransform* self = _unpackSelf(ctx);
+
+    self->_destroyed.store(true, std::memory_order_relaxed);
+    self->_writeCallback.release();
+    self->_flushCallback.release();
+
+    Value callback = ctx.argumentAt(1);
+    if (callback.isFunction())
+      ctx.call(callback, ctx.undefined(), ctx.argumentAt(0));
+  }
+
+  static NJS_NOINLINE void onCollect(const WeakCallbackInfo& info) noexcept {
+    NativeTransform* self = static_cast<NativeTransform*>(info.GetParameter());
+
+    self->_external.release();
+    delete self;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  //! Native transformer, owned by the stream.
+  Transformer* _transformer;
+
+  //! Slots of chunks in flight (reorder buffer), indexed by sequence number.
+  Slot** _slots;
+  uint32_t _concurrency;
+  size_t _maxBytes;
+
+  //! Sequence number of the next chunk written.
+  uint64_t _writeSeq;
+  //! Sequence number of the next chunk pushed.
+  uint64_t _emitSeq;
+  //! Input bytes of chunks in flight.
+  size_t _bytesInUse;
+  //! Whether `push()` returned false, writes are not acknowledged until the
+  //! reader calls `_read()`.
+  bool _readBlocked;
+
+  //! External shared by all functions of the stream (weak if idle).
+  Persistent _external;
+  //! Stream, only valid while chunks are in flight.
+  Persistent _stream;
+  //! Callback of `_transform()` deferred until a slot is released.
+  Persistent _writeCallback;
+  //! Callback of `_flush()` deferred until all chunks are pushed.
+  Persistent _flushCallback;
+  //! `_read()` of `Transform`, called by the wrapper installed by `create()`.
+  Persistent _baseRead;
+
+  //! Whether the stream was destroyed, results of chunks in flight are discarded.
+  std::atomic<bool> _destroyed;
+};
+
+} // {njs}
+
+#endif // NJS_EXTENSION_STREAM_H
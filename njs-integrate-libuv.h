@@ -10,22 +10,155 @@
 #include "./njs-api.h"
 #include <uv.h>
 
+#if defined(_MSC_VER)
+# include <intrin.h>
+#endif
+
+// io_uring is only used on Linux and only through raw syscalls, so there is no
+// dependency on liburing. Define `NJS_NO_IO_URING` to disable it completely.
+#if defined(__linux__) && !defined(NJS_NO_IO_URING)
+# if defined(__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#   define NJS_IO_URING
+#  endif
+# endif
+#endif // __linux__ && !NJS_NO_IO_URING
+
+#if !defined(_WIN32)
+# include <errno.h>
+# include <sys/uio.h>
+# include <unistd.h>
+#endif // !_WIN32
+
+#if defined(__linux__)
+# include <sched.h>
+# include <sys/syscall.h>
+#endif // __linux__
+
+#if defined(NJS_IO_URING)
+# include <sys/mman.h>
+# include <linux/io_uring.h>
+#endif // NJS_IO_URING
+
+#include <atomic>
+
 namespace njs {
 
 // ============================================================================
 // [njs::Internal]
 // ============================================================================
 
+class Task;
+
+// ============================================================================
+// [njs::TaskProfile]
+// ============================================================================
+
+//! Statistics of a class of tasks that drive adaptive inline execution.
+//!
+//! Tasks that use a profile (see `Task::setProfile()`) report how long their
+//! `onWork()` took relative to their cost and how long the round trip through
+//! the executor took on top of it. Once the profile has enough samples, tasks
+//! whose predicted work time is below the round trip overhead run `onWork()`
+//! synchronously when posted and their `onDone()` is called from a microtask,
+//! so the completion is still asynchronous. Every `kProbeInterval`-th task
+//! that could run inline is posted to the executor anyway, so the overhead is
+//! still sampled and tasks stop running inline once it drops.
+//!
+//! A profile is typically a static member of the task class. It's updated on
+//! loop threads only, but multiple loops (worker threads) can share it, so the
+//! statistics are atomic and updates can be lost, which is fine for EWMA.
+struct TaskProfile {
+  enum : uint32_t {
+    //! Number of samples required before any task is inlined.
+    kMinSamples = 8,
+    //! EWMA weight of a new sample is `1 / 2^kEwmaShift`.
+    kEwmaShift = 3,
+    //! Fractional bits of the work time per cost unit.
+    kWorkShift = 8,
+    //! One of this many tasks that could run inline is posted instead.
+    kProbeInterval = 16
+  };
+
+  NJS_INLINE TaskProfile() noexcept
+    : workPerUnit(0),
+      overhead(0),
+      samples(0),
+      inlineCount(0),
+      probeCount(0) {}
+
+  //! Returns whether a task of the given `cost` should run inline.
+  NJS_INLINE bool shouldInline(uint64_t cost) const noexcept {
+    if (samples.load(std::memory_order_relaxed) < kMinSamples)
+      return false;
+
+    uint64_t perUnit = workPerUnit.load(std::memory_order_relaxed);
+    uint64_t limit = overhead.load(std::memory_order_relaxed);
+
+    if (perUnit && cost > (std::numeric_limits<uint64_t>::max() >> 1) / perUnit)
+      return false;
+    return ((perUnit * cost) >> kWorkShift) < limit;
+  }
+
+  //! Called for tasks that should run inline, returns true if the task has to
+  //! be posted to the executor to sample the overhead.
+  NJS_INLINE bool shouldProbe() noexcept {
+    uint64_t n = inlineCount.load(std::memory_order_relaxed) + probeCount.load(std::memory_order_relaxed);
+    if ((n + 1) % kProbeInterval != 0)
+      return false;
+
+    probeCount.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  NJS_INLINE void addWork(uint64_t cost, uint64_t ns) noexcept {
+    uint64_t perUnit = (ns << kWorkShift) / (cost ? cost : 1);
+    _update(workPerUnit, perUnit);
+  }
+
+  NJS_INLINE void addOverhead(uint64_t ns) noexcept {
+    _update(overhead, ns);
+    samples.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  static NJS_INLINE void _update(std::atomic<uint64_t>& ewma, uint64_t sample) noexcept {
+    uint64_t prev = ewma.load(std::memory_order_relaxed);
+    uint64_t next = prev ? prev - (prev >> kEwmaShift) + (sample >> kEwmaShift) : sample;
+    ewma.store(next, std::memory_order_relaxed);
+  }
+
+  //! Work time per cost unit (EWMA, nanoseconds scaled by `2^kWorkShift`).
+  std::atomic<uint64_t> workPerUnit;
+  //! Time spent in the executor on top of the work (EWMA, nanoseconds).
+  std::atomic<uint64_t> overhead;
+  //! Number of overhead samples.
+  std::atomic<uint32_t> samples;
+  //! Number of tasks that ran inline.
+  std::atomic<uint64_t> inlineCount;
+  //! Number of tasks that could run inline, but were posted to sample the
+  //! overhead.
+  std::atomic<uint64_t> probeCount;
+};
+
 namespace Internal {
   static NJS_NOINLINE void uvWorkCallback(uv_work_t* uvWork) noexcept;
   static NJS_NOINLINE void uvAfterWorkCallback(uv_work_t* uvWork, int status) noexcept;
+  static NJS_NOINLINE void completeTask(Task* task) noexcept;
 } // {Internal}
 
 // ============================================================================
 // [NJS_ASYNC]
 // ============================================================================
 
-class Task {
+//! Asynchronous task.
+//!
+//! `onWork()` runs on a worker thread. Tasks that can fail override
+//! `onWorkResult()` instead and return a `Result`, the `ResultMixin` methods
+//! (like `invalidArgumentCustom()`) and `fail()` can be used to add a payload
+//! to it. No JS value is allocated on the worker, the payload is turned into
+//! an exception on the loop thread and passed to `onError()` instead of
+//! calling `onDone()`.
+class Task : public ResultMixinT<ResultPayloadBase> {
 public:
   enum {
     kIndexCallback = 0,
@@ -34,26 +167,181 @@ public:
     kIndexCustom   = 3
   };
 
+  enum : uint32_t {
+    //! No locality hint, the task can run anywhere.
+    kLocalityAny = 0xFFFFFFFFu
+  };
+
   NJS_NOINLINE Task(Context& ctx, Value data) noexcept
-    : _runtime(ctx._runtime) {
+    : Task(ctx) {
 
     // Initialize the storage.
     ctx.makePersistent(data, _data);
+  }
+
+  //! Creates a task without the `_data` object, used by `SlotTask`.
+  NJS_NOINLINE explicit Task(Context& ctx) noexcept
+    : _runtime(ctx._runtime),
+      _slots(nullptr),
+      _slotCount(0),
+      _next(nullptr),
+      _locality(kLocalityAny),
+      _profile(nullptr),
+      _cost(0),
+      _postTime(0),
+      _workTime(0),
+      _workResult(Globals::kResultOk),
+      _message(nullptr) {
 
     // Initialize UV data.
     _uvWork.data = this;
     _uvStatus = 0;
+
+#if defined(NJS_INTEGRATE_NODE)
+    _asyncContext.async_id = 0;
+    _asyncContext.trigger_async_id = 0;
+#endif // NJS_INTEGRATE_NODE
+  }
+  virtual ~Task() noexcept {
+    _data.release();
+    delete[] _message;
   }
-  virtual ~Task() noexcept {}
 
   // --------------------------------------------------------------------------
   // [Interface]
   // --------------------------------------------------------------------------
 
-  virtual void onWork() noexcept = 0;
+  virtual void onWork() noexcept {}
+
+  //! Called on a worker thread, the default implementation calls `onWork()`
+  //! and succeeds. Tasks that can fail override this instead of `onWork()`.
+  virtual Result onWorkResult() noexcept {
+    onWork();
+    return Globals::kResultOk;
+  }
+
   virtual void onDone(Context& ctx, Value data) noexcept = 0;
   virtual void onDestroy(Context& ctx) noexcept { delete this; }
 
+  //! Returns an object the task already holds to be used as its async resource
+  //! while it's posted, see `Internal::initAsyncContext()`. The object must be
+  //! unique to the posted task and valid until it completes. The default uses
+  //! the `_data` object or the slot at `kIndexCallback`, unless it's a function,
+  //! which can be shared by more tasks. If an invalid value is returned a new
+  //! object is created for the task.
+  virtual Value asyncResource(Context& ctx) noexcept {
+    Value data = _dataOf(ctx);
+    return data.isObject() && !data.isFunction() ? data : Value();
+  }
+
+  //! Called instead of `onDone()` if `onWork()` failed. The default handler
+  //! rejects `data` if it's a promise resolver, otherwise it calls `data` (or
+  //! the function stored at `kIndexCallback` if `data` is an object) with the
+  //! error as its first argument.
+  virtual void onError(Context& ctx, Value data, Value error) noexcept {
+    if (data.isPromise()) {
+      ctx.reject(data, error);
+      return;
+    }
+
+    Value callback = data;
+    if (!callback.isFunction() && callback.isObject())
+      callback = ctx.propertyAt(data, kIndexCallback);
+
+    if (callback.isValid() && callback.isFunction())
+      ctx.call(callback, ctx.undefined(), error);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Failure]
+  // --------------------------------------------------------------------------
+
+  //! Formats a message and returns it, can be used as a message of
+  //! `invalidValueCustom()` and similar. The buffer is allocated by the first
+  //! failure, so tasks that never fail don't pay for it. Returns `fmt` as is
+  //! if the allocation fails.
+  NJS_NOINLINE const char* formatMessage(const char* fmt, ...) noexcept {
+    if (!_message && !(_message = new(std::nothrow) char[Globals::kMaxBufferSize]))
+      return fmt;
+
+    va_list ap;
+    va_start(ap, fmt);
+    StrUtils::vsformat(_message, Globals::kMaxBufferSize, fmt, ap);
+    va_end(ap);
+    return _message;
+  }
+
+  //! Fails with an exception of the given `type` (`Globals::kExceptionError`
+  //! or any other exception type) and a formatted message, to be returned by
+  //! `onWorkResult()`.
+  NJS_NOINLINE Result fail(uint32_t type, const char* fmt, ...) noexcept {
+    NJS_ASSERT(type >= Globals::_kResultThrowFirst && type <= Globals::_kResultThrowLast);
+
+    if (!_message && !(_message = new(std::nothrow) char[Globals::kMaxBufferSize]))
+      return Globals::kResultOutOfMemory;
+
+    va_list ap;
+    va_start(ap, fmt);
+    StrUtils::vsformat(_message, Globals::kMaxBufferSize, fmt, ap);
+    va_end(ap);
+
+    _payload.error.message = _message;
+    return type;
+  }
+
+  NJS_INLINE Result workResult() const noexcept { return _workResult; }
+
+  // --------------------------------------------------------------------------
+  // [Slots]
+  // --------------------------------------------------------------------------
+
+  NJS_INLINE uint32_t slotCount() const noexcept { return _slotCount; }
+
+  //! Stores `value` to the slot at `index`, see `SlotTask`.
+  NJS_INLINE void setSlot(Context& ctx, uint32_t index, const Value& value) noexcept {
+    NJS_ASSERT(index < _slotCount);
+    ctx.makePersistent(value, _slots[index]);
+  }
+
+  //! Returns the value of the slot at `index` (loop thread only).
+  NJS_INLINE Value slot(Context& ctx, uint32_t index) noexcept {
+    NJS_ASSERT(index < _slotCount);
+    return _slots[index].isValid() ? ctx.makeLocal(_slots[index]) : ctx.undefined();
+  }
+
+  //! Returns the value passed to `onDone()` and `onError()`, which is either
+  //! the `_data` object or the slot at `kIndexCallback`.
+  NJS_INLINE Value _dataOf(Context& ctx) noexcept {
+    if (_slotCount)
+      return slot(ctx, kIndexCallback);
+    return _data.isValid() ? ctx.makeLocal(_data) : ctx.undefined();
+  }
+
+  // --------------------------------------------------------------------------
+  // [Locality]
+  // --------------------------------------------------------------------------
+
+  //! Sets the NUMA node the task should run on, typically the node of its
+  //! input (see `ThreadPool::nodeOf()`). It's only a hint, which is ignored by
+  //! the libuv thread-pool.
+  NJS_INLINE void setLocality(uint32_t node) noexcept { _locality = node; }
+  NJS_INLINE uint32_t locality() const noexcept { return _locality; }
+
+  // --------------------------------------------------------------------------
+  // [Profile]
+  // --------------------------------------------------------------------------
+
+  //! Enables adaptive inline execution of the task, see `TaskProfile`. The
+  //! `cost` is any measure the work time is proportional to, like the size of
+  //! the input in bytes, and must be set before the task is posted.
+  NJS_INLINE void setProfile(TaskProfile* profile, uint64_t cost) noexcept {
+    _profile = profile;
+    _cost = cost;
+  }
+
+  NJS_INLINE TaskProfile* profile() const noexcept { return _profile; }
+  NJS_INLINE uint64_t cost() const noexcept { return _cost; }
+
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
@@ -65,16 +353,512 @@ public:
   //! is created and/or completed, it's not possible to access it inside `onWork`
   //! from a different thread.
   Persistent _data;
+  //! Slots of `SlotTask` or null.
+  Persistent* _slots;
+  //! Number of slots.
+  uint32_t _slotCount;
+
+  //! Link used by executors that queue completed tasks (not used by libuv).
+  Task* _next;
+  //! NUMA node hint, see `setLocality()`.
+  uint32_t _locality;
+
+  //! Profile of the task or null, see `setProfile()`.
+  TaskProfile* _profile;
+  //! Cost of the task, see `setProfile()`.
+  uint64_t _cost;
+  //! Time the task was posted or zero if it ran inline (only used by profiles).
+  uint64_t _postTime;
+  //! Time spent in `onWork()` (only used by profiles).
+  uint64_t _workTime;
+  //! Result returned by `onWorkResult()`, its payload is `_payload`.
+  Result _workResult;
+  //! Message formatted by `formatMessage()` or `fail()`, allocated on demand.
+  char* _message;
 
   //! UV work data.
   uv_work_t _uvWork;
   //! UV status - initially zero, changed by `uvAfterWorkCallback`.
   int _uvStatus;
+
+#if defined(NJS_INTEGRATE_NODE)
+  //! Async resource created for the task if `asyncResource()` has none, it's
+  //! released when the task is completed, see `Internal::initAsyncContext()`.
+  Persistent _asyncResource;
+  //! Async context of `_asyncResource`.
+  node::async_context _asyncContext;
+#endif // NJS_INTEGRATE_NODE
+};
+
+// ============================================================================
+// [njs::SlotTask]
+// ============================================================================
+
+//! Task that keeps its values in `N` slots instead of the `_data` object.
+//!
+//! Each slot is a single global handle and no JS object is created per task,
+//! which makes it a better fit for tasks posted at a high rate that only keep
+//! a callback and a few arguments alive. The slot at `kIndexCallback` is the
+//! `data` passed to `onDone()` and `onError()`, so it should be the callback
+//! or the promise resolver.
+template<uint32_t N>
+class SlotTask : public Task {
+public:
+  static_assert(N > 0, "SlotTask requires at least one slot");
+
+  NJS_INLINE explicit SlotTask(Context& ctx) noexcept
+    : Task(ctx) {
+    _slots = _storage;
+    _slotCount = N;
+  }
+
+  ~SlotTask() noexcept {
+    for (uint32_t i = 0; i < N; i++)
+      _storage[i].release();
+  }
+
+  Persistent _storage[N];
+};
+
+// ============================================================================
+// [njs::TaskSnapshot]
+// ============================================================================
+
+//! Describes a value captured by `TaskSnapshot`.
+struct SnapshotField {
+  enum Type : uint32_t {
+    kTypeBool = 0,
+    kTypeNumber = 1,
+    //! String, converted to UTF-8.
+    kTypeString = 2,
+    //! Array of numbers, converted to doubles.
+    kTypeNumbers = 3,
+    //! Buffer or typed array, its data is pinned, not copied (node only).
+    kTypeBytes = 4
+  };
+
+  enum Flags : uint32_t {
+    //! The value can be `undefined`, see `TaskSnapshot::has()`.
+    kFlagOptional = 0x1u
+  };
+
+  static NJS_INLINE SnapshotField argument(uint32_t argIndex, uint32_t type, uint32_t flags = 0) noexcept {
+    return SnapshotField { argIndex, nullptr, type, flags };
+  }
+
+  static NJS_INLINE SnapshotField property(uint32_t argIndex, const char* name, uint32_t type, uint32_t flags = 0) noexcept {
+    return SnapshotField { argIndex, name, type, flags };
+  }
+
+  //! Index of the argument.
+  uint32_t argIndex;
+  //! Property of the argument (LATIN-1) or null to use the argument itself.
+  const char* name;
+  uint32_t type;
+  uint32_t flags;
+};
+
+//! Native copy of the arguments of a task, taken on the JS thread so that
+//! `onWork()` can read them on any thread.
+//!
+//! The values are described by a list of `SnapshotField`s and captured by a
+//! single `capture()` call, which validates them, measures them, and copies
+//! strings and arrays into a single arena (an inline buffer if they fit).
+//! Buffers and typed arrays, and external strings that are ASCII, are not
+//! copied - they are pinned by global handles until the snapshot is destroyed,
+//! which happens on the JS thread together with its task.
+class TaskSnapshot {
+public:
+  NJS_NONCOPYABLE(TaskSnapshot)
+
+  enum : uint32_t {
+    kMaxFields = 16,
+    kInlineSize = 256
+  };
+
+  struct Item {
+    //! Type of the item, see `SnapshotField::Type`.
+    uint32_t type;
+    //! False if the value was optional and undefined.
+    bool present;
+    //! Size in bytes (strings and bytes) or count (numbers).
+    size_t size;
+
+    union {
+      bool b;
+      double d;
+      const char* data;
+      const double* numbers;
+    };
+  };
+
+  NJS_INLINE TaskSnapshot() noexcept
+    : _count(0),
+      _arena(_inline) {}
+
+  NJS_INLINE ~TaskSnapshot() noexcept {
+    for (uint32_t i = 0; i < _count; i++)
+      _pins[i].release();
+
+    if (_arena != _inline)
+      delete[] _arena;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Capture]
+  // --------------------------------------------------------------------------
+
+  //! Captures values described by `fields`, the items of the snapshot have the
+  //! same indexes as `fields`. More than `kMaxFields` fields is an invalid state.
+  template<typename ContextT>
+  NJS_NOINLINE Result capture(ContextT& ctx, const SnapshotField* fields, uint32_t count) noexcept {
+    NJS_ASSERT(_count == 0);
+
+    if (count > kMaxFields)
+      return Globals::kResultInvalidState;
+
+    Value values[kMaxFields];
+    size_t lengths[kMaxFields];
+    size_t arenaSize = 0;
+
+    // Validate and measure everything first, so the arena is allocated once.
+    for (uint32_t i = 0; i < count; i++) {
+      const SnapshotField& field = fields[i];
+      Value value = ctx.argumentAt(field.argIndex);
+
+      if (field.name) {
+        if (!value.isObject())
+          return ctx.invalidArgument(field.argIndex);
+
+        value = ctx.propertyOf(value, Latin1Ref(field.name));
+        if (!value.isValid())
+          return Globals::kResultBypass;
+      }
+
+      values[i] = value;
+      lengths[i] = 0;
+
+      if (value.isUndefined() && (field.flags & SnapshotField::kFlagOptional))
+        continue;
+
+      bool valid = false;
+      switch (field.type) {
+        case SnapshotField::kTypeBool:
+          valid = value.isBool();
+          break;
+
+        case SnapshotField::kTypeNumber:
+          valid = value.isNumber();
+          break;
+
+        case SnapshotField::kTypeString:
+          valid = value.isString();
+          if (valid && !_pinnableString(value))
+            arenaSize += ctx.utf8Length(value) + 1;
+          break;
+
+        case SnapshotField::kTypeNumbers:
+          valid = value.isArray();
+          if (valid) {
+            lengths[i] = ctx.arrayLength(value);
+            arenaSize += lengths[i] * sizeof(double);
+          }
+          break;
+
+#if defined(NJS_INTEGRATE_NODE)
+        case SnapshotField::kTypeBytes:
+          valid = Node::isBuffer(value);
+          break;
+#endif // NJS_INTEGRATE_NODE
+      }
+
+      if (!valid)
+        return _invalidField(ctx, field);
+
+      // Keep the arena aligned for doubles.
+      arenaSize = (arenaSize + 7) & ~size_t(7);
+    }
+
+    if (arenaSize > kInlineSize) {
+      _arena = new (std::nothrow) char[arenaSize];
+      if (!_arena) {
+        _arena = _inline;
+        return Globals::kResultOutOfMemory;
+      }
+    }
+
+    char* p = _arena;
+    for (uint32_t i = 0; i < count; i++) {
+      const SnapshotField& field = fields[i];
+      const Value& value = values[i];
+      Item& item = _items[i];
+
+      item.type = field.type;
+      item.present = !value.isUndefined() || !(field.flags & SnapshotField::kFlagOptional);
+      item.size = 0;
+      item.data = nullptr;
+      _count = i + 1;
+
+      if (!item.present)
+        continue;
+
+      switch (field.type) {
+        case SnapshotField::kTypeBool:
+          item.b = value.isTrue();
+          break;
+
+        case SnapshotField::kTypeNumber:
+          ctx.unpack(value, item.d);
+          break;
+
+        case SnapshotField::kTypeString:
+          if (_pinnableString(value)) {
+            const v8::String::ExternalOneByteStringResource* resource =
+              value.v8Value<v8::String>()->GetExternalOneByteStringResource();
+            item.data = resource->data();
+            item.size = resource->length();
+            ctx.makePersistent(value, _pins[i]);
+          }
+          else {
+            item.size = size_t(ctx.readUtf8(value, p));
+            p[item.size] = '\0';
+            item.data = p;
+            p += item.size + 1;
+          }
+          break;
+
+        case SnapshotField::kTypeNumbers: {
+          // The length measured before, getters of elements could change it.
+          double* numbers = reinterpret_cast<double*>(p);
+          size_t n = lengths[i];
+
+          ScopedLoop loop(ctx);
+          for (size_t j = 0; j < n; j++, loop.next()) {
+            Value element = ctx.propertyAt(value, uint32_t(j));
+            if (!element.isValid())
+              return Globals::kResultBypass;
+
+            if (ctx.unpack(element, numbers[j]) != Globals::kResultOk)
+              return _invalidField(ctx, field);
+          }
+
+          item.numbers = numbers;
+          item.size = n;
+          p += n * sizeof(double);
+          break;
+        }
+
+#if defined(NJS_INTEGRATE_NODE)
+        case SnapshotField::kTypeBytes:
+          item.data = static_cast<const char*>(Node::bufferData(value));
+          item.size = Node::bufferSize(value);
+          ctx.makePersistent(value, _pins[i]);
+          break;
+#endif // NJS_INTEGRATE_NODE
+      }
+
+      p = _arena + ((size_t(p - _arena) + 7) & ~size_t(7));
+    }
+
+    return Globals::kResultOk;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  //! Returns the number of captured items.
+  NJS_INLINE uint32_t count() const noexcept { return _count; }
+
+  //! Returns false if the item at `index` is optional and was undefined.
+  NJS_INLINE bool has(uint32_t index) const noexcept {
+    NJS_ASSERT(index < _count);
+    return _items[index].present;
+  }
+
+  NJS_INLINE bool boolAt(uint32_t index) const noexcept {
+    NJS_ASSERT(index < _count && _items[index].type == SnapshotField::kTypeBool);
+    return _items[index].present && _items[index].b;
+  }
+
+  NJS_INLINE double numberAt(uint32_t index) const noexcept {
+    NJS_ASSERT(index < _count && _items[index].type == SnapshotField::kTypeNumber);
+    return _items[index].present ? _items[index].d : 0.0;
+  }
+
+  //! Returns a UTF-8 string, which is also null terminated unless pinned.
+  NJS_INLINE Utf8Ref stringAt(uint32_t index) const noexcept {
+    NJS_ASSERT(index < _count && _items[index].type == SnapshotField::kTypeString);
+    return Utf8Ref(_items[index].data ? _items[index].data : "", _items[index].size);
+  }
+
+  NJS_INLINE const double* numbersAt(uint32_t index, size_t& count) const noexcept {
+    NJS_ASSERT(index < _count && _items[index].type == SnapshotField::kTypeNumbers);
+    count = _items[index].size;
+    return _items[index].numbers;
+  }
+
+  NJS_INLINE const char* bytesAt(uint32_t index, size_t& size) const noexcept {
+    NJS_ASSERT(index < _count && _items[index].type == SnapshotField::kTypeBytes);
+    size = _items[index].size;
+    return _items[index].data;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  // External one-byte strings don't move, they can be used in place if they
+  // are ASCII (thus UTF-8 as well).
+  static NJS_NOINLINE bool _pinnableString(const Value& value) noexcept {
+    v8::Local<v8::String> str = value.v8HandleAs<v8::String>();
+    if (!str->IsExternalOneByte())
+      return false;
+
+    const v8::String::ExternalOneByteStringResource* resource = str->GetExternalOneByteStringResource();
+    const char* data = resource->data();
+    size_t size = resource->length();
+
+    for (size_t i = 0; i < size; i++)
+      if (static_cast<unsigned char>(data[i]) >= 0x80)
+        return false;
+    return true;
+  }
+
+  template<typename ContextT>
+  static NJS_NOINLINE Result _invalidField(ContextT& ctx, const SnapshotField& field) noexcept {
+    if (!field.name)
+      return ctx.invalidArgument(field.argIndex);
+
+    StrUtils::sformat(ctx._payload.staticBuffer, Globals::kMaxBufferSize, "Invalid property '%s'", field.name);
+    return ctx.invalidArgumentCustom(field.argIndex, ctx._payload.staticBuffer);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  uint32_t _count;
+  Item _items[kMaxFields];
+  //! Pinned values (strings and bytes used in place).
+  Persistent _pins[kMaxFields];
+  //! Strings and arrays, either `_inline` or allocated.
+  char* _arena;
+  alignas(double) char _inline[kInlineSize];
 };
 
+namespace Internal {
+  // Returns the event loop of the environment `runtime` belongs to, which is
+  // not the default loop in worker threads.
+  static NJS_INLINE uv_loop_t* loopOf(const Runtime& runtime) noexcept {
+#if defined(NJS_INTEGRATE_NODE)
+    uv_loop_t* loop = ::node::GetCurrentEventLoop(runtime.v8Isolate());
+    if (loop)
+      return loop;
+#endif // NJS_INTEGRATE_NODE
+
+    return uv_default_loop();
+  }
+
+  // Initializes the async context of `task` in the current async context, so
+  // its completion runs in the context the task was posted from, which is what
+  // async_hooks and `AsyncLocalStorage` expect (loop thread). The resource is
+  // an object the task already holds, a new one is only created if it has none.
+  static NJS_NOINLINE void initAsyncContext(Task* task) noexcept {
+#if defined(NJS_INTEGRATE_NODE)
+    ScopedContext ctx(task->_runtime);
+    Value resource = task->asyncResource(ctx);
+
+    if (!resource.isValid()) {
+      resource = ctx.newObject();
+      ctx.makePersistent(resource, task->_asyncResource);
+    }
+
+    task->_asyncContext = node::EmitAsyncInit(ctx.v8Isolate(), resource.v8HandleAs<v8::Object>(), "NJS_TASK");
+#else
+    (void)task;
+#endif // NJS_INTEGRATE_NODE
+  }
+} // {Internal}
+
+namespace Internal {
+  // Calls `onWorkResult()` and measures it if the task has a profile (any thread).
+  static NJS_INLINE void runWork(Task* task) noexcept {
+    if (!task->_profile) {
+      task->_workResult = task->onWorkResult();
+      return;
+    }
+
+    uint64_t start = uv_hrtime();
+    task->_workResult = task->onWorkResult();
+    task->_workTime = uv_hrtime() - start;
+  }
+
+  // Calls `onDone()` or `onError()` and destroys the task, updates its profile.
+  static NJS_NOINLINE void finishTask(Context& ctx, Task* task) noexcept {
+    TaskProfile* profile = task->_profile;
+    if (profile) {
+      profile->addWork(task->_cost, task->_workTime);
+      if (task->_postTime) {
+        uint64_t total = uv_hrtime() - task->_postTime;
+        profile->addOverhead(total > task->_workTime ? total - task->_workTime : 0);
+      }
+    }
+
+#if defined(NJS_INTEGRATE_NODE)
+    // `onDone()` can post the task again, which gives it a new async context.
+    node::async_context asyncContext = task->_asyncContext;
+    task->_asyncContext.async_id = 0;
+    task->_asyncContext.trigger_async_id = 0;
+    task->_asyncResource.release();
+#endif // NJS_INTEGRATE_NODE
+
+    Value data = task->_dataOf(ctx);
+    if (task->_workResult == Globals::kResultOk)
+      task->onDone(ctx, data);
+    else
+      task->onError(ctx, data, ctx.newResultException(task->_workResult, task->_payload));
+
+#if defined(NJS_INTEGRATE_NODE)
+    if (asyncContext.async_id != 0)
+      node::EmitAsyncDestroy(ctx.v8Isolate(), asyncContext);
+#endif // NJS_INTEGRATE_NODE
+
+    task->onDestroy(ctx);
+  }
+
+  static NJS_NOINLINE void completeInlineTask(void* data) noexcept {
+    completeTask(static_cast<Task*>(data));
+  }
+
+  // Runs `task` inline if its profile predicts the work is cheaper than the
+  // round trip through the executor, otherwise just records the post time.
+  static NJS_NOINLINE bool tryRunInline(Task* task) noexcept {
+    TaskProfile* profile = task->_profile;
+    if (!profile)
+      return false;
+
+    if (!profile->shouldInline(task->_cost) || profile->shouldProbe()) {
+      task->_postTime = uv_hrtime();
+      return false;
+    }
+
+    task->_postTime = 0;
+    profile->inlineCount.fetch_add(1, std::memory_order_relaxed);
+
+    runWork(task);
+    task->_runtime.v8Isolate()->EnqueueMicrotask(completeInlineTask, task);
+    return true;
+  }
+} // {Internal}
+
 static NJS_NOINLINE void PostTask(Task* task) {
+  Internal::initAsyncContext(task);
+  if (Internal::tryRunInline(task))
+    return;
+
   uv_queue_work(
-    uv_default_loop(),
+    Internal::loopOf(task->_runtime),
     &task->_uvWork,
     Internal::uvWorkCallback,
     Internal::uvAfterWorkCallback);
@@ -83,19 +867,2062 @@ static NJS_NOINLINE void PostTask(Task* task) {
 namespace Internal {
   static NJS_NOINLINE void uvWorkCallback(uv_work_t* uvWork) noexcept {
     Task* task = static_cast<Task*>(uvWork->data);
-    task->onWork();
+    runWork(task);
   }
 
   static NJS_NOINLINE void uvAfterWorkCallback(uv_work_t* uvWork, int status) noexcept {
     Task* task = static_cast<Task*>(uvWork->data);
+    task->_uvStatus = status;
+    completeTask(task);
+  }
 
-    njs::ScopedContext ctx(task->_runtime);
-    njs::Value data = ctx.makeLocal(task->_data);
+  // Called on the loop thread by all executors once the work is done.
+  static NJS_NOINLINE void completeTask(Task* task) noexcept {
+    ScopedContext ctx(task->_runtime);
 
-    task->onDone(ctx, data);
-    task->onDestroy(ctx);
+#if defined(NJS_INTEGRATE_NODE)
+    // Enter the async context of the task and process `nextTick()` queue and
+    // microtasks once the task is done, like after any other callback called
+    // by node, streams and promises rely on it.
+    Value resource = task->_asyncResource.isValid() ? ctx.makeLocal(task->_asyncResource) : task->asyncResource(ctx);
+    if (!resource.isValid())
+      resource = ctx.newObject();
+    node::CallbackScope callbackScope(ctx.v8Isolate(), resource.v8HandleAs<v8::Object>(), task->_asyncContext);
+#endif // NJS_INTEGRATE_NODE
+
+    finishTask(ctx, task);
   }
 } // {Internal}
+
+// ============================================================================
+// [njs::Executor]
+// ============================================================================
+
+//! Executor that runs tasks instead of the libuv thread-pool.
+//!
+//! Like with the libuv thread-pool `onWork()` is called on any thread and
+//! `onDone()` is called on the loop thread the task was posted from.
+class Executor {
+public:
+  NJS_NONCOPYABLE(Executor)
+
+  NJS_INLINE Executor() noexcept {}
+  virtual ~Executor() noexcept {}
+
+  //! Posts `task`, must be called on the loop thread.
+  virtual void post(Task* task) noexcept = 0;
+};
+
+//! Posts `task` to `executor`.
+static NJS_INLINE void PostTask(Task* task, Executor* executor) {
+  Internal::initAsyncContext(task);
+  if (!Internal::tryRunInline(task))
+    executor->post(task);
+}
+
+namespace Internal {
+  //! Hands tasks finished on any thread back to the loop thread, which then
+  //! completes them. Used by executors, it keeps the loop alive only while
+  //! tasks are in flight.
+  class CompletionQueue {
+  public:
+    NJS_NONCOPYABLE(CompletionQueue)
+
+    //! Called on the loop thread before finished tasks are completed.
+    typedef void (*DrainHandler)(void* data);
+
+    NJS_INLINE CompletionQueue() noexcept
+      : _first(nullptr),
+        _last(nullptr),
+        _async(nullptr),
+        _activeTasks(0),
+        _drainHandler(nullptr),
+        _drainData(nullptr) {}
+    NJS_INLINE ~CompletionQueue() noexcept { close(); }
+
+    NJS_INLINE bool isOpen() const noexcept { return _async != nullptr; }
+
+    NJS_NOINLINE Result open(uv_loop_t* loop) noexcept {
+      NJS_ASSERT(_async == nullptr);
+
+      // Allocated separately as it must outlive the queue until it's closed.
+      _async = new (std::nothrow) uv_async_t;
+      if (!_async)
+        return Globals::kResultOutOfMemory;
+
+      uv_mutex_init(&_lock);
+      uv_async_init(loop, _async, onAsync);
+      uv_unref(reinterpret_cast<uv_handle_t*>(_async));
+      _async->data = this;
+      return Globals::kResultOk;
+    }
+
+    //! Closes the queue, tasks must not be in flight.
+    NJS_NOINLINE void close() noexcept {
+      if (!_async)
+        return;
+
+      NJS_ASSERT(_activeTasks == 0);
+      uv_mutex_destroy(&_lock);
+      uv_close(reinterpret_cast<uv_handle_t*>(_async), onClose);
+      _async = nullptr;
+    }
+
+    NJS_INLINE void setDrainHandler(DrainHandler handler, void* data) noexcept {
+      _drainHandler = handler;
+      _drainData = data;
+    }
+
+    //! Wakes up the loop to call the drain handler (any thread).
+    NJS_INLINE void wakeUp() noexcept { uv_async_send(_async); }
+
+    //! Must be called on the loop thread for each posted task.
+    NJS_INLINE void addActive() noexcept {
+      if (++_activeTasks == 1)
+        uv_ref(reinterpret_cast<uv_handle_t*>(_async));
+    }
+
+    //! Queues a finished task and wakes up the loop (any thread).
+    NJS_NOINLINE void push(Task* task) noexcept {
+      task->_next = nullptr;
+
+      uv_mutex_lock(&_lock);
+      if (_last)
+        _last->_next = task;
+      else
+        _first = task;
+      _last = task;
+      uv_mutex_unlock(&_lock);
+
+      uv_async_send(_async);
+    }
+
+    static NJS_NOINLINE void onAsync(uv_async_t* handle) noexcept {
+      CompletionQueue* self = static_cast<CompletionQueue*>(handle->data);
+
+      uv_mutex_lock(&self->_lock);
+      Task* task = self->_first;
+      self->_first = nullptr;
+      self->_last = nullptr;
+      uv_mutex_unlock(&self->_lock);
+
+      if (self->_drainHandler)
+        self->_drainHandler(self->_drainData);
+
+      while (task) {
+        Task* next = task->_next;
+        completeTask(task);
+
+        if (--self->_activeTasks == 0)
+          uv_unref(reinterpret_cast<uv_handle_t*>(self->_async));
+        task = next;
+      }
+    }
+
+    static NJS_NOINLINE void onClose(uv_handle_t* handle) noexcept {
+      delete reinterpret_cast<uv_async_t*>(handle);
+    }
+
+    Task* _first;
+    Task* _last;
+    uv_mutex_t _lock;
+    uv_async_t* _async;
+    //! Number of posted tasks not completed yet (loop thread).
+    size_t _activeTasks;
+    DrainHandler _drainHandler;
+    void* _drainData;
+  };
+} // {Internal}
+
+// ============================================================================
+// [njs::ThreadPool]
+// ============================================================================
+
+struct ThreadPoolOptions {
+  enum Flags : uint32_t {
+    kFlagNone = 0x0,
+    //! Keep a queue per NUMA node and run tasks on the node of their locality
+    //! hint, other nodes only steal them if they have nothing else to do.
+    kFlagNumaAware = 0x1,
+    //! Pin each thread to the CPUs of its NUMA node.
+    kFlagPinToNode = 0x2,
+    //! Pin each thread to a single CPU.
+    kFlagPinToCpu = 0x4
+  };
+
+  NJS_INLINE ThreadPoolOptions() noexcept
+    : threadCount(0),
+      flags(kFlagNone),
+      cpus(nullptr),
+      cpuCount(0) {}
+
+  //! Number of threads, zero means one thread per usable CPU.
+  uint32_t threadCount;
+  //! Flags, see `Flags`.
+  uint32_t flags;
+  //! CPUs the threads may run on, null means all CPUs the process can use.
+  const uint32_t* cpus;
+  uint32_t cpuCount;
+};
+
+//! Thread-pool with optional CPU affinity and NUMA-aware scheduling (affinity
+//! and NUMA are only supported on Linux, other platforms and single-node
+//! machines behave like a plain thread-pool with a single queue).
+//!
+//! The pool is bound to the loop of the runtime it was initialized with and
+//! tasks must only be posted from that loop. Finished tasks are handed back to the loop through
+//! `uv_async_t`, which keeps the loop alive only while tasks are in flight.
+class ThreadPool : public Executor {
+public:
+  NJS_NONCOPYABLE(ThreadPool)
+
+  enum : uint32_t {
+    //! Maximum number of NUMA nodes, CPUs of other nodes are not used.
+    kMaxNodes = 8
+  };
+
+  struct Queue {
+    Task* first;
+    Task* last;
+    //! Number of threads serving this queue.
+    uint32_t threadCount;
+    //! Number of threads waiting for `cond`.
+    uint32_t idleCount;
+    uv_cond_t cond;
+#if defined(__linux__)
+    //! Usable CPUs of this node.
+    cpu_set_t cpus;
+#endif // __linux__
+  };
+
+  struct Worker {
+    ThreadPool* pool;
+    //! Queue (NUMA node) the worker belongs to.
+    uint32_t node;
+    //! CPU the worker is pinned to or -1.
+    int cpu;
+    uv_thread_t thread;
+  };
+
+  NJS_INLINE ThreadPool() noexcept
+    : _workers(nullptr),
+      _workerCount(0),
+      _nodeCount(0),
+      _nextNode(0),
+      _flags(0),
+      _stopping(false),
+      _stealCount(0) {}
+
+  NJS_INLINE ~ThreadPool() noexcept { shutdown(); }
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  NJS_INLINE bool isValid() const noexcept { return _workerCount != 0; }
+  NJS_INLINE uint32_t threadCount() const noexcept { return _workerCount; }
+  NJS_INLINE uint32_t nodeCount() const noexcept { return _nodeCount; }
+
+  //! Number of tasks executed by a thread of a different node than the one
+  //! the task was queued to.
+  NJS_INLINE uint64_t stealCount() const noexcept { return _stealCount.load(std::memory_order_relaxed); }
+
+  // --------------------------------------------------------------------------
+  // [Init]
+  // --------------------------------------------------------------------------
+
+  //! Starts the threads, the pool is bound to the loop of `runtime`.
+  NJS_NOINLINE Result init(const Runtime& runtime, const ThreadPoolOptions& options = ThreadPoolOptions()) noexcept {
+    if (_workerCount)
+      return Globals::kResultInvalidState;
+
+    _flags = options.flags;
+    _stopping = false;
+
+    // Each usable CPU gets an entry, CPUs are sorted by node, so assigning
+    // threads to entries in order spreads them across nodes proportionally.
+    uint32_t cpuCount = _detectTopology(options);
+    uint32_t threadCount = options.threadCount ? options.threadCount : cpuCount;
+
+    uint32_t* cpuList = new (std::nothrow) uint32_t[cpuCount * 2];
+    _workers = new (std::nothrow) Worker[threadCount];
+
+    if (!cpuList || !_workers || _completion.open(Internal::loopOf(runtime)) != Globals::kResultOk) {
+      delete[] cpuList;
+      delete[] _workers;
+      _workers = nullptr;
+      _completion.close();
+      return Globals::kResultOutOfMemory;
+    }
+
+    _fillCpuList(cpuList, cpuCount);
+
+    uv_mutex_init(&_lock);
+    for (uint32_t i = 0; i < _nodeCount; i++)
+      uv_cond_init(&_queues[i].cond);
+
+    for (uint32_t i = 0; i < threadCount; i++) {
+      Worker& worker = _workers[i];
+      uint32_t entry = (i % cpuCount) * 2;
+
+      worker.pool = this;
+      worker.node = cpuList[entry + 1];
+      worker.cpu = (_flags & ThreadPoolOptions::kFlagPinToCpu) ? int(cpuList[entry]) : -1;
+      _queues[worker.node].threadCount++;
+
+      if (uv_thread_create(&worker.thread, workerMain, &worker) != 0) {
+        _queues[worker.node].threadCount--;
+        break;
+      }
+      _workerCount++;
+    }
+
+    delete[] cpuList;
+    if (!_workerCount) {
+      shutdown();
+      return Globals::kResultInvalidState;
+    }
+
+    return Globals::kResultOk;
+  }
+
+  //! Stops and joins all threads, tasks must not be in flight.
+  NJS_NOINLINE void shutdown() noexcept {
+    if (!_completion.isOpen())
+      return;
+
+    uv_mutex_lock(&_lock);
+    _stopping = true;
+    for (uint32_t i = 0; i < _nodeCount; i++)
+      uv_cond_broadcast(&_queues[i].cond);
+    uv_mutex_unlock(&_lock);
+
+    for (uint32_t i = 0; i < _workerCount; i++)
+      uv_thread_join(&_workers[i].thread);
+
+    for (uint32_t i = 0; i < _nodeCount; i++)
+      uv_cond_destroy(&_queues[i].cond);
+    uv_mutex_destroy(&_lock);
+    _completion.close();
+
+    delete[] _workers;
+    _workers = nullptr;
+    _workerCount = 0;
+    _nodeCount = 0;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Post]
+  // --------------------------------------------------------------------------
+
+  void post(Task* task) noexcept override {
+    NJS_ASSERT(_workerCount != 0);
+
+    _completion.addActive();
+
+    uint32_t node = task->_locality;
+    if (node >= _nodeCount || !_queues[node].threadCount) {
+      do {
+        node = _nextNode;
+        _nextNode = (_nextNode + 1) % _nodeCount;
+      } while (!_queues[node].threadCount);
+    }
+
+    task->_next = nullptr;
+
+    uv_mutex_lock(&_lock);
+    Queue& queue = _queues[node];
+    if (queue.last)
+      queue.last->_next = task;
+    else
+      queue.first = task;
+    queue.last = task;
+
+    // Wake up a thread of the node, or of any other node if all are busy.
+    if (queue.idleCount) {
+      uv_cond_signal(&queue.cond);
+    }
+    else {
+      for (uint32_t i = 0; i < _nodeCount; i++) {
+        if (_queues[i].idleCount) {
+          uv_cond_signal(&_queues[i].cond);
+          break;
+        }
+      }
+    }
+    uv_mutex_unlock(&_lock);
+  }
+
+  // --------------------------------------------------------------------------
+  // [NUMA]
+  // --------------------------------------------------------------------------
+
+  //! Returns the NUMA node of the memory at `p` or `Task::kLocalityAny` if it's
+  //! not known. The page is faulted in if it wasn't touched yet.
+  static NJS_NOINLINE uint32_t nodeOf(const void* p) noexcept {
+#if defined(__linux__) && defined(__NR_get_mempolicy)
+    // MPOL_F_NODE | MPOL_F_ADDR, see <linux/mempolicy.h>.
+    int node = -1;
+    if (::syscall(__NR_get_mempolicy, &node, nullptr, 0UL, const_cast<void*>(p), 0x1UL | 0x2UL) == 0 && node >= 0)
+      return uint32_t(node);
+#endif // __linux__
+
+    return Task::kLocalityAny;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  // Initializes queues and returns the number of usable CPUs.
+  NJS_NOINLINE uint32_t _detectTopology(const ThreadPoolOptions& options) noexcept {
+    for (uint32_t i = 0; i < kMaxNodes; i++) {
+      _queues[i].first = nullptr;
+      _queues[i].last = nullptr;
+      _queues[i].threadCount = 0;
+      _queues[i].idleCount = 0;
+    }
+
+#if defined(__linux__)
+    cpu_set_t allowed;
+    if (::sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+      return _singleNode(4);
+
+    if (options.cpus) {
+      cpu_set_t requested;
+      CPU_ZERO(&requested);
+      for (uint32_t i = 0; i < options.cpuCount; i++)
+        if (options.cpus[i] < CPU_SETSIZE)
+          CPU_SET(options.cpus[i], &requested);
+      CPU_AND(&allowed, &allowed, &requested);
+    }
+
+    uint32_t cpuCount = uint32_t(CPU_COUNT(&allowed));
+    if (!cpuCount)
+      return _singleNode(4);
+
+    // Without NUMA awareness, or on a single-node machine, all CPUs belong
+    // to a single queue.
+    _nodeCount = 0;
+    if (_flags & ThreadPoolOptions::kFlagNumaAware) {
+      // Node IDs can be sparse, so only the online ones are read. Nodes that
+      // have no usable CPU don't get a queue.
+      cpu_set_t nodes;
+      if (_readList("/sys/devices/system/node/online", &nodes)) {
+        for (uint32_t node = 0; node < CPU_SETSIZE && _nodeCount < kMaxNodes; node++) {
+          if (!CPU_ISSET(node, &nodes))
+            continue;
+
+          cpu_set_t& cpus = _queues[_nodeCount].cpus;
+          if (!_readNodeCpus(node, &cpus))
+            continue;
+
+          CPU_AND(&cpus, &cpus, &allowed);
+          if (CPU_COUNT(&cpus))
+            _nodeCount++;
+        }
+      }
+    }
+
+    if (_nodeCount <= 1) {
+      _nodeCount = 1;
+      _queues[0].cpus = allowed;
+      return cpuCount;
+    }
+
+    cpuCount = 0;
+    for (uint32_t i = 0; i < _nodeCount; i++)
+      cpuCount += uint32_t(CPU_COUNT(&_queues[i].cpus));
+    return cpuCount ? cpuCount : _singleNode(1);
+#else
+    return _singleNode(4);
+#endif // __linux__
+  }
+
+  NJS_NOINLINE uint32_t _singleNode(uint32_t cpuCount) noexcept {
+#if defined(__linux__)
+    CPU_ZERO(&_queues[0].cpus);
+#endif // __linux__
+
+    _nodeCount = 1;
+    _flags &= ~uint32_t(ThreadPoolOptions::kFlagPinToNode | ThreadPoolOptions::kFlagPinToCpu);
+    return cpuCount;
+  }
+
+  // Fills `cpuCount` pairs of [cpu, node] sorted by node.
+  NJS_NOINLINE void _fillCpuList(uint32_t* cpuList, uint32_t cpuCount) const noexcept {
+    uint32_t n = 0;
+
+#if defined(__linux__)
+    if (_flags & (ThreadPoolOptions::kFlagPinToNode | ThreadPoolOptions::kFlagPinToCpu)) {
+      for (uint32_t node = 0; node < _nodeCount; node++) {
+        for (uint32_t cpu = 0; cpu < CPU_SETSIZE && n < cpuCount; cpu++) {
+          if (CPU_ISSET(cpu, &_queues[node].cpus)) {
+            cpuList[n * 2 + 0] = cpu;
+            cpuList[n * 2 + 1] = node;
+            n++;
+          }
+        }
+      }
+    }
+    else {
+      for (uint32_t node = 0; node < _nodeCount; node++) {
+        uint32_t count = uint32_t(CPU_COUNT(&_queues[node].cpus));
+        for (uint32_t i = 0; i < count && n < cpuCount; i++, n++) {
+          cpuList[n * 2 + 0] = 0;
+          cpuList[n * 2 + 1] = node;
+        }
+      }
+    }
+#endif // __linux__
+
+    for (; n < cpuCount; n++) {
+      cpuList[n * 2 + 0] = 0;
+      cpuList[n * 2 + 1] = 0;
+    }
+  }
+
+#if defined(__linux__)
+  // Reads CPUs of a NUMA node from sysfs, returns false if the node doesn't
+  // exist (or sysfs is not available).
+  static NJS_INLINE bool _readNodeCpus(uint32_t node, cpu_set_t* cpus) noexcept {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+    return _readList(path, cpus);
+  }
+
+  // Reads a sysfs list of CPUs or nodes into `set`, returns false if the file
+  // can't be read. Node IDs are below `CPU_SETSIZE`, so `cpu_set_t` is used as
+  // a set of them too.
+  static NJS_NOINLINE bool _readList(const char* path, cpu_set_t* set) noexcept {
+    FILE* file = fopen(path, "r");
+    if (!file)
+      return false;
+
+    char buffer[1024];
+    bool ok = fgets(buffer, sizeof(buffer), file) != nullptr;
+    fclose(file);
+
+    if (!ok)
+      return false;
+
+    // The format is a list of IDs and ranges like "0-3,8,10-11".
+    CPU_ZERO(set);
+    const char* p = buffer;
+
+    while (*p >= '0' && *p <= '9') {
+      char* end;
+      unsigned long first = strtoul(p, &end, 10);
+      unsigned long last = first;
+
+      if (*end == '-')
+        last = strtoul(end + 1, &end, 10);
+
+      for (unsigned long id = first; id <= last && id < CPU_SETSIZE; id++)
+        CPU_SET(id, set);
+
+      p = *end == ',' ? end + 1 : end;
+    }
+    return true;
+  }
+#endif // __linux__
+
+  // Pins the calling thread according to the pool's flags.
+  NJS_NOINLINE void _pin(const Worker& worker) const noexcept {
+#if defined(__linux__)
+    if (worker.cpu >= 0) {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(worker.cpu, &cpus);
+      ::sched_setaffinity(0, sizeof(cpus), &cpus);
+    }
+    else if (_flags & ThreadPoolOptions::kFlagPinToNode) {
+      ::sched_setaffinity(0, sizeof(cpu_set_t), &_queues[worker.node].cpus);
+    }
+#endif // __linux__
+  }
+
+  // Pops a task of `node` (must be called with `_lock` held).
+  NJS_INLINE Task* _pop(uint32_t node) noexcept {
+    Queue& queue = _queues[node];
+    Task* task = queue.first;
+
+    if (task) {
+      queue.first = task->_next;
+      if (!queue.first)
+        queue.last = nullptr;
+    }
+    return task;
+  }
+
+  static NJS_NOINLINE void workerMain(void* arg) noexcept {
+    Worker& worker = *static_cast<Worker*>(arg);
+    ThreadPool* self = worker.pool;
+    Queue& queue = self->_queues[worker.node];
+
+    self->_pin(worker);
+    uv_mutex_lock(&self->_lock);
+
+    for (;;) {
+      Task* task = self->_pop(worker.node);
+
+      // Steal from other nodes only if there is nothing to do locally.
+      if (!task) {
+        for (uint32_t i = 1; i < self->_nodeCount && !task; i++)
+          task = self->_pop((worker.node + i) % self->_nodeCount);
+        if (task)
+          self->_stealCount.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      if (task) {
+        uv_mutex_unlock(&self->_lock);
+        Internal::runWork(task);
+        self->_completion.push(task);
+        uv_mutex_lock(&self->_lock);
+        continue;
+      }
+
+      if (self->_stopping)
+        break;
+
+      queue.idleCount++;
+      uv_cond_wait(&queue.cond, &self->_lock);
+      queue.idleCount--;
+    }
+
+    uv_mutex_unlock(&self->_lock);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  Worker* _workers;
+  uint32_t _workerCount;
+  //! Number of used queues (one if the pool is not NUMA aware).
+  uint32_t _nodeCount;
+  //! Queue used for the next task without locality (loop thread).
+  uint32_t _nextNode;
+  //! Flags, see `ThreadPoolOptions::Flags`.
+  uint32_t _flags;
+  bool _stopping;
+
+  //! Number of stolen tasks, atomic as it's read without `_lock`.
+  std::atomic<uint64_t> _stealCount;
+
+  //! Protects queues and `_stopping`.
+  uv_mutex_t _lock;
+  Queue _queues[kMaxNodes];
+
+  //! Finished tasks, filled by workers and drained by the loop thread.
+  Internal::CompletionQueue _completion;
+};
+
+// ============================================================================
+// [njs::PlatformExecutor]
+// ============================================================================
+
+//! Executor that runs tasks on worker threads of the V8 platform.
+//!
+//! These threads are shared with V8 (concurrent compilation and GC) and are
+//! usually warm, and tasks posted here don't compete with file system and DNS
+//! requests queued to the libuv thread-pool, which makes the executor a good
+//! fit for short CPU bound tasks. Task classes select it by posting their
+//! tasks by `PostTask(task, &executor)`.
+//!
+//! Finished tasks are handed back to the loop by the executor itself and not
+//! by the platform's foreground task runner, because tasks pending there don't
+//! keep the loop alive.
+class PlatformExecutor : public Executor {
+public:
+  NJS_NONCOPYABLE(PlatformExecutor)
+
+  class WorkerTask : public v8::Task {
+  public:
+    NJS_INLINE WorkerTask(PlatformExecutor* executor, njs::Task* task) noexcept
+      : _executor(executor),
+        _task(task) {}
+
+    void Run() override {
+      Internal::runWork(_task);
+      _executor->_completion.push(_task);
+    }
+
+    PlatformExecutor* _executor;
+    njs::Task* _task;
+  };
+
+  NJS_INLINE PlatformExecutor() noexcept
+    : _platform(nullptr) {}
+  NJS_INLINE ~PlatformExecutor() noexcept { shutdown(); }
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  NJS_INLINE bool isValid() const noexcept { return _platform != nullptr; }
+  NJS_INLINE v8::Platform* platform() const noexcept { return _platform; }
+
+  NJS_INLINE uint32_t threadCount() const noexcept {
+    return _platform ? uint32_t(_platform->NumberOfWorkerThreads()) : 0u;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Init]
+  // --------------------------------------------------------------------------
+
+  //! Binds the executor to the loop of `ctx` and to `platform`, which can be
+  //! null when integrated with node to use the platform of the environment.
+  NJS_NOINLINE Result init(Context& ctx, v8::Platform* platform = nullptr) noexcept {
+    if (_platform)
+      return Globals::kResultInvalidState;
+
+#if defined(NJS_INTEGRATE_NODE)
+    if (!platform) {
+      ::node::Environment* env = ::node::GetCurrentEnvironment(ctx.v8Context());
+      if (env)
+        platform = ::node::GetMultiIsolatePlatform(env);
+    }
+#endif // NJS_INTEGRATE_NODE
+
+    if (!platform)
+      return Globals::kResultInvalidState;
+
+    NJS_CHECK(_completion.open(Internal::loopOf(ctx.runtime())));
+    _platform = platform;
+    return Globals::kResultOk;
+  }
+
+  //! Detaches the executor from the platform, tasks must not be in flight.
+  NJS_NOINLINE void shutdown() noexcept {
+    _completion.close();
+    _platform = nullptr;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Post]
+  // --------------------------------------------------------------------------
+
+  void post(njs::Task* task) noexcept override {
+    NJS_ASSERT(_platform != nullptr);
+    _completion.addActive();
+
+    WorkerTask* workerTask = new (std::nothrow) WorkerTask(this, task);
+    if (!workerTask) {
+      // Still asynchronous, completed when the loop polls the queue.
+      Internal::runWork(task);
+      _completion.push(task);
+      return;
+    }
+
+    _platform->CallOnWorkerThread(std::unique_ptr<v8::Task>(workerTask));
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  v8::Platform* _platform;
+  //! Finished tasks, filled by platform threads and drained by the loop thread.
+  Internal::CompletionQueue _completion;
+};
+
+// ============================================================================
+// [njs::Timer]
+// ============================================================================
+
+class TimerWheel;
+
+//! Link of a circular doubly linked list of timers, each slot of a wheel has
+//! a sentinel link, so a timer can be unlinked without knowing its slot.
+struct TimerLink {
+  NJS_INLINE TimerLink() noexcept
+    : _prev(this),
+      _next(this) {}
+
+  NJS_INLINE bool _isLinked() const noexcept { return _next != this; }
+
+  NJS_INLINE void _unlink() noexcept {
+    _prev->_next = _next;
+    _next->_prev = _prev;
+    _prev = this;
+    _next = this;
+  }
+
+  NJS_INLINE void _append(TimerLink* link) noexcept {
+    link->_prev = _prev;
+    link->_next = this;
+    _prev->_next = link;
+    _prev = link;
+  }
+
+  TimerLink* _prev;
+  TimerLink* _next;
+};
+
+//! Native timer driven by `TimerWheel`, usually embedded in the object it
+//! times out (per-connection idle timers and alike).
+class Timer : public TimerLink {
+public:
+  NJS_NONCOPYABLE(Timer)
+
+  NJS_INLINE Timer() noexcept
+    : _wheel(nullptr),
+      _expiry(0),
+      _slot(0) {}
+
+  virtual ~Timer() noexcept;
+
+  //! Called on the loop thread when the timer expires. All timers expired by
+  //! the same tick share `ctx`, its handle scope and callback scope, so JS can
+  //! be called from here. The timer can be started again.
+  virtual void onTimer(Context& ctx) noexcept = 0;
+
+  //! Called if the timer is still active when its wheel is shut down.
+  virtual void onDetach() noexcept {}
+
+  NJS_INLINE bool isActive() const noexcept { return _wheel != nullptr; }
+  NJS_INLINE TimerWheel* wheel() const noexcept { return _wheel; }
+
+  //! Wheel the timer is active in or null.
+  TimerWheel* _wheel;
+  //! Tick the timer expires at.
+  uint64_t _expiry;
+  //! Slot of the wheel (level * kSlotCount + index) or `kSlotExpired`.
+  uint32_t _slot;
+};
+
+// ============================================================================
+// [njs::TimerWheel]
+// ============================================================================
+
+namespace Internal {
+  //! Returns the index of the lowest bit set in `mask`, which must not be zero.
+  static NJS_INLINE uint32_t lowestBit(uint64_t mask) noexcept {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return uint32_t(index);
+#else
+    return uint32_t(__builtin_ctzll(mask));
+#endif
+  }
+} // {Internal}
+
+//! Hierarchical timer wheel driven by a single `uv_timer_t`.
+//!
+//! The wheel has `kLevelCount` levels of `kSlotCount` slots, a slot of level N
+//! covers `kSlotCount^N` ticks of `resolution` milliseconds. Starting and
+//! canceling a timer is O(1), timers of upper levels move down when their slot
+//! comes, which happens once per `kSlotCount^N` ticks. Expiry ticks are rounded
+//! up to a multiple of the slack, so timers started around the same time fire
+//! together. The `uv_timer_t` only runs when the next non-empty slot is due,
+//! it keeps the loop alive while any timer is active.
+class TimerWheel {
+public:
+  NJS_NONCOPYABLE(TimerWheel)
+
+  enum : uint32_t {
+    kLevelBits = 6,
+    kSlotCount = 1u << kLevelBits,
+    kSlotMask = kSlotCount - 1,
+    kLevelCount = 4,
+    kSlotExpired = kLevelCount * kSlotCount
+  };
+
+  enum : uint64_t {
+    //! Maximum number of ticks a timer can be placed ahead, timers set further
+    //! are placed to the last level and moved again when their slot comes.
+    kMaxTicks = (uint64_t(1) << (kLevelBits * kLevelCount)) - 1,
+    kNever = ~uint64_t(0)
+  };
+
+  NJS_INLINE TimerWheel() noexcept
+    : _timer(nullptr),
+      _resolution(1),
+      _slack(1),
+      _base(0),
+      _now(0),
+      _scheduled(kNever),
+      _activeCount(0),
+      _firedCount(0) {
+    for (uint32_t i = 0; i < kLevelCount; i++)
+      _masks[i] = 0;
+  }
+
+  NJS_INLINE ~TimerWheel() noexcept { shutdown(); }
+
+  // --------------------------------------------------------------------------
+  // [Init / Shutdown]
+  // --------------------------------------------------------------------------
+
+  //! Initializes the wheel on the loop of `runtime`. The `resolution` is the
+  //! length of a tick and `slack` the window timers are coalesced in, both in
+  //! milliseconds.
+  NJS_NOINLINE Result init(const Runtime& runtime, uint32_t resolution = 1, uint32_t slack = 0) noexcept {
+    if (_timer)
+      return Globals::kResultInvalidState;
+
+    // Allocated separately as it must outlive the wheel until it's closed.
+    _timer = new (std::nothrow) uv_timer_t;
+    if (!_timer)
+      return Globals::kResultOutOfMemory;
+
+    uv_loop_t* loop = Internal::loopOf(runtime);
+    uv_timer_init(loop, _timer);
+    _timer->data = this;
+
+    _runtime = runtime;
+    _resolution = resolution ? resolution : 1u;
+    _slack = (slack + _resolution - 1) / _resolution;
+    if (!_slack)
+      _slack = 1;
+
+    _base = uv_now(loop);
+    _now = 0;
+    _scheduled = kNever;
+
+#if defined(NJS_INTEGRATE_NODE)
+    ScopedContext ctx(runtime);
+    Value resource = ctx.newObject();
+
+    ctx.makePersistent(resource, _asyncResource);
+    _asyncContext = node::EmitAsyncInit(ctx.v8Isolate(), resource.v8HandleAs<v8::Object>(), "NJS_TIMER_WHEEL");
+#endif // NJS_INTEGRATE_NODE
+    return Globals::kResultOk;
+  }
+
+  //! Detaches all active timers (see `Timer::onDetach()`) and closes the wheel.
+  NJS_NOINLINE void shutdown() noexcept {
+    if (!_timer)
+      return;
+
+    for (uint32_t i = 0; i <= kSlotExpired; i++) {
+      TimerLink& head = _slots[i];
+      while (head._isLinked()) {
+        Timer* timer = static_cast<Timer*>(head._next);
+        _remove(timer);
+        timer->onDetach();
+      }
+    }
+
+#if defined(NJS_INTEGRATE_NODE)
+    node::EmitAsyncDestroy(_runtime.v8Isolate(), _asyncContext);
+    _asyncResource.release();
+#endif // NJS_INTEGRATE_NODE
+
+    uv_close(reinterpret_cast<uv_handle_t*>(_timer), onClose);
+    _timer = nullptr;
+  }
+
+  NJS_INLINE bool isInitialized() const noexcept { return _timer != nullptr; }
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  NJS_INLINE uint32_t resolution() const noexcept { return _resolution; }
+  //! Returns the number of active timers.
+  NJS_INLINE size_t activeCount() const noexcept { return _activeCount; }
+  //! Returns the number of timers fired since the wheel was initialized.
+  NJS_INLINE uint64_t firedCount() const noexcept { return _firedCount; }
+
+  // --------------------------------------------------------------------------
+  // [Timers]
+  // --------------------------------------------------------------------------
+
+  //! Starts `timer` to expire in `timeout` milliseconds, restarts it if it's
+  //! already active. Must be called on the loop thread.
+  NJS_NOINLINE void start(Timer* timer, uint64_t timeout) noexcept {
+    NJS_ASSERT(_timer != nullptr);
+
+    if (timer->_wheel)
+      timer->_wheel->cancel(timer);
+
+    uint64_t current = _currentTick();
+    if (!_activeCount)
+      _now = current;
+
+    uint64_t expiry = current + (timeout + _resolution - 1) / _resolution;
+    if (_slack > 1)
+      expiry = (expiry + _slack - 1) / _slack * _slack;
+    if (expiry <= _now)
+      expiry = _now + 1;
+
+    timer->_wheel = this;
+    timer->_expiry = expiry;
+    _activeCount++;
+
+    _insert(timer);
+    if (expiry < _scheduled)
+      _schedule();
+  }
+
+  //! Cancels `timer`, does nothing if it's not active.
+  NJS_NOINLINE void cancel(Timer* timer) noexcept {
+    if (timer->_wheel != this)
+      return;
+
+    _remove(timer);
+    if (!_activeCount)
+      _schedule();
+  }
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  NJS_INLINE uint64_t _currentTick() const noexcept {
+    return (uv_now(_timer->loop) - _base) / _resolution;
+  }
+
+  // Links `timer` to the slot its expiry falls into, relative to `_now`.
+  NJS_NOINLINE void _insert(Timer* timer) noexcept {
+    uint64_t delta = timer->_expiry - _now;
+    uint64_t expiry = timer->_expiry;
+
+    if (delta > kMaxTicks)
+      expiry = _now + kMaxTicks;
+
+    uint32_t level = 0;
+    while (level < kLevelCount - 1 && (expiry - _now) >= (uint64_t(1) << (kLevelBits * (level + 1))))
+      level++;
+
+    uint32_t index = uint32_t(expiry >> (kLevelBits * level)) & kSlotMask;
+    uint32_t slot = level * kSlotCount + index;
+
+    timer->_slot = slot;
+    _slots[slot]._append(timer);
+    _masks[level] |= uint64_t(1) << index;
+  }
+
+  NJS_NOINLINE void _remove(Timer* timer) noexcept {
+    uint32_t slot = timer->_slot;
+    timer->_unlink();
+    timer->_wheel = nullptr;
+    _activeCount--;
+
+    if (slot != kSlotExpired && !_slots[slot]._isLinked())
+      _masks[slot / kSlotCount] &= ~(uint64_t(1) << (slot & kSlotMask));
+  }
+
+  // Returns the next tick the wheel has to process, which is either the tick
+  // of the next non-empty slot, or a tick upper levels move down at.
+  NJS_NOINLINE uint64_t _nextTick() const noexcept {
+    for (uint32_t level = 0; level < kLevelCount; level++) {
+      uint32_t shift = kLevelBits * level;
+      uint32_t index = uint32_t(_now >> shift) & kSlotMask;
+
+      uint64_t mask = index < kSlotMask ? _masks[level] & (~uint64_t(0) << (index + 1)) : uint64_t(0);
+      if (mask)
+        return (((_now >> shift) & ~uint64_t(kSlotMask)) + Internal::lowestBit(mask)) << shift;
+
+      // Slots at or before `index` come in the next rotation of this level.
+      if (_masks[level])
+        return (((_now >> shift) | kSlotMask) + 1) << shift;
+    }
+    return kNever;
+  }
+
+  // Processes all ticks up to `target` and moves expired timers to the
+  // expired list.
+  NJS_NOINLINE void _advance(uint64_t target) noexcept {
+    while (_now < target) {
+      uint64_t next = _nextTick();
+      if (next > target) {
+        _now = target;
+        break;
+      }
+
+      _now = next;
+
+      // Move timers of upper levels down, from the highest level that starts
+      // its next slot at this tick.
+      uint32_t top = 0;
+      while (top < kLevelCount - 1 && (_now & ((uint64_t(1) << (kLevelBits * (top + 1))) - 1)) == 0)
+        top++;
+
+      for (uint32_t level = top; level > 0; level--)
+        _cascade(level * kSlotCount + (uint32_t(_now >> (kLevelBits * level)) & kSlotMask));
+
+      // Timers placed beyond `kMaxTicks` are not expired yet and move again.
+      _cascade(uint32_t(_now) & kSlotMask);
+    }
+  }
+
+  // Moves timers of `slot` to the expired list or to a lower slot.
+  NJS_NOINLINE void _cascade(uint32_t slot) noexcept {
+    TimerLink list;
+    _takeSlot(slot, list);
+
+    while (list._isLinked()) {
+      Timer* timer = static_cast<Timer*>(list._next);
+      timer->_unlink();
+
+      if (timer->_expiry <= _now) {
+        timer->_slot = kSlotExpired;
+        _slots[kSlotExpired]._append(timer);
+      }
+      else {
+        _insert(timer);
+      }
+    }
+  }
+
+  // Moves all timers of `slot` to `list`.
+  NJS_INLINE void _takeSlot(uint32_t slot, TimerLink& list) noexcept {
+    TimerLink& head = _slots[slot];
+    if (!head._isLinked())
+      return;
+
+    list._next = head._next;
+    list._prev = head._prev;
+    list._next->_prev = &list;
+    list._prev->_next = &list;
+
+    head._prev = &head;
+    head._next = &head;
+    _masks[slot / kSlotCount] &= ~(uint64_t(1) << (slot & kSlotMask));
+  }
+
+  // Starts the `uv_timer_t` to fire when the next slot is due, or stops it.
+  NJS_NOINLINE void _schedule() noexcept {
+    uint64_t next = _activeCount ? _nextTick() : kNever;
+    _scheduled = next;
+
+    if (next == kNever) {
+      uv_timer_stop(_timer);
+      return;
+    }
+
+    uint64_t due = _base + next * _resolution;
+    uint64_t now = uv_now(_timer->loop);
+    uv_timer_start(_timer, onTick, due > now ? due - now : 0, 0);
+  }
+
+  // Fires expired timers, all of them share a single scope.
+  NJS_NOINLINE void _fire() noexcept {
+    TimerLink& expired = _slots[kSlotExpired];
+    if (!expired._isLinked())
+      return;
+
+    ScopedContext ctx(_runtime);
+#if defined(NJS_INTEGRATE_NODE)
+    // Process `nextTick()` queue and microtasks after the timers, like node
+    // does after its own timers. Timers that call JS enter their own async
+    // context in a nested scope (see `CallbackTimer`).
+    Value resource = ctx.makeLocal(_asyncResource);
+    node::CallbackScope callbackScope(ctx.v8Isolate(), resource.v8HandleAs<v8::Object>(), _asyncContext);
+#endif // NJS_INTEGRATE_NODE
+
+    while (expired._isLinked()) {
+      Timer* timer = static_cast<Timer*>(expired._next);
+      _remove(timer);
+
+      _firedCount++;
+      timer->onTimer(ctx);
+    }
+  }
+
+  static NJS_NOINLINE void onTick(uv_timer_t* handle) noexcept {
+    TimerWheel* self = static_cast<TimerWheel*>(handle->data);
+
+    self->_advance(self->_currentTick());
+    self->_fire();
+
+    // The wheel could be shut down by a timer.
+    if (self->_timer)
+      self->_schedule();
+  }
+
+  static NJS_NOINLINE void onClose(uv_handle_t* handle) noexcept {
+    delete reinterpret_cast<uv_timer_t*>(handle);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  uv_timer_t* _timer;
+  Runtime _runtime;
+
+  //! Length of a tick in milliseconds.
+  uint32_t _resolution;
+  //! Slack in ticks, expiry ticks are rounded up to its multiple.
+  uint32_t _slack;
+  //! Loop time of tick zero.
+  uint64_t _base;
+  //! Last processed tick.
+  uint64_t _now;
+  //! Tick the `uv_timer_t` fires at or `kNever`.
+  uint64_t _scheduled;
+
+  size_t _activeCount;
+  uint64_t _firedCount;
+
+#if defined(NJS_INTEGRATE_NODE)
+  //! Async resource the expired timers are fired in.
+  Persistent _asyncResource;
+  node::async_context _asyncContext;
+#endif // NJS_INTEGRATE_NODE
+
+  //! Bit per non-empty slot of each level.
+  uint64_t _masks[kLevelCount];
+  //! Slots of all levels followed by the list of expired timers.
+  TimerLink _slots[kSlotExpired + 1];
+};
+
+NJS_INLINE Timer::~Timer() noexcept {
+  if (_wheel)
+    _wheel->cancel(this);
+}
+
+// ============================================================================
+// [njs::CallbackTimer]
+// ============================================================================
+
+//! Timer that calls a JS function once and destroys itself. The function is
+//! called in the async context the timer was created in.
+class CallbackTimer : public Timer {
+public:
+  NJS_NOINLINE CallbackTimer(Context& ctx, const Value& callback) noexcept
+    : _runtime(ctx.runtime()) {
+    ctx.makePersistent(callback, _callback);
+
+#if defined(NJS_INTEGRATE_NODE)
+    Value resource = ctx.newObject();
+    ctx.makePersistent(resource, _asyncResource);
+    _asyncContext = node::EmitAsyncInit(ctx.v8Isolate(), resource.v8HandleAs<v8::Object>(), "NJS_TIMER");
+#endif // NJS_INTEGRATE_NODE
+  }
+
+  NJS_NOINLINE ~CallbackTimer() noexcept {
+#if defined(NJS_INTEGRATE_NODE)
+    node::EmitAsyncDestroy(_runtime.v8Isolate(), _asyncContext);
+    _asyncResource.release();
+#endif // NJS_INTEGRATE_NODE
+
+    _callback.release();
+  }
+
+  void onTimer(Context& ctx) noexcept override {
+    Value callback = ctx.makeLocal(_callback);
+    {
+#if defined(NJS_INTEGRATE_NODE)
+      Value resource = ctx.makeLocal(_asyncResource);
+      node::CallbackScope callbackScope(ctx.v8Isolate(), resource.v8HandleAs<v8::Object>(), _asyncContext);
+#endif // NJS_INTEGRATE_NODE
+
+      ctx.call(callback, ctx.undefined());
+    }
+    delete this;
+  }
+
+  void onDetach() noexcept override { delete this; }
+
+  Runtime _runtime;
+  Persistent _callback;
+
+#if defined(NJS_INTEGRATE_NODE)
+  Persistent _asyncResource;
+  node::async_context _asyncContext;
+#endif // NJS_INTEGRATE_NODE
+};
+
+// ============================================================================
+// [njs::IoTask]
+// ============================================================================
+
+#if !defined(_WIN32)
+//! A single file I/O request queued by `IoTask`.
+struct IoRequest {
+  enum Op : uint32_t {
+    kOpRead = 0,
+    kOpWrite = 1
+  };
+
+  //! File descriptor.
+  int fd;
+  //! Operation, see `Op`.
+  uint32_t op;
+  //! Buffer and its size (iovec layout so it can be passed to the kernel).
+  struct iovec buffer;
+  //! Absolute file offset.
+  uint64_t offset;
+  //! Number of bytes transferred or a negated `errno` on failure.
+  intptr_t result;
+  //! Task that owns this request.
+  Task* task;
+};
+
+//! Task that performs file reads and writes (POSIX only).
+//!
+//! Requests are queued by `read()` and `write()` before the task is posted by
+//! `PostIoTask()`. If io_uring is available all requests of the task are
+//! submitted to the ring at once and no pool thread is blocked while they are
+//! in flight, otherwise the task is posted to the libuv thread-pool and the
+//! requests are performed by `onWork()` via `pread()` and `pwrite()`. In both
+//! cases `onDone()` is the continuation, which is called on the loop thread
+//! after all requests finished. Use `requestResult()` to check the results.
+class IoTask : public Task {
+public:
+  enum : uint32_t {
+    //! Maximum number of requests a single task can hold.
+    kMaxRequests = 8
+  };
+
+  NJS_INLINE IoTask(Context& ctx, Value data) noexcept
+    : Task(ctx, data),
+      _requestCount(0),
+      _pendingCount(0),
+      _ringPrev(nullptr),
+      _ringNext(nullptr) {}
+
+  // --------------------------------------------------------------------------
+  // [Requests]
+  // --------------------------------------------------------------------------
+
+  NJS_INLINE Result read(int fd, void* data, size_t size, uint64_t offset) noexcept {
+    return _addRequest(IoRequest::kOpRead, fd, data, size, offset);
+  }
+
+  NJS_INLINE Result write(int fd, const void* data, size_t size, uint64_t offset) noexcept {
+    return _addRequest(IoRequest::kOpWrite, fd, const_cast<void*>(data), size, offset);
+  }
+
+  NJS_INLINE uint32_t requestCount() const noexcept { return _requestCount; }
+  NJS_INLINE const IoRequest& requestAt(uint32_t index) const noexcept {
+    NJS_ASSERT(index < _requestCount);
+    return _requests[index];
+  }
+
+  //! Number of bytes transferred by the request at `index` or a negated errno.
+  NJS_INLINE intptr_t requestResult(uint32_t index) const noexcept {
+    return requestAt(index).result;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  //! Performs all requests synchronously, used when io_uring is not available.
+  void onWork() noexcept override {
+    for (uint32_t i = 0; i < _requestCount; i++) {
+      IoRequest& req = _requests[i];
+      ssize_t n = req.op == IoRequest::kOpRead
+        ? ::pread(req.fd, req.buffer.iov_base, req.buffer.iov_len, static_cast<off_t>(req.offset))
+        : ::pwrite(req.fd, req.buffer.iov_base, req.buffer.iov_len, static_cast<off_t>(req.offset));
+      req.result = n < 0 ? -static_cast<intptr_t>(errno) : static_cast<intptr_t>(n);
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  NJS_INLINE Result _addRequest(uint32_t op, int fd, void* data, size_t size, uint64_t offset) noexcept {
+    if (_requestCount >= kMaxRequests)
+      return Globals::kResultInvalidState;
+
+    IoRequest& req = _requests[_requestCount++];
+    req.fd = fd;
+    req.op = op;
+    req.buffer.iov_base = data;
+    req.buffer.iov_len = size;
+    req.offset = offset;
+    req.result = 0;
+    req.task = this;
+    return Globals::kResultOk;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  //! Number of queued requests.
+  uint32_t _requestCount;
+  //! Number of requests still in flight (only used by `IoRing`).
+#if defined(NJS_IO_URING)
+  std::atomic<uint32_t> _pendingCount;
+#else
+  uint32_t _pendingCount;
+#endif
+  //! Links of tasks in flight (only used by `IoRing`).
+  IoTask* _ringPrev;
+  IoTask* _ringNext;
+  //! Requests.
+  IoRequest _requests[kMaxRequests];
+};
+
+// ============================================================================
+// [njs::IoRing]
+// ============================================================================
+
+#if defined(NJS_IO_URING)
+//! Executor that submits `IoTask` requests to io_uring.
+//!
+//! The ring is owned by the loop thread, which is the only thread that writes
+//! submission entries. Completions are reaped by a dedicated thread that blocks
+//! in `io_uring_enter()`, and finished tasks are handed back to the loop through
+//! `Internal::CompletionQueue`. The number of requests in flight is limited by the size of the
+//! completion ring, requests that don't fit are queued and submitted as soon as
+//! other requests complete.
+//!
+//! If submitting or reaping fails the ring becomes unusable. Requests that were
+//! not submitted fail with the negated `errno` and requests in flight are
+//! cancelled, but their tasks only complete when the kernel reports them, as
+//! it may use their buffers until then. If the reaper can't wait anymore it
+//! polls the completion ring instead. Then `PostIoTask()` uses the thread-pool.
+class IoRing {
+public:
+  NJS_NONCOPYABLE(IoRing)
+
+  enum : uint32_t {
+    //! Number of submission queue entries requested from the kernel.
+    kDefaultEntries = 256
+  };
+
+  enum : uint64_t {
+    //! `user_data` of cancellations, requests are never at this address.
+    kCancelTag = 1
+  };
+
+  enum : uint8_t {
+    //! `IORING_OP_ASYNC_CANCEL` (Linux 5.5), older headers don't define it.
+    kOpAsyncCancel = 14
+  };
+
+  NJS_INLINE IoRing() noexcept
+    : _fd(-1),
+      _sqRing(MAP_FAILED),
+      _sqRingSize(0),
+      _cqRing(MAP_FAILED),
+      _cqRingSize(0),
+      _sqes(static_cast<struct io_uring_sqe*>(MAP_FAILED)),
+      _sqesSize(0),
+      _inFlight(0),
+      _overflowFirst(nullptr),
+      _overflowLast(nullptr),
+      _overflowIndex(0),
+      _activeFirst(nullptr),
+      _error(0),
+      _abandoned(false),
+      _reaperRunning(false) {
+    uv_mutex_init(&_lock);
+  }
+
+  NJS_INLINE ~IoRing() noexcept {
+    shutdown();
+    if (!_reaperRunning)
+      uv_mutex_destroy(&_lock);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  NJS_INLINE bool isValid() const noexcept { return _fd >= 0; }
+  //! Returns whether tasks can be posted, false if the ring failed.
+  NJS_INLINE bool isUsable() const noexcept { return _fd >= 0 && _error.load(std::memory_order_relaxed) == 0; }
+  //! Returns the `errno` the ring failed with or zero.
+  NJS_INLINE int error() const noexcept { return _error.load(std::memory_order_relaxed); }
+
+  // --------------------------------------------------------------------------
+  // [Init]
+  // --------------------------------------------------------------------------
+
+  //! Creates the ring and starts the reaper, everything acquired is released
+  //! if it fails.
+  NJS_NOINLINE bool init(uv_loop_t* loop, uint32_t entries = kDefaultEntries) noexcept {
+    NJS_ASSERT(_fd < 0);
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    _fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (_fd < 0)
+      return false;
+
+    _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    _cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    _sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    _sqRing = ::mmap(nullptr, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+    _cqRing = ::mmap(nullptr, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+    _sqes = static_cast<struct io_uring_sqe*>(::mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES));
+
+    if (_sqRing == MAP_FAILED || _cqRing == MAP_FAILED || _sqes == MAP_FAILED || _completion.open(loop) != Globals::kResultOk) {
+      _release();
+      return false;
+    }
+
+    uint8_t* sqBase = static_cast<uint8_t*>(_sqRing);
+    uint8_t* cqBase = static_cast<uint8_t*>(_cqRing);
+
+    _sqHead = reinterpret_cast<uint32_t*>(sqBase + params.sq_off.head);
+    _sqTail = reinterpret_cast<uint32_t*>(sqBase + params.sq_off.tail);
+    _sqMask = *reinterpret_cast<uint32_t*>(sqBase + params.sq_off.ring_mask);
+    _sqEntries = params.sq_entries;
+    _sqArray = reinterpret_cast<uint32_t*>(sqBase + params.sq_off.array);
+
+    _cqHead = reinterpret_cast<uint32_t*>(cqBase + params.cq_off.head);
+    _cqTail = reinterpret_cast<uint32_t*>(cqBase + params.cq_off.tail);
+    _cqMask = *reinterpret_cast<uint32_t*>(cqBase + params.cq_off.ring_mask);
+    _cqEntries = params.cq_entries;
+    _cqes = reinterpret_cast<struct io_uring_cqe*>(cqBase + params.cq_off.cqes);
+
+    _completion.setDrainHandler(onDrain, this);
+
+    // Without the reaper nothing would ever complete, io_uring is unusable.
+    if (uv_thread_create(&_reaper, reaperMain, this) != 0) {
+      _release();
+      return false;
+    }
+
+    _reaperRunning = true;
+    return true;
+  }
+
+  //! Stops the reaper and releases the ring, tasks must not be in flight. If
+  //! the reaper can't be stopped (the ring failed) the ring is left as is, as
+  //! the reaper may still use it.
+  NJS_NOINLINE void shutdown() noexcept {
+    if (_reaperRunning) {
+      if (!_submitStop())
+        return;
+
+      uv_thread_join(&_reaper);
+      _reaperRunning = false;
+    }
+
+    _release();
+  }
+
+  // --------------------------------------------------------------------------
+  // [Submit]
+  // --------------------------------------------------------------------------
+
+  //! Submits all requests of `task`, must be called on the loop thread.
+  NJS_NOINLINE void post(IoTask* task) noexcept {
+    _completion.addActive();
+
+    task->_pendingCount.store(task->_requestCount, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < task->_requestCount; i++)
+      task->_requests[i].result = -static_cast<intptr_t>(EINPROGRESS);
+
+    if (task->_requestCount == 0) {
+      _completion.push(task);
+      return;
+    }
+
+    // The reaper could have failed since the caller checked `isUsable()`.
+    uv_mutex_lock(&_lock);
+    int error = _error.load(std::memory_order_relaxed);
+    if (error)
+      _failTask(task, error);
+    else
+      _link(task);
+    uv_mutex_unlock(&_lock);
+
+    if (error)
+      return;
+
+    if (_overflowFirst)
+      _pushOverflow(task);
+    else
+      _submit(task, 0);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  static NJS_INLINE int _enter(int fd, unsigned int toSubmit, unsigned int minComplete, unsigned int flags) noexcept {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+  }
+
+  // Releases everything acquired by `init()`, the reaper must not be running.
+  NJS_NOINLINE void _release() noexcept {
+    _completion.close();
+
+    if (_sqes != MAP_FAILED)
+      ::munmap(_sqes, _sqesSize);
+    if (_cqRing != MAP_FAILED)
+      ::munmap(_cqRing, _cqRingSize);
+    if (_sqRing != MAP_FAILED)
+      ::munmap(_sqRing, _sqRingSize);
+
+    _sqes = static_cast<struct io_uring_sqe*>(MAP_FAILED);
+    _cqRing = MAP_FAILED;
+    _sqRing = MAP_FAILED;
+
+    if (_fd >= 0) {
+      ::close(_fd);
+      _fd = -1;
+    }
+  }
+
+  // Submits a NOP without a request, which tells the reaper to stop.
+  NJS_NOINLINE bool _submitStop() noexcept {
+    uint32_t tail = *_sqTail;
+    uint32_t head = __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+
+    if (tail - head >= _sqEntries)
+      return false;
+
+    uint32_t slot = tail & _sqMask;
+    struct io_uring_sqe* sqe = &_sqes[slot];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_NOP;
+    sqe->user_data = 0;
+
+    _sqArray[slot] = slot;
+    _inFlight.fetch_add(1, std::memory_order_relaxed);
+    __atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+
+    int result;
+    while ((result = _enter(_fd, tail + 1 - head, 0, 0)) < 0 && errno == EINTR)
+      continue;
+    return result > 0;
+  }
+
+  // Submits requests of `task` starting at `index`. Returns the index of the
+  // first request that couldn't be submitted, the rest is queued as overflow.
+  NJS_NOINLINE uint32_t _submit(IoTask* task, uint32_t index) noexcept {
+    uint32_t tail = *_sqTail;
+    uint32_t head = __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+    uint32_t count = 0;
+
+    while (index < task->_requestCount) {
+      if (tail - head >= _sqEntries || _inFlight.load(std::memory_order_acquire) >= _cqEntries)
+        break;
+
+      IoRequest& req = task->_requests[index];
+      uint32_t slot = tail & _sqMask;
+      struct io_uring_sqe* sqe = &_sqes[slot];
+
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = req.op == IoRequest::kOpRead ? IORING_OP_READV : IORING_OP_WRITEV;
+      sqe->fd = req.fd;
+      sqe->off = req.offset;
+      sqe->addr = reinterpret_cast<uint64_t>(&req.buffer);
+      sqe->len = 1;
+      sqe->user_data = reinterpret_cast<uint64_t>(&req);
+
+      _sqArray[slot] = slot;
+      _inFlight.fetch_add(1, std::memory_order_relaxed);
+
+      tail++;
+      index++;
+      count++;
+    }
+
+    if (count) {
+      __atomic_store_n(_sqTail, tail, __ATOMIC_RELEASE);
+
+      // On failure `_fail()` fails what wasn't submitted and cancels the rest.
+      if (!_enterPending())
+        return index;
+    }
+
+    if (index < task->_requestCount) {
+      _overflowIndex = index;
+      if (_overflowFirst != task)
+        _pushOverflow(task);
+    }
+    return index;
+  }
+
+  NJS_INLINE void _pushOverflow(IoTask* task) noexcept {
+    task->_next = nullptr;
+    if (_overflowLast)
+      _overflowLast->_next = task;
+    else
+      _overflowFirst = task;
+    _overflowLast = task;
+  }
+
+  // Submits all entries the kernel hasn't consumed yet. Returns false and fails
+  // the ring if the kernel doesn't accept them (loop thread).
+  NJS_NOINLINE bool _enterPending() noexcept {
+    for (;;) {
+      uint32_t pending = *_sqTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+      if (!pending)
+        return true;
+
+      int result = _enter(_fd, pending, 0, 0);
+      if (result < 0 && errno == EINTR)
+        continue;
+
+      if (result <= 0) {
+        _fail(result < 0 ? errno : EAGAIN);
+        return false;
+      }
+    }
+  }
+
+  // Submits queued requests after some requests completed (loop thread).
+  NJS_NOINLINE void _flushOverflow() noexcept {
+    while (_overflowFirst) {
+      // The link must be read before the submission, the reaper reuses it
+      // as soon as all requests of the task complete.
+      IoTask* task = _overflowFirst;
+      IoTask* next = static_cast<IoTask*>(task->_next);
+
+      uint32_t index = _submit(task, _overflowIndex);
+      if (!isUsable() || index < task->_requestCount)
+        break;
+
+      _overflowFirst = next;
+      _overflowIndex = 0;
+      if (!_overflowFirst)
+        _overflowLast = nullptr;
+    }
+  }
+
+  NJS_INLINE void _link(IoTask* task) noexcept {
+    task->_ringPrev = nullptr;
+    task->_ringNext = _activeFirst;
+    if (_activeFirst)
+      _activeFirst->_ringPrev = task;
+    _activeFirst = task;
+  }
+
+  NJS_INLINE void _unlink(IoTask* task) noexcept {
+    if (task->_ringPrev)
+      task->_ringPrev->_ringNext = task->_ringNext;
+    else
+      _activeFirst = task->_ringNext;
+
+    if (task->_ringNext)
+      task->_ringNext->_ringPrev = task->_ringPrev;
+  }
+
+  // Fails unfinished requests of `task` with `-error` and completes it, none
+  // of them was submitted.
+  NJS_NOINLINE void _failTask(IoTask* task, int error) noexcept {
+    for (uint32_t i = 0; i < task->_requestCount; i++) {
+      IoRequest& req = task->_requests[i];
+      if (req.result == -static_cast<intptr_t>(EINPROGRESS))
+        req.result = -static_cast<intptr_t>(error);
+    }
+    _completion.push(task);
+  }
+
+  // Fails a request that the kernel doesn't know about, completes its task if
+  // it was the last one in flight (`_lock` held).
+  NJS_NOINLINE void _failRequest(IoRequest* req, int error) noexcept {
+    IoTask* task = static_cast<IoTask*>(req->task);
+
+    req->result = -static_cast<intptr_t>(error);
+    if (task->_pendingCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      _unlink(task);
+      _completion.push(task);
+    }
+  }
+
+  // Drops submission entries the kernel hasn't consumed and fails their
+  // requests. Only the loop thread submits, so the kernel can't consume them
+  // concurrently (`_lock` held).
+  NJS_NOINLINE void _dropUnsubmitted(int error) noexcept {
+    uint32_t head = __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+    uint32_t tail = *_sqTail;
+
+    for (uint32_t i = head; i != tail; i++) {
+      uint64_t userData = _sqes[_sqArray[i & _sqMask]].user_data;
+      if (userData != 0 && userData != kCancelTag)
+        _failRequest(reinterpret_cast<IoRequest*>(userData), error);
+    }
+
+    __atomic_store_n(_sqTail, head, __ATOMIC_RELEASE);
+    _inFlight.fetch_sub(tail - head, std::memory_order_release);
+  }
+
+  // Cancels requests in flight (`_lock` held). The requests still complete
+  // through the completion ring, usually with `-ECANCELED`. Requests whose
+  // cancellation doesn't fit the rings are left to complete on their own.
+  NJS_NOINLINE void _cancelInFlight() noexcept {
+    uint32_t tail = *_sqTail;
+    uint32_t head = __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+    uint32_t count = 0;
+    bool full = false;
+
+    for (IoTask* task = _activeFirst; task && !full; task = task->_ringNext) {
+      for (uint32_t i = 0; i < task->_requestCount; i++) {
+        IoRequest& req = task->_requests[i];
+        if (req.result != -static_cast<intptr_t>(EINPROGRESS))
+          continue;
+
+        if (tail - head >= _sqEntries || _inFlight.load(std::memory_order_acquire) >= _cqEntries) {
+          full = true;
+          break;
+        }
+
+        uint32_t slot = tail & _sqMask;
+        struct io_uring_sqe* sqe = &_sqes[slot];
+
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = kOpAsyncCancel;
+        sqe->fd = -1;
+        sqe->addr = reinterpret_cast<uint64_t>(&req);
+        sqe->user_data = kCancelTag;
+
+        _sqArray[slot] = slot;
+        _inFlight.fetch_add(1, std::memory_order_relaxed);
+
+        tail++;
+        count++;
+      }
+    }
+
+    if (!count)
+      return;
+
+    __atomic_store_n(_sqTail, tail, __ATOMIC_RELEASE);
+    while (_enter(_fd, count, 0, 0) < 0 && errno == EINTR)
+      continue;
+
+    // Cancellations the kernel didn't take are dropped, they fail nothing.
+    _dropUnsubmitted(0);
+  }
+
+  // Fails what wasn't submitted and cancels the rest, once, after the ring
+  // failed (loop thread). Tasks with requests in flight are completed by the
+  // reaper, as the kernel may use their buffers until it reports them.
+  NJS_NOINLINE void _abandon() noexcept {
+    if (_abandoned.load(std::memory_order_relaxed))
+      return;
+
+    int error = _error.load(std::memory_order_relaxed);
+    uv_mutex_lock(&_lock);
+
+    _dropUnsubmitted(error);
+
+    // The link must be read first, the task is reused once it completes.
+    uint32_t index = _overflowIndex;
+    IoTask* task = _overflowFirst;
+
+    while (task) {
+      IoTask* next = static_cast<IoTask*>(task->_next);
+      uint32_t count = task->_requestCount;
+
+      for (uint32_t i = index; i < count; i++)
+        _failRequest(&task->_requests[i], error);
+
+      task = next;
+      index = 0;
+    }
+
+    _overflowFirst = nullptr;
+    _overflowLast = nullptr;
+    _overflowIndex = 0;
+
+    _cancelInFlight();
+    uv_mutex_unlock(&_lock);
+
+    _abandoned.store(true, std::memory_order_release);
+  }
+
+  //! Fails the ring with `error` (loop thread), see `IoRing`.
+  NJS_NOINLINE void _fail(int error) noexcept {
+    uv_mutex_lock(&_lock);
+    if (!_error.load(std::memory_order_relaxed))
+      _error.store(error, std::memory_order_relaxed);
+    uv_mutex_unlock(&_lock);
+
+    _abandon();
+  }
+
+  // Reaps all completions (reaper thread), returns the number of completions.
+  // `stop` is set if the stop request was reaped.
+  NJS_NOINLINE uint32_t _reap(bool& stop) noexcept {
+    uv_mutex_lock(&_lock);
+
+    uint32_t head = *_cqHead;
+    uint32_t tail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+    uint32_t reaped = tail - head;
+
+    while (head != tail) {
+      struct io_uring_cqe* cqe = &_cqes[head & _cqMask];
+      uint64_t userData = cqe->user_data;
+      head++;
+
+      if (userData == 0) {
+        stop = true;
+        continue;
+      }
+
+      if (userData == kCancelTag)
+        continue;
+
+      IoRequest* req = reinterpret_cast<IoRequest*>(userData);
+      IoTask* task = static_cast<IoTask*>(req->task);
+
+      req->result = static_cast<intptr_t>(cqe->res);
+      if (task->_pendingCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        _unlink(task);
+        _completion.push(task);
+      }
+    }
+
+    if (reaped) {
+      __atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+      _inFlight.fetch_sub(reaped, std::memory_order_release);
+    }
+
+    uv_mutex_unlock(&_lock);
+    return reaped;
+  }
+
+  static NJS_NOINLINE void reaperMain(void* arg) noexcept {
+    IoRing* self = static_cast<IoRing*>(arg);
+    bool stop = false;
+
+    for (;;) {
+      int error = self->_enter(self->_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 ? errno : 0;
+      if (error == EINTR)
+        continue;
+
+      if (error) {
+        uv_mutex_lock(&self->_lock);
+        if (!self->_error.load(std::memory_order_relaxed))
+          self->_error.store(error, std::memory_order_relaxed);
+        uv_mutex_unlock(&self->_lock);
+
+        // Completions can't be waited for anymore, but the kernel still posts
+        // them. Poll until the loop abandoned the ring and nothing is in flight.
+        self->_completion.wakeUp();
+        while (!stop) {
+          if (self->_abandoned.load(std::memory_order_acquire) && self->_inFlight.load(std::memory_order_acquire) == 0)
+            break;
+
+          if (self->_reap(stop))
+            self->_completion.wakeUp();
+          else
+            uv_sleep(1);
+        }
+        break;
+      }
+
+      self->_reap(stop);
+      if (stop)
+        break;
+
+      // Always wake up the loop, even if no task finished, as there may be
+      // requests waiting for a room in the rings.
+      self->_completion.wakeUp();
+    }
+  }
+
+  // Completions made room in the rings, submit what didn't fit before. If the
+  // ring failed what wasn't submitted fails instead.
+  static NJS_NOINLINE void onDrain(void* data) noexcept {
+    IoRing* self = static_cast<IoRing*>(data);
+
+    if (self->isUsable())
+      self->_flushOverflow();
+    else
+      self->_abandon();
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  //! io_uring file descriptor or -1 if not initialized.
+  int _fd;
+
+  //! Mappings of the rings and submission entries, `MAP_FAILED` if not mapped.
+  void* _sqRing;
+  size_t _sqRingSize;
+  void* _cqRing;
+  size_t _cqRingSize;
+
+  uint32_t* _sqHead;
+  uint32_t* _sqTail;
+  uint32_t* _sqArray;
+  uint32_t _sqMask;
+  uint32_t _sqEntries;
+  struct io_uring_sqe* _sqes;
+  size_t _sqesSize;
+
+  uint32_t* _cqHead;
+  uint32_t* _cqTail;
+  uint32_t _cqMask;
+  uint32_t _cqEntries;
+  struct io_uring_cqe* _cqes;
+
+  //! Number of requests submitted to the kernel and not reaped yet.
+  std::atomic<uint32_t> _inFlight;
+
+  //! Tasks waiting for a room in the rings (loop thread).
+  IoTask* _overflowFirst;
+  IoTask* _overflowLast;
+  //! Index of the first request of `_overflowFirst` that wasn't submitted.
+  uint32_t _overflowIndex;
+
+  //! Protects `_activeFirst` and failing the ring, which the reaper does too.
+  uv_mutex_t _lock;
+  //! Tasks posted and not finished yet, linked by `IoTask::_ringNext`.
+  IoTask* _activeFirst;
+  //! `errno` the ring failed with or zero.
+  std::atomic<int> _error;
+  //! Whether the loop thread failed what wasn't submitted after `_error` was
+  //! set, see `_abandon()`.
+  std::atomic<bool> _abandoned;
+
+  //! Finished tasks, filled by the reaper and drained by the loop thread.
+  Internal::CompletionQueue _completion;
+
+  //! Thread that reaps completions.
+  uv_thread_t _reaper;
+  //! Whether `_reaper` was started and not joined yet.
+  bool _reaperRunning;
+};
+
+namespace Internal {
+  // Returns the io_uring executor of the default loop or null if io_uring is
+  // not available (old kernel, seccomp, ...). Must be called on the loop thread.
+  static NJS_NOINLINE IoRing* defaultIoRing() noexcept {
+    static IoRing* ring = nullptr;
+    static bool initialized = false;
+
+    if (!initialized) {
+      initialized = true;
+      IoRing* candidate = new (std::nothrow) IoRing();
+      if (candidate && candidate->init(uv_default_loop()))
+        ring = candidate;
+      else
+        delete candidate;
+    }
+
+    return ring;
+  }
+} // {Internal}
+#endif // NJS_IO_URING
+
+//! Posts an `IoTask` to io_uring if available and it didn't fail, otherwise to
+//! the thread-pool.
+//!
+//! The ring is bound to the default loop and lives as long as the process, so
+//! tasks posted by worker threads always use the thread-pool of their loop.
+static NJS_NOINLINE void PostIoTask(IoTask* task) {
+#if defined(NJS_IO_URING)
+  if (Internal::loopOf(task->_runtime) == uv_default_loop()) {
+    IoRing* ring = Internal::defaultIoRing();
+    if (ring && ring->isUsable()) {
+      Internal::initAsyncContext(task);
+      ring->post(task);
+      return;
+    }
+  }
+#endif // NJS_IO_URING
+
+  PostTask(task);
+}
+#endif // !_WIN32
+
 } // {njs}
 
 #endif // NJS_INTEGRATE_LIBUV_H
@@ -9,6 +9,70 @@
 
 namespace test {
 
+// ============================================================================
+// [test::SumConsumer]
+// ============================================================================
+
+SumConsumer::Stats SumConsumer::stats;
+FeedProducer* FeedProducer::current;
+
+// ============================================================================
+// [test::SumTask]
+// ============================================================================
+
+njs::TaskProfile SumTask::profile;
+
+// ============================================================================
+// [test::ModuleData]
+// ============================================================================
+
+static const char* const nameList[] = { "fontFamily", "fontSize", "lineHeight", "color" };
+
+//! Per-isolate state of the test module, each worker thread has its own.
+struct ModuleData {
+  NJS_INLINE ModuleData() noexcept
+    : strings(64) {
+    cacheRegistry.add(&testCache);
+  }
+
+  njs::CacheRegistry cacheRegistry;
+  TestCache testCache;
+  njs::StringKeyMap<int> names;
+  njs::InternCache strings;
+  njs::ThreadPool pool;
+  njs::PlatformExecutor platformExecutor;
+  njs::TimerWheel wheel;
+  njs::TimerWheel coarseWheel;
+  // Destroyed before the wheels, so active probes cancel themselves.
+  CountingTimer probes[10];
+};
+
+// ============================================================================
+// [test::Memo]
+// ============================================================================
+
+static uint32_t memoCalls;
+static uint32_t sumComputations;
+
+// ============================================================================
+// [test::Squares]
+// ============================================================================
+
+// Creates an array of squares of its indexes, only the array survives the loop.
+static njs::Value newSquares(njs::Context& ctx, uint32_t n) noexcept {
+  njs::EscapableHandleScope scope(ctx);
+
+  njs::Value array = ctx.newArray(n);
+  if (!array.isValid())
+    return array;
+
+  njs::ScopedLoop loop(ctx, 256);
+  for (uint32_t i = 0; i < n; i++, loop.next())
+    ctx.setPropertyAt(array, i, ctx.newValue(double(i) * double(i)));
+
+  return scope.escape(array);
+}
+
 // ============================================================================
 // [test::ObjectWrap]
 // ============================================================================
@@ -37,13 +101,19 @@ NJS_BIND_CLASS(ObjectWrap) {
     int a;
     NJS_CHECK(ctx.unpackValue(a));
     self->_obj.setA(a);
+    self->invalidate(0);
     return njs::Globals::kResultOk;
   }
 
-  NJS_BIND_GET(b) {
+  NJS_BIND_GET(b, kFlagEnumerable) {
     return ctx.returnValue(self->_obj.b());
   }
 
+  NJS_BIND_CACHED_GET(sum, 0) {
+    sumComputations++;
+    return ctx.returnValue(self->_obj.a() + self->_obj.b());
+  }
+
   // --------------------------------------------------------------------------
   // [Methods]
   // --------------------------------------------------------------------------
@@ -55,10 +125,16 @@ NJS_BIND_CLASS(ObjectWrap) {
     NJS_CHECK(ctx.unpackArgument(0, n));
 
     self->_obj.add(n);
+    self->invalidate(0);
+
+    if (self->hasListeners()) {
+      njs::Value event = ctx.newInternalizedString(njs::Latin1Ref("change"));
+      NJS_CHECK(self->emit(ctx, ctx.This(), event, ctx.newValue(n)));
+    }
     return ctx.returnValue(ctx.This());
   }
 
-  NJS_BIND_METHOD(equals) {
+  NJS_BIND_METHOD(equals, kFlagNoConstruct | kFlagNoSideEffect) {
     ObjectWrap* other;
 
     NJS_CHECK(ctx.verifyArgumentsLength(1));
@@ -67,6 +143,46 @@ NJS_BIND_CLASS(ObjectWrap) {
     return ctx.returnValue(self->_obj.equals(other->_obj));
   }
 
+  // --------------------------------------------------------------------------
+  // [Events]
+  // --------------------------------------------------------------------------
+
+  NJS_BIND_EVENT_EMITTER()
+
+  // --------------------------------------------------------------------------
+  // [Iterators]
+  // --------------------------------------------------------------------------
+
+  NJS_BIND_ASYNC_ITERATOR(range, RangeProducer) {
+    int end;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(1));
+    NJS_CHECK(ctx.unpackArgument(0, end));
+
+    *out = new(std::nothrow) RangeProducer(end);
+    return njs::Globals::kResultOk;
+  }
+
+  NJS_BIND_ITERATOR(values, RangeProducer) {
+    int end;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(1));
+    NJS_CHECK(ctx.unpackArgument(0, end));
+
+    *out = new(std::nothrow) RangeProducer(end);
+    return njs::Globals::kResultOk;
+  }
+
+  NJS_BIND_BATCH_ITERATOR(batchValues, RangeProducer) {
+    int end;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(1));
+    NJS_CHECK(ctx.unpackArgument(0, end));
+
+    *out = new(std::nothrow) RangeProducer(end);
+    return njs::Globals::kResultOk;
+  }
+
   // --------------------------------------------------------------------------
   // [Statics]
   // --------------------------------------------------------------------------
@@ -80,12 +196,780 @@ NJS_BIND_CLASS(ObjectWrap) {
 
     return ctx.returnValue(Object::staticMul(a, b));
   }
+
+  NJS_BIND_STATIC(staticBytes) {
+    njs::Value readableClass;
+    unsigned int total, chunkSize;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(3));
+    readableClass = ctx.argumentAt(0);
+    NJS_CHECK(ctx.unpackArgument(1, total));
+    NJS_CHECK(ctx.unpackArgument(2, chunkSize));
+
+    njs::Value stream;
+    NJS_CHECK(njs::NativeReadable<BytesProducer>::create(ctx, readableClass, new(std::nothrow) BytesProducer(total, chunkSize), stream, 4096));
+
+    return ctx.returnValue(stream);
+  }
+
+  NJS_BIND_STATIC(staticFeedStream) {
+    njs::Value stream;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(1));
+    NJS_CHECK(njs::NativeReadable<FeedProducer>::create(ctx, ctx.argumentAt(0), new(std::nothrow) FeedProducer(), stream));
+
+    return ctx.returnValue(stream);
+  }
+
+  NJS_BIND_STATIC(staticFeed) {
+    unsigned int count;
+    bool end;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(2));
+    NJS_CHECK(ctx.unpackArgument(0, count));
+    NJS_CHECK(ctx.unpackArgument(1, end));
+
+    if (FeedProducer::current)
+      FeedProducer::current->feed(count, end);
+    return njs::Globals::kResultOk;
+  }
+
+  NJS_BIND_STATIC(staticFeedPulls) {
+    return ctx.returnValue(FeedProducer::current ? uint32_t(FeedProducer::current->_pulls) : 0u);
+  }
+
+  NJS_BIND_STATIC(staticSum) {
+    njs::Value stream;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(1));
+    NJS_CHECK(njs::NativeWritable<SumConsumer>::create(ctx, ctx.argumentAt(0), new(std::nothrow) SumConsumer(), stream));
+
+    return ctx.returnValue(stream);
+  }
+
+  NJS_BIND_STATIC(staticIncrement) {
+    njs::Value stream;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(1));
+    NJS_CHECK(njs::NativeTransform<IncrementTransformer>::create(ctx, ctx.argumentAt(0), new(std::nothrow) IncrementTransformer(), stream));
+
+    return ctx.returnValue(stream);
+  }
+
+  NJS_BIND_STATIC(staticFillCache) {
+    unsigned int size;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(1));
+    NJS_CHECK(ctx.unpackArgument(0, size));
+
+    ctx.moduleData<ModuleData>()->testCache._size = size;
+    return njs::Globals::kResultOk;
+  }
+
+  NJS_BIND_STATIC(staticTrimCaches) {
+    unsigned int level;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(1));
+    NJS_CHECK(ctx.unpackArgument(0, level));
+
+    if (level >= njs::kTrimLevelCount)
+      return ctx.invalidArgument(0);
+
+    njs::CacheRegistry& cacheRegistry = ctx.moduleData<ModuleData>()->cacheRegistry;
+    size_t freed = level == njs::kTrimLevelLight ? cacheRegistry.trim(level) : cacheRegistry.notifyMemoryPressure(level);
+    return ctx.returnValue(uint32_t(freed));
+  }
+
+  NJS_BIND_STATIC(staticCacheStats) {
+    const njs::CacheStats& cacheStats = ctx.moduleData<ModuleData>()->cacheRegistry.stats();
+    njs::Value stats = ctx.newArray(3);
+    NJS_CHECK(stats);
+
+    NJS_CHECK(ctx.setPropertyAt(stats, 0, ctx.newValue(double(cacheStats.trimCount[njs::kTrimLevelCritical]))));
+    NJS_CHECK(ctx.setPropertyAt(stats, 1, ctx.newValue(double(cacheStats.skippedCount))));
+    NJS_CHECK(ctx.setPropertyAt(stats, 2, ctx.newValue(double(cacheStats.bytesFreed))));
+
+    return ctx.returnValue(stats);
+  }
+
+  NJS_BIND_STATIC(staticLookup) {
+    NJS_CHECK(ctx.verifyArgumentsLength(1));
+
+    int* index = ctx.moduleData<ModuleData>()->names.get(ctx, ctx.argumentAt(0));
+    return ctx.returnValue(index ? *index : -1);
+  }
+
+  NJS_BIND_STATIC_MEMO(staticMemoMul, 2, kFlagNoConstruct, kFlagDontEnum) {
+    int a, b;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(2));
+    NJS_CHECK(ctx.unpackArgument(0, a));
+    NJS_CHECK(ctx.unpackArgument(1, b));
+
+    memoCalls++;
+    return ctx.returnValue(a * b);
+  }
+
+  NJS_BIND_STATIC(staticMemoStats) {
+    const njs::MemoStats& memoStats = MemoCache_staticMemoMul().stats();
+    njs::Value stats = ctx.newArray(4);
+    NJS_CHECK(stats);
+
+    NJS_CHECK(ctx.setPropertyAt(stats, 0, ctx.newValue(memoCalls)));
+    NJS_CHECK(ctx.setPropertyAt(stats, 1, ctx.newValue(double(memoStats.hits))));
+    NJS_CHECK(ctx.setPropertyAt(stats, 2, ctx.newValue(double(memoStats.misses))));
+    NJS_CHECK(ctx.setPropertyAt(stats, 3, ctx.newValue(double(memoStats.evictions))));
+
+    return ctx.returnValue(stats);
+  }
+
+  NJS_BIND_STATIC(staticMemoInvalidate) {
+    MemoCache_staticMemoMul().invalidate();
+    return njs::Globals::kResultOk;
+  }
+
+  NJS_BIND_STATIC(staticSquares) {
+    unsigned int n;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(1));
+    NJS_CHECK(ctx.unpackArgument(0, n));
+
+    njs::Value squares = newSquares(ctx, n);
+    NJS_CHECK(squares);
+
+    return ctx.returnValue(squares);
+  }
+
+  // Returns strings of multiples of 1000 below `n` (at most 16), which are
+  // escaped from a loop that creates a string per iteration.
+  NJS_BIND_STATIC(staticEscapeMultiples) {
+    unsigned int n;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(1));
+    NJS_CHECK(ctx.unpackArgument(0, n));
+
+    njs::Value kept[16];
+    uint32_t count = 0;
+
+    {
+      njs::ScopedLoop loop(ctx, 64);
+      for (uint32_t i = 0; i < n; i++, loop.next()) {
+        char buffer[16];
+        snprintf(buffer, sizeof(buffer), "%u", i);
+
+        njs::Value str = ctx.newString(njs::Latin1Ref(buffer));
+        if (i % 1000 == 0 && count < 16)
+          kept[count++] = loop.escape(str);
+      }
+    }
+
+    njs::Value result = ctx.newArray(count);
+    NJS_CHECK(result);
+
+    for (uint32_t i = 0; i < count; i++)
+      NJS_CHECK(ctx.setPropertyAt(result, i, kept[i]));
+    return ctx.returnValue(result);
+  }
+
+  // Calls `callback(item, index)` for all items of `array`, returns the number
+  // of `true` results and the number of calls.
+  NJS_BIND_STATIC(staticVisit) {
+    NJS_CHECK(ctx.verifyArgumentsLength(2));
+
+    njs::Value array = ctx.argumentAt(0);
+    njs::Value callback = ctx.argumentAt(1);
+
+    if (!array.isArray())
+      return ctx.invalidArgument(0);
+
+    if (!callback.isFunction())
+      return ctx.invalidArgument(1);
+
+    uint32_t n = uint32_t(ctx.arrayLength(array));
+    uint32_t matches = 0;
+    uint64_t calls;
+
+    {
+      njs::CallSite<2> site(ctx, callback, ctx.undefined(), 256);
+      for (uint32_t i = 0; i < n; i++, site.next()) {
+        njs::Value result = site.call(ctx.propertyAt(array, i), ctx.newValue(i));
+        if (!result.isValid())
+          return site.rethrow();
+
+        if (result.isTrue())
+          matches++;
+      }
+      calls = site.callCount();
+    }
+
+    njs::Value stats = ctx.newArray(2);
+    NJS_CHECK(stats);
+
+    NJS_CHECK(ctx.setPropertyAt(stats, 0, ctx.newValue(matches)));
+    NJS_CHECK(ctx.setPropertyAt(stats, 1, ctx.newValue(double(calls))));
+
+    return ctx.returnValue(stats);
+  }
+
+  NJS_BIND_STATIC(staticPoolSum) {
+    unsigned int n;
+    int node;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(3));
+    NJS_CHECK(ctx.unpackArgument(0, n));
+    NJS_CHECK(ctx.unpackArgument(1, node));
+
+    njs::Value callback = ctx.argumentAt(2);
+    if (!callback.isFunction())
+      return ctx.invalidArgument(2);
+
+    SumTask* task = new(std::nothrow) SumTask(ctx, callback, n);
+    if (!task)
+      return njs::Globals::kResultOutOfMemory;
+
+    if (node >= 0)
+      task->setLocality(uint32_t(node));
+
+    njs::PostTask(task, &ctx.moduleData<ModuleData>()->pool);
+    return njs::Globals::kResultOk;
+  }
+
+  NJS_BIND_STATIC(staticPlatformSum) {
+    unsigned int n;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(2));
+    NJS_CHECK(ctx.unpackArgument(0, n));
+
+    njs::Value callback = ctx.argumentAt(1);
+    if (!callback.isFunction())
+      return ctx.invalidArgument(1);
+
+    njs::PlatformExecutor& executor = ctx.moduleData<ModuleData>()->platformExecutor;
+    if (!executor.isValid())
+      return njs::Globals::kResultInvalidState;
+
+    SumTask* task = new(std::nothrow) SumTask(ctx, callback, n);
+    if (!task)
+      return njs::Globals::kResultOutOfMemory;
+
+    njs::PostTask(task, &executor);
+    return njs::Globals::kResultOk;
+  }
+
+  NJS_BIND_STATIC(staticPromiseSum) {
+    unsigned int n;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(1));
+    NJS_CHECK(ctx.unpackArgument(0, n));
+
+    njs::Value resolver = ctx.newResolver();
+    NJS_CHECK(resolver);
+
+    SumTask* task = new(std::nothrow) SumTask(ctx, resolver, n);
+    if (!task)
+      return njs::Globals::kResultOutOfMemory;
+
+    njs::PostTask(task);
+    return ctx.returnValue(ctx.promiseOf(resolver));
+  }
+
+  NJS_BIND_STATIC(staticSnapshotSum) {
+    NJS_CHECK(ctx.verifyArgumentsLength(2));
+
+    njs::Value resolver = ctx.newResolver();
+    NJS_CHECK(resolver);
+
+    SnapshotTask* task = new(std::nothrow) SnapshotTask(ctx, resolver);
+    if (!task)
+      return njs::Globals::kResultOutOfMemory;
+
+    njs::Result result = task->capture(ctx);
+    if (result != njs::Globals::kResultOk) {
+      delete task;
+      return result;
+    }
+
+    njs::PostTask(task);
+    return ctx.returnValue(ctx.promiseOf(resolver));
+  }
+
+  NJS_BIND_STATIC(staticAdaptiveSum) {
+    unsigned int n;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(2));
+    NJS_CHECK(ctx.unpackArgument(0, n));
+
+    njs::Value callback = ctx.argumentAt(1);
+    if (!callback.isFunction())
+      return ctx.invalidArgument(1);
+
+    SumTask* task = new(std::nothrow) SumTask(ctx, callback, n);
+    if (!task)
+      return njs::Globals::kResultOutOfMemory;
+
+    task->setProfile(&SumTask::profile, n);
+    njs::PostTask(task);
+    return njs::Globals::kResultOk;
+  }
+
+  NJS_BIND_STATIC(staticProfileStats) {
+    njs::Value stats = ctx.newArray(3);
+    NJS_CHECK(stats);
+
+    NJS_CHECK(ctx.setPropertyAt(stats, 0, ctx.newValue(double(SumTask::profile.inlineCount.load()))));
+    NJS_CHECK(ctx.setPropertyAt(stats, 1, ctx.newValue(SumTask::profile.samples.load())));
+    NJS_CHECK(ctx.setPropertyAt(stats, 2, ctx.newValue(double(SumTask::profile.probeCount.load()))));
+
+    return ctx.returnValue(stats);
+  }
+
+  // Pretends the executor's overhead is `ns`, as if it dropped afterwards.
+  NJS_BIND_STATIC(staticProfileSetOverhead) {
+    double ns;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(1));
+    NJS_CHECK(ctx.unpackArgument(0, ns));
+
+    SumTask::profile.overhead.store(uint64_t(ns));
+    SumTask::profile.workPerUnit.store(0);
+    if (SumTask::profile.samples.load() < njs::TaskProfile::kMinSamples)
+      SumTask::profile.samples.store(njs::TaskProfile::kMinSamples);
+    return njs::Globals::kResultOk;
+  }
+
+  // Reads `size` bytes of `fd` at `offset` by a `FileIoTask` posted by
+  // `PostIoTask()`, or by `PostTask()` if `viaPool` is true.
+  NJS_BIND_STATIC(staticIoRead) {
+    int fd;
+    uint32_t size;
+    double offset;
+    bool viaPool;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(5));
+    NJS_CHECK(ctx.unpackArgument(0, fd));
+    NJS_CHECK(ctx.unpackArgument(1, size));
+    NJS_CHECK(ctx.unpackArgument(2, offset));
+    NJS_CHECK(ctx.unpackArgument(3, viaPool));
+
+    njs::Value callback = ctx.argumentAt(4);
+    if (!callback.isFunction())
+      return ctx.invalidArgument(4);
+
+    if (size > FileIoTask::kMaxSize)
+      return ctx.invalidArgument(1);
+
+    FileIoTask* task = new(std::nothrow) FileIoTask(ctx, callback);
+    if (!task)
+      return njs::Globals::kResultOutOfMemory;
+
+    task->read(fd, task->_buffer, size, uint64_t(offset));
+    if (viaPool)
+      njs::PostTask(task);
+    else
+      njs::PostIoTask(task);
+    return njs::Globals::kResultOk;
+  }
+
+  // Writes the LATIN-1 string `data` to `fd` at `offset`, see `staticIoRead`.
+  NJS_BIND_STATIC(staticIoWrite) {
+    int fd;
+    double offset;
+    bool viaPool;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(5));
+    NJS_CHECK(ctx.unpackArgument(0, fd));
+    NJS_CHECK(ctx.unpackArgument(2, offset));
+    NJS_CHECK(ctx.unpackArgument(3, viaPool));
+
+    njs::Value data = ctx.argumentAt(1);
+    if (!data.isString() || ctx.stringLength(data) > FileIoTask::kMaxSize)
+      return ctx.invalidArgument(1);
+
+    njs::Value callback = ctx.argumentAt(4);
+    if (!callback.isFunction())
+      return ctx.invalidArgument(4);
+
+    FileIoTask* task = new(std::nothrow) FileIoTask(ctx, callback);
+    if (!task)
+      return njs::Globals::kResultOutOfMemory;
+
+    int size = ctx.readLatin1(data, task->_buffer, FileIoTask::kMaxSize);
+    task->write(fd, task->_buffer, size_t(size), uint64_t(offset));
+    if (viaPool)
+      njs::PostTask(task);
+    else
+      njs::PostIoTask(task);
+    return njs::Globals::kResultOk;
+  }
+
+  // Returns whether `PostIoTask()` submits tasks to io_uring.
+  NJS_BIND_STATIC(staticIoRingUsed) {
+#if defined(NJS_IO_URING)
+    njs::IoRing* ring = njs::Internal::defaultIoRing();
+    return ctx.returnValue(ctx.newValue(ring != nullptr && ring->isUsable()));
+#else
+    return ctx.returnValue(ctx.newValue(false));
+#endif
+  }
+
+  // Fails the default ring with `error` as if the kernel reported it, returns
+  // whether there was a ring to fail.
+  NJS_BIND_STATIC(staticIoRingFail) {
+    int error;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(1));
+    NJS_CHECK(ctx.unpackArgument(0, error));
+
+#if defined(NJS_IO_URING)
+    njs::IoRing* ring = njs::Internal::defaultIoRing();
+    if (ring && ring->isUsable()) {
+      ring->_fail(error);
+      return ctx.returnValue(ctx.newValue(true));
+    }
+#endif
+    return ctx.returnValue(ctx.newValue(false));
+  }
+
+  // Returns [readFd, writeFd] of a new pipe.
+  NJS_BIND_STATIC(staticIoPipe) {
+    int fds[2];
+    if (::pipe(fds) != 0)
+      return njs::Globals::kResultInvalidState;
+
+    njs::Value result = ctx.newArray(2);
+    NJS_CHECK(result);
+
+    NJS_CHECK(ctx.setPropertyAt(result, 0, ctx.newValue(fds[0])));
+    NJS_CHECK(ctx.setPropertyAt(result, 1, ctx.newValue(fds[1])));
+    return ctx.returnValue(result);
+  }
+
+  // Initializes and destroys a separate ring, returns whether the init succeeded.
+  NJS_BIND_STATIC(staticIoRingCycle) {
+#if defined(NJS_IO_URING)
+    njs::IoRing* ring = new(std::nothrow) njs::IoRing();
+    if (!ring)
+      return njs::Globals::kResultOutOfMemory;
+
+    bool ok = ring->init(njs::Internal::loopOf(ctx.runtime()));
+    delete ring;
+    return ctx.returnValue(ctx.newValue(ok));
+#else
+    return ctx.returnValue(ctx.newValue(false));
+#endif
+  }
+
+  NJS_BIND_STATIC(staticPoolStats) {
+    const njs::ThreadPool& pool = ctx.moduleData<ModuleData>()->pool;
+    njs::Value stats = ctx.newArray(3);
+    NJS_CHECK(stats);
+
+    NJS_CHECK(ctx.setPropertyAt(stats, 0, ctx.newValue(pool.threadCount())));
+    NJS_CHECK(ctx.setPropertyAt(stats, 1, ctx.newValue(pool.nodeCount())));
+    NJS_CHECK(ctx.setPropertyAt(stats, 2, ctx.newValue(double(pool.stealCount()))));
+
+    return ctx.returnValue(stats);
+  }
+
+  // Returns `nameList[index]`, by address if `byContent` is false, otherwise
+  // by the content of a copy.
+  NJS_BIND_STATIC(staticNameOf) {
+    uint32_t index;
+    bool byContent;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(2));
+    NJS_CHECK(ctx.unpackArgument(0, index));
+    NJS_CHECK(ctx.unpackArgument(1, byContent));
+
+    if (index >= sizeof(nameList) / sizeof(nameList[0]))
+      return ctx.invalidArgument(0);
+
+    njs::InternCache& strings = ctx.moduleData<ModuleData>()->strings;
+    if (!byContent)
+      return ctx.returnValue(strings.getStatic(ctx, njs::Latin1Ref(nameList[index])));
+
+    char copy[32];
+    snprintf(copy, sizeof(copy), "%s", nameList[index]);
+    return ctx.returnValue(strings.get(ctx, njs::Latin1Ref(copy)));
+  }
+
+  // Unpacks `[{ x, y }, ...]` into columns, returns [sum of x, sum of y].
+  NJS_BIND_STATIC(staticSumPoints) {
+    NJS_CHECK(ctx.verifyArgumentsLength(1));
+
+    njs::Value array = ctx.argumentAt(0);
+    uint32_t count = array.isArray() ? uint32_t(ctx.arrayLength(array)) : uint32_t(0);
+
+    double* xs = new(std::nothrow) double[count + 1];
+    int32_t* ys = new(std::nothrow) int32_t[count + 1];
+
+    njs::Result result = njs::Globals::kResultOutOfMemory;
+    if (xs && ys) {
+      njs::ColumnField fields[] = {
+        njs::ColumnField::ofDouble("x", xs),
+        njs::ColumnField::ofInt32("y", ys)
+      };
+      result = njs::unpackColumns(ctx, array, fields, 2, count);
+    }
+
+    double sumX = 0.0;
+    double sumY = 0.0;
+
+    if (result == njs::Globals::kResultOk) {
+      for (uint32_t i = 0; i < count; i++) {
+        sumX += xs[i];
+        sumY += ys[i];
+      }
+    }
+
+    delete[] xs;
+    delete[] ys;
+    NJS_CHECK(result);
+
+    njs::Value sums = ctx.newArray(2);
+    NJS_CHECK(sums);
+
+    NJS_CHECK(ctx.setPropertyAt(sums, 0, ctx.newValue(sumX)));
+    NJS_CHECK(ctx.setPropertyAt(sums, 1, ctx.newValue(sumY)));
+    return ctx.returnValue(sums);
+  }
+
+  // Unpacks `array` into more than `kMaxColumnFields` columns, which must fail.
+  NJS_BIND_STATIC(staticUnpackTooManyColumns) {
+    NJS_CHECK(ctx.verifyArgumentsLength(1));
+
+    double xs[1];
+    njs::ColumnField fields[njs::kMaxColumnFields + 1];
+
+    for (uint32_t i = 0; i <= njs::kMaxColumnFields; i++)
+      fields[i] = njs::ColumnField::ofDouble("x", xs);
+
+    NJS_CHECK(njs::unpackColumns(ctx, ctx.argumentAt(0), fields, njs::kMaxColumnFields + 1, 1));
+    return ctx.returnValue(ctx.newValue(xs[0]));
+  }
+
+  // Captures the first argument into more than `kMaxFields` fields of a
+  // snapshot, which must fail.
+  NJS_BIND_STATIC(staticCaptureTooManyFields) {
+    NJS_CHECK(ctx.verifyArgumentsLength(1));
+
+    njs::SnapshotField fields[njs::TaskSnapshot::kMaxFields + 1];
+    for (uint32_t i = 0; i <= njs::TaskSnapshot::kMaxFields; i++)
+      fields[i] = njs::SnapshotField::argument(0, njs::SnapshotField::kTypeNumber);
+
+    njs::TaskSnapshot snapshot;
+    NJS_CHECK(snapshot.capture(ctx, fields, njs::TaskSnapshot::kMaxFields + 1));
+    return ctx.returnValue(ctx.newValue(snapshot.numberAt(0)));
+  }
+
+  NJS_BIND_STATIC(staticSumComputations) {
+    return ctx.returnValue(sumComputations);
+  }
+
+  NJS_BIND_STATIC(staticSetLazyErrors) {
+    bool enabled;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(1));
+    NJS_CHECK(ctx.unpackArgument(0, enabled));
+
+    ctx.setLazyErrors(enabled);
+    return njs::Globals::kResultOk;
+  }
+
+  // Throws a lazy error in a new context and returns `[error, TypeError]`,
+  // where `TypeError` is the constructor of the new context.
+  NJS_BIND_STATIC(staticLazyErrorRealm) {
+    // TODO: This depends on V8.
+    v8::Isolate* isolate = ctx.v8Isolate();
+    v8::Local<v8::Context> context = v8::Context::New(isolate);
+    v8::Context::Scope contextScope(context);
+
+    njs::Context realm(isolate, context);
+    njs::Value error;
+    {
+      v8::TryCatch tryCatch(isolate);
+      njs::ResultPayload payload;
+      payload.any.first = 0;
+      payload.any.second = 0;
+
+      if (!njs::Internal::throwLazyError(realm, njs::Globals::kResultInvalidValue, payload))
+        return njs::Globals::kResultInvalidState;
+      error = njs::Value(tryCatch.Exception());
+    }
+
+    njs::Value result = realm.newArray(2);
+    NJS_CHECK(result);
+
+    NJS_CHECK(realm.setPropertyAt(result, 0, error));
+    NJS_CHECK(realm.setPropertyAt(result, 1, realm.propertyOf(njs::Value(context->Global()), njs::Latin1Ref("TypeError"))));
+
+    return ctx.returnValue(result);
+  }
+
+  // Creates a batched iterator in a new context and returns `[record, Object]`,
+  // where `record` is its first record and `Object` the new context's one.
+  NJS_BIND_STATIC(staticBatchIteratorRealm) {
+    // TODO: This depends on V8.
+    v8::Isolate* isolate = ctx.v8Isolate();
+    v8::Local<v8::Context> context = v8::Context::New(isolate);
+    v8::Context::Scope contextScope(context);
+
+    njs::Context realm(isolate, context);
+    njs::Value iterator;
+    NJS_CHECK(njs::Iterator<RangeProducer>::create(realm, njs::Value(), new(std::nothrow) RangeProducer(1), iterator, 16));
+
+    njs::Value next = realm.propertyOf(iterator, njs::Latin1Ref("next"));
+    NJS_CHECK(next);
+
+    njs::Value result = realm.newArray(2);
+    NJS_CHECK(result);
+
+    NJS_CHECK(realm.setPropertyAt(result, 0, realm.call(next, iterator)));
+    NJS_CHECK(realm.setPropertyAt(result, 1, realm.propertyOf(njs::Value(context->Global()), njs::Latin1Ref("Object"))));
+
+    return ctx.returnValue(result);
+  }
+
+  NJS_BIND_STATIC(staticDestroyedCount) {
+    return ctx.returnValue(objectWrapDestroyed);
+  }
+
+  NJS_BIND_STATIC(staticInternStats) {
+    const njs::InternStats& stats = ctx.moduleData<ModuleData>()->strings.stats();
+    njs::Value result = ctx.newArray(2);
+    NJS_CHECK(result);
+
+    NJS_CHECK(ctx.setPropertyAt(result, 0, ctx.newValue(double(stats.hits))));
+    NJS_CHECK(ctx.setPropertyAt(result, 1, ctx.newValue(double(stats.misses))));
+
+    return ctx.returnValue(result);
+  }
+
+  NJS_BIND_STATIC(staticWheelTimeout) {
+    unsigned int timeout;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(2));
+    NJS_CHECK(ctx.unpackArgument(0, timeout));
+
+    njs::Value callback = ctx.argumentAt(1);
+    if (!callback.isFunction())
+      return ctx.invalidArgument(1);
+
+    njs::TimerWheel& wheel = ctx.moduleData<ModuleData>()->wheel;
+    if (!wheel.isInitialized())
+      return njs::Globals::kResultInvalidState;
+
+    njs::CallbackTimer* timer = new(std::nothrow) njs::CallbackTimer(ctx, callback);
+    if (!timer)
+      return njs::Globals::kResultOutOfMemory;
+
+    wheel.start(timer, timeout);
+    return njs::Globals::kResultOk;
+  }
+
+  NJS_BIND_STATIC(staticWheelStats) {
+    ModuleData* data = ctx.moduleData<ModuleData>();
+    njs::Value stats = ctx.newArray(3);
+    NJS_CHECK(stats);
+
+    NJS_CHECK(ctx.setPropertyAt(stats, 0, ctx.newValue(double(data->wheel.activeCount()))));
+    NJS_CHECK(ctx.setPropertyAt(stats, 1, ctx.newValue(double(data->wheel.firedCount()))));
+    NJS_CHECK(ctx.setPropertyAt(stats, 2, ctx.newValue(double(data->coarseWheel.activeCount()))));
+
+    return ctx.returnValue(stats);
+  }
+
+  NJS_BIND_STATIC(staticProbeStart) {
+    unsigned int index;
+    unsigned int timeout;
+    bool coarse;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(3));
+    NJS_CHECK(ctx.unpackArgument(0, index));
+    NJS_CHECK(ctx.unpackArgument(1, timeout));
+    NJS_CHECK(ctx.unpackArgument(2, coarse));
+
+    ModuleData* data = ctx.moduleData<ModuleData>();
+    if (index >= sizeof(data->probes) / sizeof(data->probes[0]))
+      return ctx.invalidArgument(0);
+
+    njs::TimerWheel& wheel = coarse ? data->coarseWheel : data->wheel;
+    wheel.start(&data->probes[index], timeout);
+    return njs::Globals::kResultOk;
+  }
+
+  NJS_BIND_STATIC(staticProbeCancel) {
+    unsigned int index;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(1));
+    NJS_CHECK(ctx.unpackArgument(0, index));
+
+    ModuleData* data = ctx.moduleData<ModuleData>();
+    if (index >= sizeof(data->probes) / sizeof(data->probes[0]))
+      return ctx.invalidArgument(0);
+
+    CountingTimer& probe = data->probes[index];
+    if (probe.isActive())
+      probe.wheel()->cancel(&probe);
+    return njs::Globals::kResultOk;
+  }
+
+  // Returns `[active, fireCount, expiry]` of the probe at `index`.
+  NJS_BIND_STATIC(staticProbeState) {
+    unsigned int index;
+
+    NJS_CHECK(ctx.verifyArgumentsLength(1));
+    NJS_CHECK(ctx.unpackArgument(0, index));
+
+    ModuleData* data = ctx.moduleData<ModuleData>();
+    if (index >= sizeof(data->probes) / sizeof(data->probes[0]))
+      return ctx.invalidArgument(0);
+
+    const CountingTimer& probe = data->probes[index];
+    njs::Value state = ctx.newArray(3);
+    NJS_CHECK(state);
+
+    NJS_CHECK(ctx.setPropertyAt(state, 0, ctx.newValue(probe.isActive())));
+    NJS_CHECK(ctx.setPropertyAt(state, 1, ctx.newValue(probe.fireCount)));
+    NJS_CHECK(ctx.setPropertyAt(state, 2, ctx.newValue(double(probe._expiry))));
+
+    return ctx.returnValue(state);
+  }
+
+  NJS_BIND_STATIC(staticSumStats) {
+    njs::Value stats = ctx.newArray(3);
+    NJS_CHECK(stats);
+
+    NJS_CHECK(ctx.setPropertyAt(stats, 0, ctx.newValue(SumConsumer::stats.bytes)));
+    NJS_CHECK(ctx.setPropertyAt(stats, 1, ctx.newValue(SumConsumer::stats.sum)));
+    NJS_CHECK(ctx.setPropertyAt(stats, 2, ctx.newValue(SumConsumer::stats.batches)));
+
+    return ctx.returnValue(stats);
+  }
 };
 
 NJS_MODULE(test) {
   // TODO: This depends on V8.
   typedef v8::Local<v8::FunctionTemplate> FunctionSpec;
   FunctionSpec ObjectSpec = NJS_INIT_CLASS(ObjectWrap, exports);
+
+  // Only the first load of the module in this isolate creates its data.
+  if (ctx.newModuleData<ModuleData>() != njs::Globals::kResultOk)
+    return;
+
+  ModuleData* data = ctx.moduleData<ModuleData>();
+  data->cacheRegistry.install(ctx.runtime());
+
+  njs::ThreadPoolOptions poolOptions;
+  poolOptions.threadCount = 2;
+  poolOptions.flags = njs::ThreadPoolOptions::kFlagNumaAware | njs::ThreadPoolOptions::kFlagPinToNode;
+  data->pool.init(ctx.runtime(), poolOptions);
+  data->platformExecutor.init(ctx);
+  data->wheel.init(ctx.runtime(), 1, 4);
+  data->coarseWheel.init(ctx.runtime(), 10, 100);
+
+  for (int i = 0; i < int(sizeof(nameList) / sizeof(nameList[0])); i++)
+    data->names.insert(ctx, ctx.newInternalizedString(njs::Latin1Ref(nameList[i])), i);
 }
 
 } // test namespace
@@ -10,26 +10,37 @@ function log(text) {
   console.log("  [JS~] " + text);
 }
 
+const tests = [];
+
 function test(description, fn) {
-  console.log(`${description}:`);
+  tests.push({ description, fn });
+}
 
-  var complete = false;
-  function done() {
-    complete = true;
-    console.log("");
-  }
+// Tests run sequentially, a test can be async (returning a promise), but it
+// must call `done()` before it finishes.
+async function runTests() {
+  for (const { description, fn } of tests) {
+    console.log(`${description}:`);
 
-  try {
-    fn(done);
-  }
-  catch (ex) {
-    log(`FAILURE: ${description}: ${ex.toString()}`);
-    throw ex;
-  }
+    var complete = false;
+    function done() {
+      complete = true;
+      console.log("");
+    }
 
-  if (complete === false) {
-    // TODO: Async testing.
+    try {
+      await fn(done);
+    }
+    catch (ex) {
+      log(`FAILURE: ${description}: ${ex.toString()}`);
+      throw ex;
+    }
+
+    if (complete === false)
+      throw new TypeError(`[JS] FAILURE: ${description}: done() not called`);
   }
+
+  console.log("All tests passed!");
 }
 
 function assertEqual(a, b) {
@@ -129,4 +140,895 @@ test("Basic security (incompatible signature)", function(done) {
   done();
 });
 
-console.log("All tests passed!");
+// ============================================================================
+// [Async Iterator - Iterate 'native.Object.range()' by using 'for await']
+// ============================================================================
+
+test("Async iterator", async function(done) {
+  var inst = new native.Object(1, 2);
+
+  var values = [];
+  for await (var value of inst.range(1000))
+    values.push(value);
+
+  assertEqual(values.length, 1000);
+  for (var i = 0; i < values.length; i++)
+    assertEqual(values[i], i);
+
+  // Breaking out of the loop must stop the producer.
+  values = [];
+  for await (var value of inst.range(1000)) {
+    if (value === 10)
+      break;
+    values.push(value);
+  }
+  assertEqual(values.length, 10);
+
+  // Multiple `next()` calls waiting at the same time.
+  var it = inst.range(3);
+  var records = await Promise.all([it.next(), it.next(), it.next(), it.next()]);
+  assertEqual(records.map((r) => r.value).join(","), "0,1,2,");
+  assertEqual(records.map((r) => r.done).join(","), "false,false,false,true");
+
+  // A failure of the producer is described by its payload.
+  var message = "";
+  try {
+    for await (var value of inst.range(-1)) {}
+  } catch (ex) {
+    message = ex.message;
+  }
+  assertEqual(message.indexOf("Range end must not be negative") !== -1, true);
+
+  done();
+});
+
+test("Lazy errors", function(done) {
+  native.Object.staticSetLazyErrors(true);
+
+  try {
+    var error = null;
+    try { new native.Object(1); } catch (ex) { error = ex; }
+
+    assertEqual(error instanceof TypeError, true);
+    assertEqual(error.code, "ERR_NJS_INVALID_ARGUMENTS_LENGTH");
+    assertEqual(Object.getOwnPropertyNames(error).indexOf("message"), -1);
+    assertEqual(error.message, "Invalid number of arguments: Required exactly 2");
+    assertEqual(String(error), "TypeError: Invalid number of arguments: Required exactly 2");
+
+    error = null;
+    try { native.Object.staticNameOf(0, 0); } catch (ex) { error = ex; }
+    assertEqual(error instanceof TypeError, true);
+    assertEqual(error.code, "ERR_NJS_INVALID_VALUE");
+    assertEqual(error.message, "Invalid value");
+
+    // The message can be replaced before it was formatted (strict mode).
+    error = null;
+    try { native.Object.staticNameOf(0, 0); } catch (ex) { error = ex; }
+    error.message = "Replaced";
+    assertEqual(error.message, "Replaced");
+    assertEqual(String(error), "TypeError: Replaced");
+
+    error = null;
+    try { native.Object.staticNameOf(0, 0); } catch (ex) { error = ex; }
+    error.message = "context: " + error.message;
+    assertEqual(error.message, "context: Invalid value");
+
+    // Errors thrown in another context inherit from its built-in errors.
+    var realm = native.Object.staticLazyErrorRealm();
+    assertEqual(realm[0] instanceof realm[1], true);
+    assertEqual(realm[0] instanceof TypeError, false);
+    assertEqual(realm[0].code, "ERR_NJS_INVALID_VALUE");
+  }
+  finally {
+    native.Object.staticSetLazyErrors(false);
+  }
+
+  done();
+});
+
+test("Intern cache", function(done) {
+  var before = native.Object.staticInternStats();
+
+  for (var i = 0; i < 100; i++) {
+    assertEqual(native.Object.staticNameOf(i & 3, false), ["fontFamily", "fontSize", "lineHeight", "color"][i & 3]);
+    assertEqual(native.Object.staticNameOf(i & 3, true), native.Object.staticNameOf(i & 3, false));
+  }
+
+  // 4 names by address and 4 by content, everything else hits.
+  var after = native.Object.staticInternStats();
+  assertEqual(after[1] - before[1], 8);
+  assertEqual(after[0] - before[0], 300 - 8);
+
+  done();
+});
+
+test("Task snapshot", async function(done) {
+  var bytes = Buffer.from([1, 2, 3, 250]);
+  var options = { values: [1, 2, 3.5], scale: 2, label: "sum \u00e9" };
+
+  var promise = native.Object.staticSnapshotSum(bytes, options);
+
+  // Changes made after the call don't affect the task.
+  options.values.push(1000);
+  options.label = "changed";
+
+  assertEqual(await promise, "sum \u00e9:269");
+
+  options.negate = true;
+  assertEqual(await native.Object.staticSnapshotSum(Buffer.alloc(0), options), "changed:-2013");
+
+  options.scale = "2";
+  assertThrow(function() { native.Object.staticSnapshotSum(bytes, options); });
+  assertThrow(function() { native.Object.staticSnapshotSum([1, 2], { values: [], scale: 1, label: "" }); });
+
+  // Too many fields are reported instead of overflowing the item storage.
+  assertThrow(function() { native.Object.staticCaptureTooManyFields(1); });
+
+  done();
+});
+
+test("Timer wheel", async function(done) {
+  var order = [];
+  var fired = native.Object.staticWheelStats()[1];
+  var far;
+
+  await new Promise(function(resolve) {
+    native.Object.staticWheelTimeout(40, function() { order.push("late"); resolve(); });
+    native.Object.staticWheelTimeout(10, function() {
+      order.push("a");
+      // Runs after all timers that expired in the same tick.
+      process.nextTick(function() { order.push("tick"); });
+    });
+    native.Object.staticWheelTimeout(10, function() { order.push("b"); });
+    // Placed to an upper level of the wheel and moved down later.
+    far = new Promise(function(resolveFar) {
+      native.Object.staticWheelTimeout(300, function() { order.push("far"); resolveFar(); });
+    });
+    assertEqual(native.Object.staticWheelStats()[0], 4);
+  });
+
+  assertEqual(order.join(","), "a,b,tick,late");
+  assertEqual(native.Object.staticWheelStats()[0], 1);
+  assertEqual(native.Object.staticWheelStats()[1] - fired, 3);
+
+  await far;
+  assertEqual(order.join(","), "a,b,tick,late,far");
+  assertEqual(native.Object.staticWheelStats()[0], 0);
+
+  function probe(index) { return native.Object.staticProbeState(index); }
+  async function until(condition) {
+    while (!condition())
+      await new Promise(function(resolve) { setTimeout(resolve, 5); });
+  }
+
+  // Canceled timers never fire, restarted timers fire once at the new time.
+  native.Object.staticProbeStart(0, 20, false);
+  native.Object.staticProbeStart(1, 20, false);
+  native.Object.staticProbeStart(2, 30, false);
+  native.Object.staticProbeCancel(0);
+  native.Object.staticProbeCancel(0);
+  native.Object.staticProbeStart(1, 5000, false);
+  native.Object.staticProbeStart(1, 400, false);
+  assertEqual(native.Object.staticWheelStats()[0], 2);
+  assertEqual(probe(0)[0], false);
+
+  await until(function() { return probe(2)[1] === 1; });
+  assertEqual(probe(0)[1], 0);
+  assertEqual(probe(1)[0], true);
+  assertEqual(probe(1)[1], 0);
+
+  await until(function() { return probe(1)[1] === 1; });
+  assertEqual(probe(0)[1], 0);
+  assertEqual(native.Object.staticWheelStats()[0], 0);
+
+  // Restarting a timer in another wheel removes it from the first one.
+  native.Object.staticProbeStart(3, 1000, false);
+  native.Object.staticProbeStart(3, 10, true);
+  assertEqual(native.Object.staticWheelStats()[0], 0);
+  assertEqual(native.Object.staticWheelStats()[2], 1);
+  await until(function() { return probe(3)[1] === 1; });
+  assertEqual(native.Object.staticWheelStats()[2], 0);
+
+  // The coarse wheel has 10ms ticks and 100ms slack, expiry ticks are rounded
+  // up to a multiple of 10, so timers 10ms apart fire in at most two batches.
+  var expiries = {};
+  for (var i = 4; i < 9; i++) {
+    native.Object.staticProbeStart(i, (i - 3) * 10, true);
+    assertEqual(probe(i)[2] % 10, 0);
+    expiries[probe(i)[2]] = true;
+  }
+  assertEqual(Object.keys(expiries).length <= 2, true);
+  await until(function() { return native.Object.staticWheelStats()[2] === 0; });
+  for (var i = 4; i < 9; i++)
+    assertEqual(probe(i)[1], 1);
+
+  done();
+});
+
+test("Columns", function(done) {
+  var points = [];
+  for (var i = 0; i < 5000; i++)
+    points.push(i & 1 ? { x: i * 0.5, y: i } : { y: i, x: i * 0.5, z: 0 });
+
+  var sums = native.Object.staticSumPoints(points);
+  assertEqual(sums[0], 4999 * 5000 / 4);
+  assertEqual(sums[1], 4999 * 5000 / 2);
+
+  assertEqual(native.Object.staticSumPoints([]).length, 2);
+
+  points[2] = { x: 1, y: "2" };
+  assertThrow(function() { native.Object.staticSumPoints(points); });
+  try {
+    native.Object.staticSumPoints(points);
+  }
+  catch (ex) {
+    assertEqual(ex.message, "Invalid value: [2].y");
+  }
+
+  // Too many fields are reported instead of overflowing the key storage.
+  assertThrow(function() { native.Object.staticUnpackTooManyColumns([{ x: 1 }]); });
+
+  done();
+});
+
+test("Cached getter", function(done) {
+  var inst = new native.Object(1, 2);
+  var other = new native.Object(10, 20);
+  var before = native.Object.staticSumComputations();
+
+  for (var i = 0; i < 10; i++) {
+    assertEqual(inst.sum, 3);
+    assertEqual(other.sum, 30);
+  }
+  assertEqual(native.Object.staticSumComputations() - before, 2);
+
+  // Native state changes invalidate the cached result.
+  inst.add(5);
+  assertEqual(inst.sum, 13);
+  inst.a = 0;
+  assertEqual(inst.sum, 7);
+  assertEqual(other.sum, 30);
+  assertEqual(native.Object.staticSumComputations() - before, 4);
+
+  done();
+});
+
+test("Event emitter", function(done) {
+  var inst = new native.Object(1, 2);
+  var calls = [];
+
+  function onChange(n) { calls.push("on:" + n); }
+  function onOther(n) { calls.push("other:" + n); inst.off("change", onOther); }
+
+  // No listeners, nothing is emitted.
+  inst.add(1);
+
+  inst.on("change", onChange).on("change", onOther);
+  inst.once("change", function(n) {
+    assertEqual(this, inst);
+    calls.push("once:" + n);
+  });
+  assertEqual(inst.listenerCount("change"), 3);
+
+  inst.add(2);
+  inst.add(3);
+  assertEqual(calls.join(","), "on:2,other:2,once:2,on:3");
+  assertEqual(inst.listenerCount("change"), 1);
+
+  // A throwing listener propagates and skips the remaining ones.
+  inst.off("change");
+  inst.on("change", function() { throw new Error("Listener failed"); });
+  inst.on("change", onChange);
+  calls = [];
+  try {
+    inst.add(4);
+    assertEqual(true, false);
+  }
+  catch (ex) {
+    assertEqual(ex.message, "Listener failed");
+  }
+  assertEqual(calls.length, 0);
+
+  inst.off("change");
+  assertEqual(inst.listenerCount("change"), 0);
+
+  done();
+});
+
+test("Event emitter listener cycles", async function(done) {
+  require("v8").setFlagsFromString("--expose-gc");
+  const gc = require("vm").runInNewContext("gc");
+  const before = native.Object.staticDestroyedCount();
+
+  // Listeners that reference their emitter don't keep it alive.
+  (function() {
+    for (var i = 0; i < 10; i++) {
+      let inst = new native.Object(1, 2);
+      inst.on("change", function() { inst.add(0); });
+      inst.once("change", function() { inst.add(0); });
+    }
+  })();
+
+  // Slots of removed listeners are reused.
+  var inst = new native.Object(1, 2);
+  var calls = [];
+  function a() { calls.push("a"); }
+  function b() { calls.push("b"); }
+  inst.on("change", a).on("change", b).off("change", a).on("change", a);
+  inst.add(1);
+  assertEqual(calls.join(","), "b,a");
+
+  for (var i = 0; i < 5; i++) {
+    gc();
+    await new Promise(function(resolve) { setImmediate(resolve); });
+  }
+  assertEqual(native.Object.staticDestroyedCount() - before >= 10, true);
+
+  done();
+});
+
+test("Iterator", function(done) {
+  var inst = new native.Object(1, 2);
+
+  ["values", "batchValues"].forEach(function(name) {
+    // Crosses batch boundaries (256 items per batch).
+    var values = [];
+    for (var value of inst[name](1000))
+      values.push(value);
+
+    assertEqual(values.length, 1000);
+    for (var i = 0; i < values.length; i++)
+      assertEqual(values[i], i);
+
+    assertEqual([...inst[name](0)].length, 0);
+    assertEqual([...inst[name](256)].length, 256);
+
+    // Breaking out of the loop ends the iteration.
+    var it = inst[name](1000);
+    for (var value of it) {
+      if (value === 10)
+        break;
+    }
+    assertEqual(it.next().done, true);
+
+    // Each `next()` returns a new record.
+    it = inst[name](3);
+    var first = it.next();
+    var second = it.next();
+    assertEqual(first !== second, true);
+    assertEqual(first.value, 0);
+    assertEqual(second.value, 1);
+  });
+
+  // Batched iterators created in another context use its built-ins.
+  [...inst.batchValues(3)];
+  var realm = native.Object.staticBatchIteratorRealm();
+  assertEqual(realm[0] instanceof realm[1], true);
+  assertEqual(realm[0] instanceof Object, false);
+  assertEqual(realm[0].value, 0);
+
+  done();
+});
+
+test("Iterator owner", async function(done) {
+  require("v8").setFlagsFromString("--expose-gc");
+  const gc = require("vm").runInNewContext("gc");
+  const before = native.Object.staticDestroyedCount();
+
+  // Owners that keep their iterators are collected together with them.
+  (function() {
+    for (var i = 0; i < 10; i++) {
+      var inst = new native.Object(1, 2);
+      inst.values = inst.values(10);
+      inst.batch = inst.batchValues(10);
+      inst.range = inst.range(10);
+    }
+  })();
+
+  // An iterator keeps its owner alive.
+  var it = new native.Object(3, 4).range(3);
+
+  for (var i = 0; i < 5; i++) {
+    gc();
+    await new Promise(function(resolve) { setImmediate(resolve); });
+  }
+  assertEqual(native.Object.staticDestroyedCount() - before >= 10, true);
+
+  var values = [];
+  for await (var value of it)
+    values.push(value);
+  assertEqual(values.join(","), "0,1,2");
+
+  done();
+});
+
+test("Scoped loop", function(done) {
+  var squares = native.Object.staticSquares(100000);
+  assertEqual(squares.length, 100000);
+  assertEqual(squares[0], 0);
+  assertEqual(squares[255], 255 * 255);
+  assertEqual(squares[256], 256 * 256);
+  assertEqual(squares[99999], 99999 * 99999);
+
+  // Values escaped from the loop survive its handle scopes.
+  assertEqual(native.Object.staticEscapeMultiples(10500).join(","),
+    "0,1000,2000,3000,4000,5000,6000,7000,8000,9000,10000");
+
+  done();
+});
+
+test("Call site", function(done) {
+  var array = [];
+  for (var i = 0; i < 10000; i++)
+    array.push(i);
+
+  var stats = native.Object.staticVisit(array, function(item, index) {
+    return item === index && (item & 1) === 0;
+  });
+  assertEqual(stats[0], 5000);
+  assertEqual(stats[1], 10000);
+
+  // The first exception aborts the loop and is propagated.
+  var calls = 0;
+  assertThrow(function() {
+    native.Object.staticVisit(array, function(item) {
+      if (++calls === 300)
+        throw new Error("Visitor failed");
+    });
+  });
+  assertEqual(calls, 300);
+
+  done();
+});
+
+test("Readable stream", async function(done) {
+  const stream = require("stream");
+  var readable = native.Object.staticBytes(stream.Readable, 100000, 3000);
+  assertEqual(readable instanceof stream.Readable, true);
+
+  var chunks = [];
+  for await (var chunk of readable)
+    chunks.push(chunk);
+
+  var data = Buffer.concat(chunks);
+  assertEqual(data.length, 100000);
+  for (var i = 0; i < data.length; i++) {
+    if (data[i] !== (i & 0xFF))
+      throw new Error(`Byte ${i} doesn't match`);
+  }
+
+  // Destroying the stream early must not push more data.
+  readable = native.Object.staticBytes(stream.Readable, 100000, 1000);
+  readable.once("data", () => readable.destroy());
+  await new Promise((resolve) => readable.on("close", resolve));
+
+  done();
+});
+
+test("Readable stream waits for its producer", async function(done) {
+  const stream = require("stream");
+  var readable = native.Object.staticFeedStream(stream.Readable);
+
+  var chunks = 0;
+  readable.on("data", () => chunks++);
+
+  // Nothing was fed, the stream must wait instead of pulling over and over.
+  await new Promise((resolve) => setTimeout(resolve, 50));
+  assertEqual(chunks, 0);
+  assertEqual(native.Object.staticFeedPulls() <= 2, true);
+
+  native.Object.staticFeed(3, false);
+  await new Promise((resolve) => setTimeout(resolve, 50));
+  assertEqual(chunks, 3);
+
+  native.Object.staticFeed(2, true);
+  await new Promise((resolve) => readable.on("end", resolve));
+  assertEqual(chunks, 5);
+
+  done();
+});
+
+test("Writable stream", async function(done) {
+  const stream = require("stream");
+  var writable = native.Object.staticSum(stream.Writable);
+  assertEqual(writable instanceof stream.Writable, true);
+
+  // Chunks written while corked must be consumed in a single batch.
+  var sum = 0;
+  writable.cork();
+  for (var i = 0; i < 100; i++) {
+    var chunk = Buffer.alloc(100, i);
+    sum += i * 100;
+    writable.write(chunk);
+  }
+  writable.uncork();
+  writable.end();
+  await new Promise((resolve) => writable.on("finish", resolve));
+
+  var stats = native.Object.staticSumStats();
+  assertEqual(stats[0], 10000);
+  assertEqual(stats[1], sum);
+  assertEqual(stats[2], 1);
+
+  done();
+});
+
+test("Transform stream", async function(done) {
+  const stream = require("stream");
+  var transform = native.Object.staticIncrement(stream.Transform);
+  assertEqual(transform instanceof stream.Transform, true);
+
+  // Chunks finish out of order, but must be pushed in order.
+  var chunks = [];
+  transform.on("data", (chunk) => chunks.push(chunk));
+
+  for (var i = 0; i < 64; i++)
+    transform.write(Buffer.alloc(10, i));
+  transform.end();
+  await new Promise((resolve) => transform.on("end", resolve));
+
+  assertEqual(chunks.length, 64);
+  for (var i = 0; i < chunks.length; i++)
+    assertEqual(chunks[i][0], i + 1);
+
+  done();
+});
+
+test("Transform back-pressure", async function(done) {
+  const stream = require("stream");
+  var transform = native.Object.staticIncrement(stream.Transform);
+
+  // Nothing reads the output, so writes must stop being acknowledged once
+  // the readable side is full instead of buffering all of it.
+  var acked = 0;
+  for (var i = 0; i < 200; i++)
+    transform.write(Buffer.alloc(1024, i), () => acked++);
+
+  await new Promise((resolve) => setTimeout(resolve, 100));
+  assertEqual(acked < 200, true);
+  assertEqual(transform.readableLength <= transform.readableHighWaterMark + 4 * 1024, true);
+
+  // Reading resumes the writes.
+  var count = 0;
+  transform.on("data", (chunk) => { assertEqual(chunk[0], (count++ + 1) & 0xFF); });
+  transform.end();
+  await new Promise((resolve) => transform.on("end", resolve));
+
+  assertEqual(count, 200);
+  assertEqual(acked, 200);
+
+  done();
+});
+
+test("Cache registry", function(done) {
+  // A light trim, which could also be done after a GC, doesn't hold back a
+  // moderate one.
+  native.Object.staticFillCache(1000);
+  native.Object.staticTrimCaches(0);
+  native.Object.staticFillCache(1000);
+  assertEqual(native.Object.staticTrimCaches(1), 1000);
+
+  var before = native.Object.staticCacheStats();
+
+  // Critical trims are never rate-limited.
+  native.Object.staticFillCache(1000);
+  assertEqual(native.Object.staticTrimCaches(2), 1000);
+  native.Object.staticFillCache(500);
+  assertEqual(native.Object.staticTrimCaches(2), 500);
+
+  // Other trims are rate-limited.
+  native.Object.staticFillCache(1000);
+  assertEqual(native.Object.staticTrimCaches(1), 0);
+
+  var after = native.Object.staticCacheStats();
+  assertEqual(after[0] - before[0], 2);
+  assertEqual(after[1] - before[1], 1);
+  assertEqual(after[2] - before[2], 1500);
+
+  done();
+});
+
+test("String key map", function(done) {
+  assertEqual(native.Object.staticLookup("fontFamily"), 0);
+  assertEqual(native.Object.staticLookup("color"), 3);
+
+  // Strings created at runtime are not internalized and compared by content.
+  var prefix = "line";
+  assertEqual(native.Object.staticLookup(prefix + "Height"), 2);
+  assertEqual(native.Object.staticLookup(["font", "Size"].join("")), 1);
+
+  assertEqual(native.Object.staticLookup("fontWeight"), -1);
+  assertEqual(native.Object.staticLookup(""), -1);
+  assertEqual(native.Object.staticLookup(42), -1);
+
+  done();
+});
+
+test("Memoized static", function(done) {
+  native.Object.staticMemoInvalidate();
+  var before = native.Object.staticMemoStats();
+
+  assertEqual(native.Object.staticMemoMul(3, 4), 12);
+  assertEqual(native.Object.staticMemoMul(3, 4), 12);
+  assertEqual(native.Object.staticMemoMul(5, 6), 30);
+  assertEqual(native.Object.staticMemoMul(3, 4), 12);
+
+  var stats = native.Object.staticMemoStats();
+  assertEqual(stats[0] - before[0], 2);
+  assertEqual(stats[1] - before[1], 2);
+  assertEqual(stats[2] - before[2], 2);
+
+  // The least recently used result (5 * 6) is evicted.
+  assertEqual(native.Object.staticMemoMul(7, 8), 56);
+  assertEqual(native.Object.staticMemoMul(3, 4), 12);
+  assertEqual(native.Object.staticMemoMul(5, 6), 30);
+  stats = native.Object.staticMemoStats();
+  assertEqual(stats[0] - before[0], 4);
+  assertEqual(stats[3] - before[3], 2);
+
+  // Errors are not cached.
+  assertThrow(function() { native.Object.staticMemoMul(3, "x"); });
+  assertThrow(function() { native.Object.staticMemoMul(3, "x"); });
+
+  native.Object.staticMemoInvalidate();
+  assertEqual(native.Object.staticMemoMul(3, 4), 12);
+  assertEqual(native.Object.staticMemoStats()[0] - before[0], 5);
+
+  // Objects with internal fields that are not wrapped by njs are not keyed.
+  var handle = require("zlib").createGzip()._handle;
+  assertThrow(function() { native.Object.staticMemoMul(handle, 1); });
+  assertThrow(function() { native.Object.staticMemoMul(new native.Object(), 1); });
+
+  done();
+});
+
+test("Binding flags", function(done) {
+  var proto = native.Object.prototype;
+
+  // Non-constructible methods have no `prototype`.
+  assertEqual(proto.equals.prototype, undefined);
+  assertThrow(function() { new proto.equals(); });
+  assertEqual(typeof proto.add.prototype, "object");
+
+  assertEqual(proto.propertyIsEnumerable("a"), false);
+  assertEqual(proto.propertyIsEnumerable("b"), true);
+  assertEqual(native.Object.propertyIsEnumerable("staticMul"), true);
+  assertEqual(native.Object.propertyIsEnumerable("staticMemoMul"), false);
+
+  done();
+});
+
+test("Thread pool", async function(done) {
+  const stats = native.Object.staticPoolStats();
+  assertEqual(stats[0], 2);
+  assertEqual(stats[1] >= 1, true);
+
+  // Locality hints of nodes that don't exist fall back to any node.
+  const sums = await Promise.all([-1, 0, 1, 7, 100].map(function(node) {
+    return new Promise(function(resolve) {
+      native.Object.staticPoolSum(1000, node, (err, sum) => resolve(sum));
+    });
+  }));
+  assertEqual(sums.join(","), "499500,499500,499500,499500,499500");
+
+  done();
+});
+
+test("Platform executor", async function(done) {
+  const sums = await Promise.all([10, 1000, 100000].map(function(n) {
+    return new Promise(function(resolve) {
+      native.Object.staticPlatformSum(n, (err, sum) => resolve(sum));
+    });
+  }));
+  assertEqual(sums.join(","), "45,499500,4999950000");
+
+  done();
+});
+
+test("Adaptive inline tasks", async function(done) {
+  // Tiny tasks run inline once the profile learned the executor's overhead,
+  // but they must still complete asynchronously.
+  for (var i = 0; i < 50; i++) {
+    var completed = false;
+    var sum = await new Promise(function(resolve) {
+      native.Object.staticAdaptiveSum(10, function(err, sum) {
+        completed = true;
+        resolve(sum);
+      });
+      assertEqual(completed, false);
+    });
+    assertEqual(sum, 45);
+  }
+
+  const stats = native.Object.staticProfileStats();
+  assertEqual(stats[0] > 0, true);
+  assertEqual(stats[1] >= 8, true);
+
+  done();
+});
+
+test("Adaptive inline probing", async function(done) {
+  // Pretend the overhead was 10ms so tasks of ~1ms go inline. Some of them are
+  // still posted, so the profile learns the real overhead and switches back.
+  native.Object.staticProfileSetOverhead(1e7);
+
+  var before = native.Object.staticProfileStats();
+  var wentInline = false;
+  var switchedBack = false;
+
+  for (var batch = 0; batch < 100 && !switchedBack; batch++) {
+    var inlineCount = native.Object.staticProfileStats()[0];
+    for (var i = 0; i < 20; i++)
+      assertEqual(await new Promise(function(resolve) {
+        native.Object.staticAdaptiveSum(1000000, function(err, sum) { resolve(sum); });
+      }), 499999500000);
+
+    var ran = native.Object.staticProfileStats()[0] - inlineCount;
+    if (ran > 0)
+      wentInline = true;
+    else if (wentInline)
+      switchedBack = true;
+  }
+
+  assertEqual(wentInline, true);
+  assertEqual(switchedBack, true);
+  assertEqual(native.Object.staticProfileStats()[2] > before[2], true);
+
+  done();
+});
+
+test("Task errors", async function(done) {
+  assertEqual(await native.Object.staticPromiseSum(100), 4950);
+
+  // Errors of `onWorkResult()` reject the promise.
+  try {
+    await native.Object.staticPromiseSum(200000000);
+    throw new Error("Not rejected");
+  }
+  catch (ex) {
+    assertEqual(ex instanceof RangeError, true);
+    assertEqual(ex.message, "Count 200000000 is greater than 100000000");
+  }
+
+  // And are passed as the first argument of callbacks.
+  const err = await new Promise(function(resolve) {
+    native.Object.staticPoolSum(0, -1, resolve);
+  });
+  assertEqual(err instanceof TypeError, true);
+  assertEqual(err.message, "Invalid argument [0]: Expected a positive count, got 0");
+
+  done();
+});
+
+test("File I/O tasks", async function(done) {
+  const fs = require("fs");
+  const os = require("os");
+  const path = require("path");
+
+  function io(name, ...args) {
+    return new Promise(function(resolve) {
+      native.Object[name](...args, (result, data) => resolve([result, data]));
+    });
+  }
+
+  log(`io_uring used: ${native.Object.staticIoRingUsed()}`);
+
+  // A ring can be destroyed, which stops its reaper and releases it.
+  assertEqual(native.Object.staticIoRingCycle(), native.Object.staticIoRingUsed());
+
+  const file = path.join(os.tmpdir(), `njs-test-${process.pid}.txt`);
+  const fd = fs.openSync(file, "w+");
+  const readOnly = fs.openSync(file, "r");
+
+  try {
+    // The ring (or the pool if io_uring is not available) and the pool.
+    for (const viaPool of [false, true]) {
+      assertEqual((await io("staticIoWrite", fd, "Hello", 0, viaPool))[0], 5);
+      assertEqual((await io("staticIoWrite", fd, "World", 10, viaPool))[0], 5);
+
+      var r = await io("staticIoRead", fd, 64, 0, viaPool);
+      assertEqual(r[0], 15);
+      assertEqual(r[1], "Hello\0\0\0\0\0World");
+
+      // Reading past the end transfers nothing.
+      assertEqual((await io("staticIoRead", fd, 8, 100, viaPool))[0], 0);
+
+      // Failures are reported as negated errno.
+      assertEqual((await io("staticIoWrite", readOnly, "x", 0, viaPool))[0], -os.constants.errno.EBADF);
+
+      // More requests than fit the rings at once.
+      var all = [];
+      for (var i = 0; i < 1000; i++)
+        all.push(io("staticIoRead", fd, 5, 10, viaPool));
+      for (const result of await Promise.all(all))
+        assertEqual(result[1], "World");
+
+      fs.ftruncateSync(fd, 0);
+    }
+
+    // A failure of the ring cancels requests in flight, which complete when
+    // the kernel reports them (not with the failure), and the following tasks
+    // use the pool. A read of an empty pipe stays in flight until the pipe is
+    // written or closed.
+    const pipe = native.Object.staticIoPipe();
+    const pending = io("staticIoRead", pipe[0], 8, 0, false);
+
+    if (native.Object.staticIoRingFail(os.constants.errno.EIO))
+      assertEqual((await pending)[0], -os.constants.errno.ECANCELED);
+    assertEqual(native.Object.staticIoRingUsed(), false);
+
+    assertEqual((await io("staticIoWrite", fd, "Pool", 0, false))[0], 4);
+    assertEqual((await io("staticIoRead", fd, 4, 0, false))[1], "Pool");
+
+    fs.closeSync(pipe[1]);
+    await pending;
+    fs.closeSync(pipe[0]);
+  }
+  finally {
+    fs.closeSync(readOnly);
+    fs.closeSync(fd);
+    fs.unlinkSync(file);
+  }
+
+  done();
+});
+
+test("Async context", async function(done) {
+  const AsyncLocalStorage = require("async_hooks").AsyncLocalStorage;
+  const storage = new AsyncLocalStorage();
+
+  function inContext(id, post) {
+    return new Promise(function(resolve) {
+      storage.run(id, function() {
+        post(function() { resolve(storage.getStore()); });
+      });
+    });
+  }
+
+  // Completions run in the async context the task was posted from.
+  const ids = await Promise.all([
+    inContext(1, (cb) => native.Object.staticPoolSum(10, -1, cb)),
+    inContext(2, (cb) => native.Object.staticPlatformSum(10, cb)),
+    inContext(3, (cb) => native.Object.staticAdaptiveSum(10, cb)),
+    inContext(4, (cb) => native.Object.staticWheelTimeout(1, cb)),
+    inContext(5, (cb) => native.Object.staticWheelTimeout(1, cb))
+  ]);
+  assertEqual(ids.join(","), "1,2,3,4,5");
+
+  done();
+});
+
+test("Worker threads", async function(done) {
+  const Worker = require("worker_threads").Worker;
+  const code =
+    "var wt = require('worker_threads');" +
+    "var native = require(wt.workerData);" +
+    "(async function() {" +
+    "  var sum = 0;" +
+    "  for await (var value of new native.Object(1, 2).range(100)) sum += value;" +
+    "  wt.parentPort.postMessage([sum, native.Object.staticLookup('fontSize')]);" +
+    "})();";
+
+  const worker = new Worker(code, {
+    eval: true,
+    workerData: require("path").join(__dirname, "build", "Release", "njs-test.node")
+  });
+
+  const result = await new Promise(function(resolve, reject) {
+    worker.on("message", resolve);
+    worker.on("error", reject);
+  });
+  assertEqual(result[0], 4950);
+  assertEqual(result[1], 1);
+
+  // Module data of the main isolate must survive the worker's cleanup.
+  await worker.terminate();
+  assertEqual(native.Object.staticLookup("fontSize"), 1);
+
+  done();
+});
+
+runTests().catch(function(ex) {
+  console.error(ex);
+  process.exitCode = 1;
+});
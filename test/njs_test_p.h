@@ -9,6 +9,14 @@
 
 #include <stdio.h>
 #include "../njs-api.h"
+#include "../njs-extension-cache.h"
+#include "../njs-extension-columns.h"
+#include "../njs-extension-emitter.h"
+#include "../njs-extension-intern.h"
+#include "../njs-extension-iterator.h"
+#include "../njs-extension-map.h"
+#include "../njs-extension-memo.h"
+#include "../njs-extension-stream.h"
 
 namespace test {
 
@@ -79,14 +87,387 @@ public:
   int _b;
 };
 
-// A wrapped class.
-class ObjectWrap {
+// ============================================================================
+// [test::RangeProducer]
+// ============================================================================
+
+// Produces integers from 0 to `end` on a worker thread, fails with a custom
+// message if `end` is negative.
+class RangeProducer {
+public:
+  typedef int Item;
+
+  NJS_INLINE explicit RangeProducer(int end) noexcept
+    : _i(0),
+      _end(end) {}
+
+  NJS_INLINE njs::Result produce(Item& item, bool& done, njs::ResultPayloadBase& payload) noexcept {
+    if (_end < 0) {
+      payload.value.message = "Range end must not be negative";
+      return njs::Globals::kResultInvalidValueCustom;
+    }
+
+    if (_i >= _end)
+      done = true;
+    else
+      item = _i++;
+    return njs::Globals::kResultOk;
+  }
+
+  NJS_INLINE njs::Result pack(njs::Context& ctx, Item& item, njs::Value& out) noexcept {
+    out = ctx.newInt32(item);
+    return njs::Globals::kResultOk;
+  }
+
+  int _i;
+  int _end;
+};
+
+// ============================================================================
+// [test::SumTask]
+// ============================================================================
+
+// Sums integers from 0 to `n` on a thread of `njs::ThreadPool` or the libuv
+// thread-pool, or inline if it's profiled. Completes either a node style
+// callback or a promise, which is kept in its only slot.
+class SumTask : public njs::SlotTask<1> {
+public:
+  enum : uint32_t { kMaxN = 100000000 };
+
+  NJS_INLINE SumTask(njs::Context& ctx, njs::Value data, uint32_t n) noexcept
+    : SlotTask(ctx),
+      _n(n),
+      _sum(0) {
+    setSlot(ctx, kIndexCallback, data);
+  }
+
+  njs::Result onWorkResult() noexcept override {
+    if (_n == 0)
+      return invalidArgumentCustom(0, formatMessage("Expected a positive count, got %u", _n));
+
+    if (_n > kMaxN)
+      return fail(njs::Globals::kExceptionRangeError, "Count %u is greater than %u", _n, uint32_t(kMaxN));
+
+    for (uint32_t i = 0; i < _n; i++)
+      _sum += i;
+    return njs::Globals::kResultOk;
+  }
+
+  void onDone(njs::Context& ctx, njs::Value data) noexcept override {
+    if (data.isPromise())
+      ctx.resolve(data, ctx.newValue(double(_sum)));
+    else
+      ctx.call(data, ctx.undefined(), ctx.null(), ctx.newValue(double(_sum)));
+  }
+
+  static njs::TaskProfile profile;
+
+  uint32_t _n;
+  uint64_t _sum;
+};
+
+// ============================================================================
+// [test::SnapshotTask]
+// ============================================================================
+
+// Sums bytes of a buffer and scaled numbers of `options.values`, resolves to
+// `options.label + ":" + sum`. All inputs are read from a snapshot.
+class SnapshotTask : public njs::SlotTask<1> {
+public:
+  enum : uint32_t {
+    kFieldBytes = 0,
+    kFieldValues = 1,
+    kFieldScale = 2,
+    kFieldLabel = 3,
+    kFieldNegate = 4,
+    kFieldCount = 5
+  };
+
+  NJS_INLINE SnapshotTask(njs::Context& ctx, njs::Value resolver) noexcept
+    : SlotTask(ctx),
+      _sum(0.0) {
+    setSlot(ctx, kIndexCallback, resolver);
+  }
+
+  NJS_INLINE njs::Result capture(njs::FunctionCallContext& ctx) noexcept {
+    static const njs::SnapshotField fields[kFieldCount] = {
+      njs::SnapshotField::argument(0, njs::SnapshotField::kTypeBytes),
+      njs::SnapshotField::property(1, "values", njs::SnapshotField::kTypeNumbers),
+      njs::SnapshotField::property(1, "scale", njs::SnapshotField::kTypeNumber),
+      njs::SnapshotField::property(1, "label", njs::SnapshotField::kTypeString),
+      njs::SnapshotField::property(1, "negate", njs::SnapshotField::kTypeBool, njs::SnapshotField::kFlagOptional)
+    };
+    return _args.capture(ctx, fields, kFieldCount);
+  }
+
+  njs::Result onWorkResult() noexcept override {
+    size_t size;
+    const char* bytes = _args.bytesAt(kFieldBytes, size);
+    for (size_t i = 0; i < size; i++)
+      _sum += double(static_cast<unsigned char>(bytes[i]));
+
+    size_t count;
+    const double* values = _args.numbersAt(kFieldValues, count);
+    for (size_t i = 0; i < count; i++)
+      _sum += values[i] * _args.numberAt(kFieldScale);
+
+    if (_args.boolAt(kFieldNegate))
+      _sum = -_sum;
+    return njs::Globals::kResultOk;
+  }
+
+  void onDone(njs::Context& ctx, njs::Value data) noexcept override {
+    char buffer[256];
+    njs::Utf8Ref label = _args.stringAt(kFieldLabel);
+
+    snprintf(buffer, sizeof(buffer), "%.*s:%g", int(label.size()), label.data(), _sum);
+    ctx.resolve(data, ctx.newString(njs::Utf8Ref(buffer)));
+  }
+
+  njs::TaskSnapshot _args;
+  double _sum;
+};
+
+// ============================================================================
+// [test::FileIoTask]
+// ============================================================================
+
+// Reads or writes a single block of a file, calls `callback(result, data)`,
+// where `result` is the number of bytes transferred or a negated errno and
+// `data` is the string read.
+class FileIoTask : public njs::IoTask {
+public:
+  enum : uint32_t { kMaxSize = 64 };
+
+  NJS_INLINE FileIoTask(njs::Context& ctx, njs::Value callback) noexcept
+    : IoTask(ctx, callback) {}
+
+  void onDone(njs::Context& ctx, njs::Value callback) noexcept override {
+    intptr_t result = requestResult(0);
+    njs::Value data = ctx.undefined();
+
+    if (requestAt(0).op == njs::IoRequest::kOpRead && result >= 0)
+      data = ctx.newString(njs::Latin1Ref(_buffer, size_t(result)));
+    ctx.call(callback, ctx.undefined(), ctx.newValue(double(result)), data);
+  }
+
+  char _buffer[kMaxSize];
+};
+
+// ============================================================================
+// [test::CountingTimer]
+// ============================================================================
+
+// Counts how many times it fired and remembers the tick it fired at.
+class CountingTimer : public njs::Timer {
+public:
+  NJS_INLINE CountingTimer() noexcept
+    : fireCount(0),
+      firedAt(0) {}
+
+  void onTimer(njs::Context& ctx) noexcept override {
+    fireCount++;
+    firedAt = _expiry;
+  }
+
+  uint32_t fireCount;
+  uint64_t firedAt;
+};
+
+// ============================================================================
+// [test::BytesProducer]
+// ============================================================================
+
+// Produces `total` bytes (each byte is its index & 0xFF) in chunks of at most
+// `chunkSize` bytes on a worker thread.
+class BytesProducer {
+public:
+  NJS_INLINE BytesProducer(size_t total, size_t chunkSize) noexcept
+    : _offset(0),
+      _total(total),
+      _chunkSize(chunkSize ? chunkSize : 1) {}
+
+  NJS_INLINE njs::Result pull(size_t size, njs::StreamChunk& chunk, bool& done, njs::StreamWaker& waker, njs::ResultPayloadBase& payload) noexcept {
+    size_t n = _total - _offset;
+    if (n > _chunkSize)
+      n = _chunkSize;
+
+    if (n) {
+      chunk.data = static_cast<char*>(::malloc(n));
+      if (!chunk.data)
+        return njs::Globals::kResultOutOfMemory;
+
+      for (size_t i = 0; i < n; i++)
+        chunk.data[i] = char((_offset + i) & 0xFF);
+
+      chunk.size = n;
+      _offset += n;
+    }
+
+    done = _offset == _total;
+    return njs::Globals::kResultOk;
+  }
+
+  size_t _offset;
+  size_t _total;
+  size_t _chunkSize;
+};
+
+// ============================================================================
+// [test::FeedProducer]
+// ============================================================================
+
+// Produces a single byte chunk for each byte fed by `feed()`, which is called
+// from JS. The stream waits for the producer while nothing was fed.
+class FeedProducer {
+public:
+  static FeedProducer* current;
+
+  NJS_INLINE FeedProducer() noexcept
+    : _available(0),
+      _ended(false),
+      _pulls(0),
+      _waker(nullptr) { current = this; }
+
+  NJS_INLINE ~FeedProducer() noexcept {
+    if (current == this)
+      current = nullptr;
+  }
+
+  NJS_INLINE njs::Result pull(size_t size, njs::StreamChunk& chunk, bool& done, njs::StreamWaker& waker, njs::ResultPayloadBase& payload) noexcept {
+    _waker.store(&waker, std::memory_order_release);
+    _pulls++;
+
+    if (_available.load(std::memory_order_acquire)) {
+      chunk.data = static_cast<char*>(::malloc(1));
+      if (!chunk.data)
+        return njs::Globals::kResultOutOfMemory;
+
+      chunk.data[0] = 'x';
+      chunk.size = 1;
+      _available--;
+    }
+    else {
+      done = _ended.load(std::memory_order_acquire);
+    }
+    return njs::Globals::kResultOk;
+  }
+
+  NJS_INLINE void feed(uint32_t count, bool end) noexcept {
+    _available += count;
+    if (end)
+      _ended = true;
+
+    njs::StreamWaker* waker = _waker.load(std::memory_order_acquire);
+    if (waker)
+      waker->wakeUp();
+  }
+
+  std::atomic<uint32_t> _available;
+  std::atomic<bool> _ended;
+  std::atomic<uint32_t> _pulls;
+  std::atomic<njs::StreamWaker*> _waker;
+};
+
+// ============================================================================
+// [test::SumConsumer]
+// ============================================================================
+
+// Sums bytes written to a stream on a worker thread, the totals are stored to
+// `SumConsumer::stats` when the stream finishes.
+class SumConsumer {
+public:
+  struct Stats {
+    uint32_t bytes;
+    uint32_t sum;
+    uint32_t batches;
+  };
+
+  static Stats stats;
+
+  NJS_INLINE SumConsumer() noexcept
+    : _current() {}
+
+  NJS_INLINE njs::Result consume(const njs::StreamSlice* slices, size_t count, njs::ResultPayloadBase& payload) noexcept {
+    for (size_t i = 0; i < count; i++) {
+      const uint8_t* data = reinterpret_cast<const uint8_t*>(slices[i].data);
+      for (size_t j = 0; j < slices[i].size; j++)
+        _current.sum += data[j];
+      _current.bytes += uint32_t(slices[i].size);
+    }
+
+    _current.batches++;
+    return njs::Globals::kResultOk;
+  }
+
+  NJS_INLINE njs::Result finish(njs::ResultPayloadBase& payload) noexcept {
+    stats = _current;
+    return njs::Globals::kResultOk;
+  }
+
+  Stats _current;
+};
+
+// ============================================================================
+// [test::IncrementTransformer]
+// ============================================================================
+
+// Adds one to each byte, chunks starting with an odd byte take longer so they
+// finish out of order.
+class IncrementTransformer {
+public:
+  NJS_INLINE njs::Result transform(const njs::StreamSlice& input, njs::StreamChunk& output, njs::ResultPayloadBase& payload) noexcept {
+    if (input.size && (input.data[0] & 1))
+      uv_sleep(5);
+
+    output.data = static_cast<char*>(::malloc(input.size ? input.size : 1));
+    if (!output.data)
+      return njs::Globals::kResultOutOfMemory;
+
+    for (size_t i = 0; i < input.size; i++)
+      output.data[i] = char(input.data[i] + 1);
+    output.size = input.size;
+    return njs::Globals::kResultOk;
+  }
+};
+
+// ============================================================================
+// [test::TestCache]
+// ============================================================================
+
+// A cache that pretends to hold `size` bytes, a light trim frees a half of it,
+// other levels free all of it.
+class TestCache : public njs::CacheTrimmer {
+public:
+  NJS_INLINE TestCache() noexcept
+    : _size(0) {}
+
+  size_t onTrim(uint32_t level) noexcept override {
+    size_t freed = level == njs::kTrimLevelLight ? _size / 2 : _size;
+    _size -= freed;
+    return freed;
+  }
+
+  size_t _size;
+};
+
+// ============================================================================
+// [test::ObjectWrap]
+// ============================================================================
+
+// Number of `ObjectWrap` instances destroyed by GC.
+static uint32_t objectWrapDestroyed;
+
+// A wrapped class that emits `change` events and caches `sum`.
+class ObjectWrap
+  : public njs::EventEmitter,
+    public njs::GetterCache {
 public:
   NJS_BASE_CLASS(ObjectWrap, "Object", 0xFF)
 
   NJS_INLINE ObjectWrap(int a, int b) noexcept
     : _obj(a, b) {}
-  NJS_INLINE ~ObjectWrap() noexcept {}
+  NJS_INLINE ~ObjectWrap() noexcept { objectWrapDestroyed++; }
 
   Object _obj;
 };